@@ -0,0 +1,1514 @@
+#include "benchmarks.h"
+#include "chatwindow.h"
+#include "contactlistmodel.h"
+#include "contactsearchindex.h"
+#include "notificationcenter.h"
+#include "messagesearchindex.h"
+#include "foldedstringmatcher.h"
+#include "searchquery.h"
+#include "trigramindex.h"
+#include "conversationstore.h"
+#include "messageservice.h"
+#include "peersimulator.h"
+#include "searchindexstore.h"
+#include "perfmonitor.h"
+#include "chatclient.h"
+#include "chatprotocol.h"
+#include "groupfanout.h"
+#include "workstealingpool.h"
+#include <QApplication>
+#include <QHostAddress>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QVector>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QSystemTrayIcon>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QUuid>
+#include <QJsonDocument>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace
+{
+const char *BenchmarkUser = "__benchmark__";
+
+// Benchmarks start from the sample contacts and leave nothing behind
+void removeBenchmarkData()
+{
+    QDir dataDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    QFile::remove(dataDir.filePath(QString("contacts_%1.json").arg(BenchmarkUser)));
+    QFile::remove(dataDir.filePath(QString("chats_%1.json").arg(BenchmarkUser)));
+    QDir(SearchIndexStore::indexDirPath(BenchmarkUser)).removeRecursively();
+}
+
+int intOption(const QStringList &options, const QString &name, int defaultValue)
+{
+    int index = options.indexOf(name);
+    if (index < 0 || index + 1 >= options.size()) {
+        return defaultValue;
+    }
+    bool ok = false;
+    int value = options[index + 1].toInt(&ok);
+    return ok ? value : defaultValue;
+}
+
+QString stringOption(const QStringList &options, const QString &name, const QString &defaultValue)
+{
+    int index = options.indexOf(name);
+    if (index < 0 || index + 1 >= options.size()) {
+        return defaultValue;
+    }
+    return options[index + 1];
+}
+
+double percentileMs(QVector<qint64> samples, double percentile)
+{
+    if (samples.isEmpty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    int index = qBound(0, int(percentile * (samples.size() - 1)), samples.size() - 1);
+    return samples[index] / 1e6;
+}
+
+// Synthetic chat text drawn from a fixed vocabulary with a skewed word
+// distribution, so common words have long posting lists and rare ones short
+QString syntheticMessage(QRandomGenerator &random)
+{
+    static const QStringList words = {
+        "hey", "how", "are", "you", "doing", "today", "just", "wanted", "to", "say",
+        "hi", "good", "morning", "evening", "what", "plans", "for", "weekend", "meeting",
+        "tomorrow", "lunch", "dinner", "coffee", "movie", "project", "deadline", "report",
+        "call", "me", "later", "thanks", "sure", "maybe", "tonight", "weather", "rain",
+        "train", "flight", "hotel", "birthday", "party", "gift", "cricket", "match",
+        "score", "exam", "results", "office", "holiday", "trip", "goa", "mumbai", "delhi",
+        "bangalore", "photos", "video", "music", "concert", "tickets", "budget", "invoice"
+    };
+
+    int length = 3 + random.bounded(15);
+    QStringList text;
+    for (int i = 0; i < length; ++i) {
+        // Squaring the uniform draw favours the front of the list
+        double r = random.generateDouble();
+        text.append(words[int(r * r * words.size())]);
+    }
+    return text.join(' ');
+}
+
+void printLatency(const QString &label, const PerfMonitor::Histogram &histogram)
+{
+    qDebug().noquote() << QString("%1: n=%2, p50 %3 ms, p95 %4 ms, p99 %5 ms, max %6 ms")
+                              .arg(label)
+                              .arg(histogram.count)
+                              .arg(histogram.percentileMs(0.50), 0, 'f', 3)
+                              .arg(histogram.percentileMs(0.95), 0, 'f', 3)
+                              .arg(histogram.percentileMs(0.99), 0, 'f', 3)
+                              .arg(histogram.maxNs / 1e6, 0, 'f', 3);
+}
+
+// A server that was just started takes a moment to listen
+bool waitForServer(const QString &address, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < timeoutMs) {
+        if (address.startsWith("tcp:")) {
+            QTcpSocket probe;
+            probe.connectToHost(QHostAddress::LocalHost, quint16(address.mid(4).toUInt()));
+            if (probe.waitForConnected(100)) return true;
+        } else {
+            QLocalSocket probe;
+            probe.connectToServer(address);
+            if (probe.waitForConnected(100)) return true;
+        }
+        QThread::msleep(50);
+    }
+    return false;
+}
+
+// Starts server/chatsimserver from beside the app with its data under
+// `dataDir` (XDG_DATA_HOME, so on Linux only; elsewhere the benchmark
+// users' histories stay in the server's data directory). Returns the
+// address it listens on, empty if it did not start.
+QString startServer(QProcess &process, const QString &dataDir, int tcpPort)
+{
+    QString program = QDir(QCoreApplication::applicationDirPath()).filePath("server/chatsimserver");
+#ifdef Q_OS_WIN
+    program += ".exe";
+#endif
+    QString address = "chatsim-benchmark";
+    QStringList arguments = {"--listen", address};
+    if (tcpPort > 0) {
+        arguments << "--port" << QString::number(tcpPort);
+        address = QString("tcp:%1").arg(tcpPort);
+    }
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("XDG_DATA_HOME", dataDir);
+    process.setProcessEnvironment(environment);
+    process.setProcessChannelMode(QProcess::ForwardedChannels);
+    process.start(program, arguments);
+    if (!process.waitForStarted(5000)) {
+        qDebug() << "Could not start" << program << "- build the server subproject or pass --server";
+        return QString();
+    }
+    return address;
+}
+
+void stopServer(QProcess &process)
+{
+    if (process.state() == QProcess::NotRunning) return;
+
+    process.terminate();
+    if (!process.waitForFinished(3000)) {
+        process.kill();
+        process.waitForFinished();
+    }
+}
+
+void printFrameTimes(const QString &label, const QVector<qint64> &frameNs)
+{
+    int slowFrames = 0;
+    for (qint64 ns : frameNs) {
+        if (ns > 16700000) ++slowFrames;
+    }
+
+    qDebug().noquote() << QString("%1: %2 frames, p50 %3 ms, p95 %4 ms, p99 %5 ms, max %6 ms, over 16.7 ms: %7")
+                              .arg(label)
+                              .arg(frameNs.size())
+                              .arg(percentileMs(frameNs, 0.50), 0, 'f', 2)
+                              .arg(percentileMs(frameNs, 0.95), 0, 'f', 2)
+                              .arg(percentileMs(frameNs, 0.99), 0, 'f', 2)
+                              .arg(percentileMs(frameNs, 1.0), 0, 'f', 2)
+                              .arg(slowFrames);
+}
+}
+
+int Benchmarks::run(const QString &name, const QStringList &options)
+{
+    if (name == "burst") {
+        return runBurstInsertion(intOption(options, "--bursts", 50),
+                                 intOption(options, "--size", 100));
+    }
+
+    if (name == "contacts") {
+        return runContactRecency(intOption(options, "--contacts", 100000),
+                                 intOption(options, "--messages", 200000));
+    }
+
+    if (name == "contact-search") {
+        return runContactSearch(intOption(options, "--contacts", 1000000));
+    }
+
+    if (name == "notifications") {
+        return runNotificationBurst(intOption(options, "--messages", 1000),
+                                    intOption(options, "--contacts", 10));
+    }
+
+    if (name == "message-search") {
+        return runMessageSearch(intOption(options, "--messages", 1000000),
+                                intOption(options, "--contacts", 1000));
+    }
+
+    if (name == "text-search") {
+        return runTextSearch(intOption(options, "--messages", 200000));
+    }
+
+    if (name == "query-plan") {
+        return runQueryPlan(intOption(options, "--messages", 1000000));
+    }
+
+    if (name == "trigram") {
+        return runTrigramSearch(intOption(options, "--messages", 1000000));
+    }
+
+    if (name == "simulate") {
+        return runPeerSimulation(intOption(options, "--contacts", 2000),
+                                 intOption(options, "--rate", 500),
+                                 intOption(options, "--seconds", 10),
+                                 stringOption(options, "--arrival", "poisson"),
+                                 intOption(options, "--chars", 40),
+                                 options.contains("--headless"),
+                                 options.contains("--queued"));
+    }
+
+    if (name == "server") {
+        return runServerLatency(intOption(options, "--clients", 50),
+                                intOption(options, "--rate", 1000),
+                                intOption(options, "--seconds", 10),
+                                stringOption(options, "--server", QString()),
+                                intOption(options, "--tcp", 0),
+                                options.contains("--headless"));
+    }
+
+    if (name == "codec") {
+        return runCodec(intOption(options, "--messages", 1000000));
+    }
+
+    if (name == "fanout") {
+        return runFanout(intOption(options, "--messages", 200),
+                         intOption(options, "--threads", QThread::idealThreadCount() - 1));
+    }
+
+    if (name == "sync") {
+        return runSync(intOption(options, "--history", 10000),
+                       stringOption(options, "--server", QString()),
+                       intOption(options, "--tcp", 0));
+    }
+
+    if (name == "ingest") {
+        return runIngest(intOption(options, "--producers", 4),
+                         intOption(options, "--messages", 100000),
+                         intOption(options, "--contacts", 1000),
+                         options.contains("--headless"));
+    }
+
+    qDebug() << "Unknown benchmark:" << name;
+    qDebug() << "Available: burst, contacts, contact-search, notifications, message-search, text-search, query-plan, trigram, simulate, ingest, server, codec, fanout, sync";
+    return 1;
+}
+
+int Benchmarks::runBurstInsertion(int bursts, int burstSize)
+{
+    removeBenchmarkData();
+    ChatWindow *window = new ChatWindow(BenchmarkUser);
+    window->setAttribute(Qt::WA_DeleteOnClose, false);
+    window->show();
+
+    // History loads in the background after the window shows
+    if (!window->isDataReady()) {
+        QEventLoop loadLoop;
+        QObject::connect(window, &ChatWindow::dataReady, &loadLoop, &QEventLoop::quit);
+        loadLoop.exec();
+    }
+
+    QStringList contacts = window->contactNames();
+    if (contacts.isEmpty()) {
+        qDebug() << "Benchmark user has no contacts";
+        delete window;
+        return 1;
+    }
+    QString contact = contacts.first();
+    window->selectContact(contact);
+
+    // A zero-interval timer fires once per event loop turn, so the gap
+    // between ticks is how long the GUI thread was unable to paint
+    QElapsedTimer clock;
+    clock.start();
+    QVector<qint64> frameNs;
+    qint64 lastTick = clock.nsecsElapsed();
+
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(0);
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        qint64 now = clock.nsecsElapsed();
+        frameNs.append(now - lastTick);
+        lastTick = now;
+    });
+
+    QEventLoop loop;
+    int burstsSent = 0;
+    QTimer burstTimer;
+    burstTimer.setInterval(100);
+    QObject::connect(&burstTimer, &QTimer::timeout, [&]() {
+        if (burstsSent == bursts) {
+            burstTimer.stop();
+            // Let the last batch insert and scroll before stopping
+            QTimer::singleShot(500, &loop, &QEventLoop::quit);
+            return;
+        }
+        // The whole burst arrives within one frame
+        for (int i = 0; i < burstSize; ++i) {
+            window->receiveMessage(contact, QString("Burst %1 message %2").arg(burstsSent).arg(i));
+        }
+        ++burstsSent;
+    });
+
+    // Give the window time to show and load before measuring
+    QTimer::singleShot(500, [&]() {
+        lastTick = clock.nsecsElapsed();
+        ticker.start();
+        burstTimer.start();
+    });
+
+    qint64 start = clock.elapsed();
+    loop.exec();
+    ticker.stop();
+
+    qDebug().noquote() << QString("Burst insertion: %1 bursts x %2 messages in %3 ms")
+                              .arg(bursts).arg(burstSize).arg(clock.elapsed() - start);
+    printFrameTimes("Frame times", frameNs);
+
+    delete window;
+    removeBenchmarkData();
+    return 0;
+}
+
+int Benchmarks::runContactRecency(int contacts, int messages)
+{
+    ContactListModel model;
+
+    QList<Contact> contactList;
+    contactList.reserve(contacts);
+    for (int i = 0; i < contacts; ++i) {
+        contactList.append(Contact(QString("Contact %1").arg(i), QString::number(9000000000LL + i)));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    model.setContacts(contactList);
+    qDebug().noquote() << QString("Loaded %1 contacts in %2 ms").arg(contacts).arg(timer.elapsed());
+
+    // Half the traffic goes to a small set of active chats, the rest is
+    // spread over everyone, which is the expensive case for reordering
+    QRandomGenerator random(42);
+    int activeChats = qMin(contacts, 50);
+    QStringList targets;
+    targets.reserve(messages);
+    for (int i = 0; i < messages; ++i) {
+        int index = (i % 2 == 0) ? random.bounded(activeChats) : random.bounded(contacts);
+        targets.append(contactList[index].name);
+    }
+
+    QDateTime now = QDateTime::currentDateTime();
+    timer.restart();
+    for (int i = 0; i < messages; ++i) {
+        const QString &name = targets[i];
+        model.touchContact(name, now.addMSecs(i));
+        model.setUnreadCount(name, model.unreadCount(name) + 1);
+        model.setLastMessage(name, QString("Message %1").arg(i));
+    }
+    qint64 elapsedNs = timer.nsecsElapsed();
+
+    qDebug().noquote() << QString("Contact recency: %1 messages over %2 contacts in %3 ms, %4 us/message, %5 messages/s")
+                              .arg(messages)
+                              .arg(contacts)
+                              .arg(elapsedNs / 1e6, 0, 'f', 1)
+                              .arg(elapsedNs / 1e3 / qMax(1, messages), 0, 'f', 2)
+                              .arg(messages / qMax(1e-9, elapsedNs / 1e9), 0, 'f', 0);
+
+    // The last target must now be the top row
+    bool ordered = model.nameAt(0) == targets.last();
+    qDebug() << "Top row is the last active contact:" << ordered;
+    return ordered ? 0 : 1;
+}
+
+int Benchmarks::runContactSearch(int contacts)
+{
+    const QStringList firstNames = {
+        "Krishna", "Khushi", "Madhavan", "Manya", "Aarav", "Vivaan", "Aditya", "Ananya",
+        "Diya", "Ishaan", "Kavya", "Rohan", "Saanvi", "Arjun", "Meera", "Nikhil",
+        "Priya", "Rahul", "Sneha", "Tanvi", "Varun", "Yash", "Zoya", "Kabir"
+    };
+    const QStringList lastNames = {
+        "Singla", "Gupta", "Dixit", "Sharma", "Verma", "Iyer", "Nair", "Reddy",
+        "Kapoor", "Mehta", "Joshi", "Chopra", "Bose", "Das", "Patel", "Rao"
+    };
+
+    QRandomGenerator random(7);
+    QList<Contact> contactList;
+    contactList.reserve(contacts);
+    for (int i = 0; i < contacts; ++i) {
+        QString name = QString("%1 %2 %3")
+                           .arg(firstNames[random.bounded(firstNames.size())],
+                                lastNames[random.bounded(lastNames.size())])
+                           .arg(i);
+        contactList.append(Contact(name, QString::number(9000000000LL + random.bounded(999999999))));
+    }
+
+    ContactSearchIndex index;
+    ContactListModel model;
+
+    QElapsedTimer timer;
+    timer.start();
+    index.setContacts(contactList);
+    qint64 indexMs = timer.elapsed();
+    timer.restart();
+    model.setContacts(contactList);
+    qDebug().noquote() << QString("Indexed %1 contacts (%2 keys) in %3 ms, model loaded in %4 ms")
+                              .arg(contacts).arg(index.keyCount()).arg(indexMs).arg(timer.elapsed());
+
+    // Typed one character at a time, as the filter box sees it
+    const QStringList queries = { "krishna", "gupta kh", "98262", "madhavn", "snhea", "kavya iyer 12" };
+    QVector<qint64> keystrokeNs;
+    for (const QString &query : queries) {
+        for (int length = 1; length <= query.size(); ++length) {
+            QString typed = query.left(length);
+            bool fuzzy = false;
+            timer.restart();
+            QVector<QString> matches = index.search(typed, &fuzzy);
+            model.setFilter(matches);
+            qint64 ns = timer.nsecsElapsed();
+            keystrokeNs.append(ns);
+
+            if (length == query.size()) {
+                qDebug().noquote() << QString("  \"%1\": %2 matches%3 in %4 ms")
+                                          .arg(typed).arg(matches.size())
+                                          .arg(fuzzy ? " (fuzzy)" : "")
+                                          .arg(ns / 1e6, 0, 'f', 2);
+            }
+        }
+    }
+    model.clearFilter();
+
+    printFrameTimes("Keystroke latency", keystrokeNs);
+    return 0;
+}
+
+int Benchmarks::runNotificationBurst(int messages, int contacts)
+{
+    QSystemTrayIcon *trayIcon = nullptr;
+    if (QSystemTrayIcon::isSystemTrayAvailable()) {
+        trayIcon = new QSystemTrayIcon();
+        trayIcon->show();
+    }
+    NotificationCenter center(trayIcon);
+
+    int windowsBefore = QApplication::topLevelWidgets().size();
+
+    QElapsedTimer clock;
+    clock.start();
+    QVector<qint64> notifyNs;
+    notifyNs.reserve(messages);
+
+    // Messages arrive in bursts of 50 every 100 ms, round-robin across chats
+    QEventLoop loop;
+    int sent = 0;
+    QTimer burstTimer;
+    burstTimer.setInterval(100);
+    QObject::connect(&burstTimer, &QTimer::timeout, [&]() {
+        for (int i = 0; i < 50 && sent < messages; ++i, ++sent) {
+            qint64 start = clock.nsecsElapsed();
+            center.notify(QString("Contact %1").arg(sent % qMax(1, contacts)),
+                          QString("Notification message %1").arg(sent));
+            notifyNs.append(clock.nsecsElapsed() - start);
+        }
+        if (sent == messages) {
+            burstTimer.stop();
+            // Let the last aggregation window flush
+            QTimer::singleShot(NotificationCenter::AggregationMs * 2, &loop, &QEventLoop::quit);
+        }
+    });
+    burstTimer.start();
+    loop.exec();
+
+    int windowsAfter = QApplication::topLevelWidgets().size();
+    const NotificationCenter::Stats &stats = center.stats();
+
+    qDebug().noquote() << QString("Notifications: %1 messages from %2 contacts in %3 ms")
+                              .arg(stats.notifications).arg(contacts).arg(clock.elapsed());
+    qDebug().noquote() << QString("  popup refreshes: %1, windows created: %2 (top-level widgets %3 -> %4)")
+                              .arg(stats.popupsShown).arg(stats.windowsCreated)
+                              .arg(windowsBefore).arg(windowsAfter);
+    qDebug().noquote() << QString("  tray balloons: %1 shown, %2 deferred%3")
+                              .arg(stats.trayMessages).arg(stats.trayMessagesSuppressed)
+                              .arg(trayIcon ? "" : " (no system tray)");
+    printFrameTimes("notify() latency", notifyNs);
+
+    delete trayIcon;
+    return stats.windowsCreated <= 1 ? 0 : 1;
+}
+
+int Benchmarks::runMessageSearch(int messages, int contacts)
+{
+    QRandomGenerator random(11);
+    contacts = qMax(1, contacts);
+
+    QHash<QString, QList<Message>> history;
+    QDateTime start = QDateTime::currentDateTime().addDays(-365);
+    for (int i = 0; i < messages; ++i) {
+        QString contact = QString("Contact %1").arg(random.bounded(contacts));
+        history[contact].append(Message(contact, syntheticMessage(random),
+                                        start.addSecs(i * 30), random.bounded(2) == 0));
+    }
+
+    MessageSearchIndex index;
+    QElapsedTimer timer;
+    timer.start();
+    for (auto it = history.constBegin(); it != history.constEnd(); ++it) {
+        index.addConversation(it.key(), it.value());
+    }
+    qDebug().noquote() << QString("Indexed %1 messages in %2 ms: %3 terms, %4 postings")
+                              .arg(index.documentCount()).arg(timer.elapsed())
+                              .arg(index.termCount()).arg(index.postingCount());
+
+    // Typed one character at a time, as the search box sees it
+    const QStringList queries = { "birthday party", "goa trip photos", "deadline", "coffee tom", "invoice budget report" };
+    QVector<qint64> keystrokeNs;
+    for (const QString &query : queries) {
+        for (int length = 1; length <= query.size(); ++length) {
+            QString typed = query.left(length);
+            int total = 0;
+            timer.restart();
+            QVector<MessageSearchIndex::Hit> hits = index.search(typed, 50, &total);
+            qint64 ns = timer.nsecsElapsed();
+            keystrokeNs.append(ns);
+
+            if (length == query.size()) {
+                qDebug().noquote() << QString("  \"%1\": %2 matches, %3 shown, in %4 ms")
+                                          .arg(typed).arg(total).arg(hits.size())
+                                          .arg(ns / 1e6, 0, 'f', 2);
+            }
+        }
+    }
+    printFrameTimes("Keystroke latency", keystrokeNs);
+
+    // Incremental maintenance: deletes and edits leave tombstones
+    timer.restart();
+    int removed = 0;
+    for (auto it = history.constBegin(); it != history.constEnd() && removed < messages / 10; ++it) {
+        for (const Message &msg : it.value()) {
+            index.removeMessage(msg.id);
+            if (++removed >= messages / 10) break;
+        }
+    }
+    qDebug().noquote() << QString("Removed %1 messages in %2 ms, %3 remain")
+                              .arg(removed).arg(timer.elapsed()).arg(index.documentCount());
+    return 0;
+}
+
+int Benchmarks::runTextSearch(int messages)
+{
+    QRandomGenerator random(13);
+
+    // Mostly ASCII chat text, with some accented, Greek, Devanagari and
+    // emoji messages so the non-ASCII paths are exercised too
+    const QStringList extras = {
+        "Café crème at the Hôtel", "ΚΑΛΗΜΈΡΑ φίλε μου", "नमस्ते, कैसे हो?", "Party tonight 🎉🎉",
+        "Temperature 300 \u212A outside", "Stra\u017Fse closed"
+    };
+    QStringList texts;
+    texts.reserve(messages);
+    qint64 totalChars = 0;
+    for (int i = 0; i < messages; ++i) {
+        QString text = syntheticMessage(random);
+        if (random.bounded(10) == 0) {
+            text += ' ' + extras[random.bounded(extras.size())];
+        }
+        totalChars += text.size();
+        texts.append(text);
+    }
+
+    const QStringList queries = { "Birthday", "GOA TRIP", "q", "café", "καλημέρα", "kelvin \u212A", "straſse", "🎉", "नमस्ते", "zzzz" };
+
+    qDebug().noquote() << QString("Text search over %1 messages (%2 MB), vector kernel: %3")
+                              .arg(messages).arg(totalChars * 2 / 1e6, 0, 'f', 1)
+                              .arg(FoldedStringMatcher::kernelName());
+
+    auto throughput = [totalChars](qint64 ns) {
+        return ns > 0 ? totalChars * 2 / 1e6 / (ns / 1e9) : 0.0;
+    };
+
+    bool consistent = true;
+    for (const QString &query : queries) {
+        QElapsedTimer timer;
+
+        timer.start();
+        int qtMatches = 0;
+        for (const QString &text : std::as_const(texts)) {
+            if (text.contains(query, Qt::CaseInsensitive)) ++qtMatches;
+        }
+        qint64 qtNs = timer.nsecsElapsed();
+
+        FoldedStringMatcher matcher(query);
+
+        FoldedStringMatcher::setVectorEnabled(false);
+        timer.restart();
+        int scalarMatches = 0;
+        for (const QString &text : std::as_const(texts)) {
+            if (matcher.matches(text)) ++scalarMatches;
+        }
+        qint64 scalarNs = timer.nsecsElapsed();
+
+        FoldedStringMatcher::setVectorEnabled(true);
+        timer.restart();
+        int vectorMatches = 0;
+        for (const QString &text : std::as_const(texts)) {
+            if (matcher.matches(text)) ++vectorMatches;
+        }
+        qint64 vectorNs = timer.nsecsElapsed();
+
+        bool same = qtMatches == scalarMatches && qtMatches == vectorMatches;
+        consistent = consistent && same;
+
+        qDebug().noquote() << QString("  \"%1\": %2 matches%3 | contains %4 MB/s | scalar %5 MB/s | vector %6 MB/s (%7x)")
+                                  .arg(query).arg(qtMatches)
+                                  .arg(same ? "" : QString(" (MISMATCH %1/%2)").arg(scalarMatches).arg(vectorMatches))
+                                  .arg(throughput(qtNs), 0, 'f', 0)
+                                  .arg(throughput(scalarNs), 0, 'f', 0)
+                                  .arg(throughput(vectorNs), 0, 'f', 0)
+                                  .arg(vectorNs > 0 ? double(qtNs) / vectorNs : 0.0, 0, 'f', 1);
+    }
+    return consistent ? 0 : 1;
+}
+
+int Benchmarks::runQueryPlan(int messages)
+{
+    QRandomGenerator random(17);
+
+    // A year of one conversation, in timestamp order like any history
+    QList<Message> history;
+    history.reserve(messages);
+    QDateTime start = QDateTime::currentDateTime().addDays(-365);
+    qint64 stepMs = qMax<qint64>(1, 365LL * 24 * 3600 * 1000 / qMax(1, messages));
+    for (int i = 0; i < messages; ++i) {
+        bool mine = random.bounded(2) == 0;
+        history.append(Message(mine ? "Me" : "Friend", syntheticMessage(random),
+                               start.addMSecs(i * stepMs), mine));
+    }
+
+    auto day = [&start](int offset) { return start.addDays(offset).date().toString(Qt::ISODate); };
+    const QStringList queries = {
+        QString("after:%1 before:%2 coffee").arg(day(100), day(107)),
+        QString("after:%1 from:me birthday party").arg(day(300)),
+        QString("before:%1 \"goa trip\"").arg(day(30)),
+        "from:friend invoice",
+        "deadline report"
+    };
+
+    bool consistent = true;
+    for (const QString &text : queries) {
+        SearchQuery query = SearchQuery::parse(text);
+        QElapsedTimer timer;
+
+        // Every message, every condition
+        timer.start();
+        int naiveMatches = 0;
+        for (const Message &msg : std::as_const(history)) {
+            qint64 ms = msg.timestamp.toMSecsSinceEpoch();
+            if (query.matchesTime(ms) && query.matchesSender(msg) && query.matchesText(msg.content)) ++naiveMatches;
+        }
+        qint64 naiveNs = timer.nsecsElapsed();
+
+        // Date slice by binary search, then sender, then vectorized text
+        timer.restart();
+        QPair<int, int> range = query.timeRange(history);
+        std::vector<FoldedStringMatcher> matchers;
+        for (const QString &term : query.textTerms()) {
+            matchers.emplace_back(term);
+        }
+        int plannedMatches = 0;
+        int textChecks = 0;
+        for (int i = range.first; i < range.second; ++i) {
+            const Message &msg = history[i];
+            if (!query.matchesSender(msg)) continue;
+            ++textChecks;
+            bool matched = true;
+            for (const FoldedStringMatcher &matcher : matchers) {
+                if (!matcher.matches(msg.content)) {
+                    matched = false;
+                    break;
+                }
+            }
+            if (matched) ++plannedMatches;
+        }
+        qint64 plannedNs = timer.nsecsElapsed();
+
+        bool same = naiveMatches == plannedMatches;
+        consistent = consistent && same;
+
+        qDebug().noquote() << QString("  %1: %2 matches%3 | scan all %4 ms | planned %5 ms, %6 in range, %7 text checks")
+                                  .arg(text).arg(plannedMatches)
+                                  .arg(same ? "" : QString(" (MISMATCH %1)").arg(naiveMatches))
+                                  .arg(naiveNs / 1e6, 0, 'f', 2)
+                                  .arg(plannedNs / 1e6, 0, 'f', 2)
+                                  .arg(range.second - range.first).arg(textChecks);
+    }
+    return consistent ? 0 : 1;
+}
+
+int Benchmarks::runTrigramSearch(int messages)
+{
+    QRandomGenerator random(19);
+    messages = qMax(1, messages);
+
+    QHash<QString, QList<Message>> history;
+    QDateTime start = QDateTime::currentDateTime().addDays(-365);
+    for (int i = 0; i < messages; ++i) {
+        QString contact = QString("Contact %1").arg(random.bounded(500));
+        history[contact].append(Message(contact, syntheticMessage(random), start.addSecs(i * 30), false));
+    }
+
+    TrigramIndex index;
+    QElapsedTimer timer;
+    timer.start();
+    for (auto it = history.constBegin(); it != history.constEnd(); ++it) {
+        index.addConversation(it.key(), it.value());
+    }
+    qint64 buildMs = timer.elapsed();
+    double perMillion = 1e6 / messages;
+    qDebug().noquote() << QString("Indexed %1 messages in %2 ms: %3 trigrams, %4 postings, %5 MB (%6 MB per million messages)")
+                              .arg(index.documentCount()).arg(buildMs)
+                              .arg(index.trigramCount()).arg(index.postingCount())
+                              .arg(index.memoryBytes() / 1e6, 0, 'f', 1)
+                              .arg(index.memoryBytes() * perMillion / 1e6, 0, 'f', 1);
+
+    // Fragments from inside words, checked against a scan of every message
+    bool consistent = true;
+    const QStringList fragments = { "thday", "ncert", "adlin", "voic", "ngalo", "offee tom" };
+    for (const QString &fragment : fragments) {
+        SearchQuery query = SearchQuery::parse(fragment);
+        int total = 0;
+        timer.restart();
+        index.searchFragments(query, 50, &total);
+        qint64 indexNs = timer.nsecsElapsed();
+
+        FoldedStringMatcher matcher(fragment);
+        timer.restart();
+        int scanned = 0;
+        for (auto it = history.constBegin(); it != history.constEnd(); ++it) {
+            for (const Message &msg : it.value()) {
+                if (matcher.matches(msg.content)) ++scanned;
+            }
+        }
+        qint64 scanNs = timer.nsecsElapsed();
+
+        bool same = total == scanned;
+        consistent = consistent && same;
+        qDebug().noquote() << QString("  fragment \"%1\": %2 matches%3 | index %4 ms | scan %5 ms")
+                                  .arg(fragment).arg(total)
+                                  .arg(same ? "" : QString(" (MISMATCH %1)").arg(scanned))
+                                  .arg(indexNs / 1e6, 0, 'f', 2).arg(scanNs / 1e6, 0, 'f', 2);
+    }
+
+    // Misspellings of vocabulary words
+    const QStringList typos = { "birthdey", "deadlne", "invoise", "concrt", "bangalxre" };
+    for (const QString &typo : typos) {
+        SearchQuery query = SearchQuery::parse(typo);
+        int total = 0;
+        timer.restart();
+        QVector<TrigramIndex::Hit> hits = index.searchApproximate(query, 50, &total);
+        qint64 indexNs = timer.nsecsElapsed();
+        qDebug().noquote() << QString("  misspelling \"%1\" (up to %2 edits): %3 matches, best %4 edits, in %5 ms")
+                                  .arg(typo).arg(TrigramIndex::maxEdits(typo)).arg(total)
+                                  .arg(hits.isEmpty() ? -1 : hits.first().distance)
+                                  .arg(indexNs / 1e6, 0, 'f', 2);
+    }
+    return consistent ? 0 : 1;
+}
+
+int Benchmarks::runPeerSimulation(int contacts, int rate, int seconds, const QString &arrival,
+                                  int medianChars, bool headless, bool queued)
+{
+    PeerSimulator::Config config;
+    bool arrivalOk = false;
+    config.arrival = PeerSimulator::arrivalFromName(arrival, &arrivalOk);
+    if (!arrivalOk) {
+        qDebug() << "Unknown arrival mode:" << arrival << "(poisson or bursty)";
+        return 1;
+    }
+    config.contacts = contacts;
+    config.messagesPerSecond = rate;
+    config.durationMs = seconds * 1000LL;
+    config.medianChars = medianChars;
+    config.queued = queued;
+
+    removeBenchmarkData();
+
+    ChatWindow *window = nullptr;
+    ConversationStore *store = nullptr;
+    MessageService *service = nullptr;
+    if (headless) {
+        // The core on its own: history, indexes and saves, nothing connected
+        store = new ConversationStore(BenchmarkUser);
+        service = new MessageService(store);
+        service->setContactsLoaded();
+        service->setHistoryLoaded();
+    } else {
+        window = new ChatWindow(BenchmarkUser);
+        window->setAttribute(Qt::WA_DeleteOnClose, false);
+        window->show();
+
+        if (!window->isDataReady()) {
+            QEventLoop loadLoop;
+            QObject::connect(window, &ChatWindow::dataReady, &loadLoop, &QEventLoop::quit);
+            loadLoop.exec();
+        }
+        service = window->service();
+    }
+    // Only simulated traffic arrives
+    service->stopAutoMessages();
+
+    PeerSimulator simulator(service, config);
+    simulator.addContacts();
+    if (window) {
+        // The busiest contact's chat is open
+        window->selectContact(PeerSimulator::contactName(0));
+    }
+
+    // As in the burst benchmark, gaps between zero-interval ticks are frames
+    QElapsedTimer clock;
+    clock.start();
+    QVector<qint64> frameNs;
+    qint64 lastTick = clock.nsecsElapsed();
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(0);
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        qint64 now = clock.nsecsElapsed();
+        frameNs.append(now - lastTick);
+        lastTick = now;
+    });
+
+    QEventLoop loop;
+    QObject::connect(&simulator, &PeerSimulator::finished, &loop, &QEventLoop::quit);
+    simulator.start();
+    if (window) {
+        lastTick = clock.nsecsElapsed();
+        ticker.start();
+    }
+    loop.exec();
+    ticker.stop();
+
+    qDebug().noquote() << QString("Peer simulation: %1 contacts, %2 arrivals, median %3 characters, %4%5")
+                              .arg(contacts)
+                              .arg(arrival.toLower())
+                              .arg(medianChars)
+                              .arg(headless ? QString("headless") : QString("with chat window"))
+                              .arg(queued ? QString(", queued") : QString());
+    for (const QString &line : simulator.report().summary()) {
+        qDebug().noquote() << line;
+    }
+    if (window) {
+        printFrameTimes("Frame times", frameNs);
+    }
+
+    if (window) {
+        delete window;
+    } else {
+        delete service;
+        delete store;
+    }
+    removeBenchmarkData();
+    return 0;
+}
+
+int Benchmarks::runIngest(int producers, int messages, int contacts, bool headless)
+{
+    const qint64 total = qint64(producers) * messages;
+    if (producers < 1 || messages < 1 || contacts < 1) {
+        qDebug() << "Ingest needs at least one producer, message and contact";
+        return 1;
+    }
+
+    removeBenchmarkData();
+
+    ChatWindow *window = nullptr;
+    ConversationStore *store = nullptr;
+    MessageService *service = nullptr;
+    if (headless) {
+        store = new ConversationStore(BenchmarkUser);
+        service = new MessageService(store);
+        service->setContactsLoaded();
+        service->setHistoryLoaded();
+    } else {
+        window = new ChatWindow(BenchmarkUser);
+        window->setAttribute(Qt::WA_DeleteOnClose, false);
+        window->show();
+
+        if (!window->isDataReady()) {
+            QEventLoop loadLoop;
+            QObject::connect(window, &ChatWindow::dataReady, &loadLoop, &QEventLoop::quit);
+            loadLoop.exec();
+        }
+        service = window->service();
+    }
+    service->stopAutoMessages();
+
+    // The simulator's contacts, so both benchmarks load the same list
+    PeerSimulator::Config config;
+    config.contacts = contacts;
+    PeerSimulator seeder(service, config);
+    seeder.addContacts();
+    if (window) {
+        window->selectContact(PeerSimulator::contactName(0));
+    }
+    PerfMonitor::instance().reset();
+
+    QElapsedTimer clock;
+    clock.start();
+    QVector<qint64> frameNs;
+    qint64 lastTick = clock.nsecsElapsed();
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(0);
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        qint64 now = clock.nsecsElapsed();
+        frameNs.append(now - lastTick);
+        lastTick = now;
+    });
+
+    QEventLoop loop;
+    qint64 applied = 0;
+    qint64 appliedNs = 0;
+    QObject::connect(service, &MessageService::messagesReceived, &loop, [&](const MessageBatch &batch) {
+        applied += batch.size();
+        if (applied >= total) {
+            appliedNs = clock.nsecsElapsed();
+            loop.quit();
+        }
+    });
+
+    // Text is made up front so the producers time nothing but pushing
+    QVector<QVector<QPair<QString, QString>>> work(producers);
+    for (int p = 0; p < producers; ++p) {
+        QRandomGenerator random(p + 1);
+        work[p].reserve(messages);
+        for (int i = 0; i < messages; ++i) {
+            work[p].append(qMakePair(PeerSimulator::contactName(random.bounded(contacts)), syntheticMessage(random)));
+        }
+    }
+
+    QVector<qint64> pushNs(producers);
+    QVector<QThread*> threads;
+    qint64 startNs = clock.nsecsElapsed();
+    for (int p = 0; p < producers; ++p) {
+        threads.append(QThread::create([&, p]() {
+            QElapsedTimer timer;
+            timer.start();
+            for (const auto &message : work[p]) {
+                service->ingestMessage(message.first, message.second);
+            }
+            pushNs[p] = timer.nsecsElapsed();
+        }));
+    }
+    if (window) {
+        lastTick = clock.nsecsElapsed();
+        ticker.start();
+    }
+    for (QThread *thread : threads) {
+        thread->start();
+    }
+    loop.exec();
+    ticker.stop();
+    for (QThread *thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    qint64 slowestPushNs = *std::max_element(pushNs.begin(), pushNs.end());
+    double elapsedSeconds = (appliedNs - startNs) / 1e9;
+    qDebug().noquote() << QString("Ingest: %1 producers x %2 messages into %3 contacts, %4")
+                              .arg(producers)
+                              .arg(messages)
+                              .arg(contacts)
+                              .arg(headless ? QString("headless") : QString("with chat window"));
+    qDebug().noquote() << QString("Pushed in %1 ms: %2 msg/s across producers, %3 ns per push")
+                              .arg(slowestPushNs / 1e6, 0, 'f', 1)
+                              .arg(slowestPushNs > 0 ? total / (slowestPushNs / 1e9) : 0.0, 0, 'f', 0)
+                              .arg(double(slowestPushNs) / messages, 0, 'f', 0);
+    qDebug().noquote() << QString("All applied in %1 ms: %2 msg/s")
+                              .arg(elapsedSeconds * 1000.0, 0, 'f', 1)
+                              .arg(elapsedSeconds > 0.0 ? total / elapsedSeconds : 0.0, 0, 'f', 0);
+    for (const QString &line : PerfMonitor::instance().summary()) {
+        if (line.startsWith("ingest.") || line.startsWith("message.batch")) {
+            qDebug().noquote() << line;
+        }
+    }
+    if (window) {
+        printFrameTimes("Frame times", frameNs);
+    }
+
+    if (window) {
+        delete window;
+    } else {
+        delete service;
+        delete store;
+    }
+    removeBenchmarkData();
+    return 0;
+}
+
+int Benchmarks::runServerLatency(int clients, int rate, int seconds, const QString &server,
+                                 int tcpPort, bool headless)
+{
+    if (clients < 2 || rate <= 0) {
+        qDebug() << "Server benchmark needs at least two clients and a positive rate";
+        return 1;
+    }
+
+    // Unless one was named, a server is started for the run with its data
+    // in a temporary directory
+    QString address = server;
+    QProcess serverProcess;
+    QTemporaryDir serverData;
+    if (address.isEmpty()) {
+        address = startServer(serverProcess, serverData.path(), tcpPort);
+        if (address.isEmpty()) return 1;
+    }
+    if (!waitForServer(address, 5000)) {
+        qDebug() << "No server listening on" << address;
+        return 1;
+    }
+
+    removeBenchmarkData();
+
+    QElapsedTimer clock;
+    clock.start();
+    QHash<QString, qint64> sentNs;       // Message ID to send time, until delivered
+    QHash<QString, qint64> unackedNs;    // Message ID to send time, until acknowledged
+    PerfMonitor::Histogram ackLatency;
+    PerfMonitor::Histogram deliveryLatency;
+    PerfMonitor::Histogram displayLatency;
+    qint64 sent = 0;
+    qint64 delivered = 0;
+
+    // Every simulated client runs on this thread, event-driven like the server
+    QVector<ChatClient*> peers;
+    QStringList names;
+    int connectedCount = 0;
+    for (int i = 0; i < clients; ++i) {
+        ChatClient *client = new ChatClient(QString("Bench %1").arg(i, 5, 10, QChar('0')));
+        QObject::connect(client, &ChatClient::connected, [&connectedCount]() { ++connectedCount; });
+        QObject::connect(client, &ChatClient::messageAcked, [&](const QString &messageId) {
+            auto it = unackedNs.find(messageId);
+            if (it == unackedNs.end()) return;
+            ackLatency.add(clock.nsecsElapsed() - it.value());
+            unackedNs.erase(it);
+        });
+        QObject::connect(client, &ChatClient::messageDelivered, [&](const QString &, const Message &msg) {
+            auto it = sentNs.find(msg.id);
+            if (it == sentNs.end()) return;
+            deliveryLatency.add(clock.nsecsElapsed() - it.value());
+            sentNs.erase(it);
+            ++delivered;
+        });
+        client->connectToServer(address);
+        peers.append(client);
+        names.append(client->user());
+    }
+
+    // The chat window connects as one more user and gets its share of the traffic
+    ChatWindow *window = nullptr;
+    if (!headless) {
+        qputenv("CHATSIM_SERVER", address.toUtf8());
+        window = new ChatWindow(BenchmarkUser);
+        window->setAttribute(Qt::WA_DeleteOnClose, false);
+        window->show();
+        if (!window->isDataReady()) {
+            QEventLoop loadLoop;
+            QObject::connect(window, &ChatWindow::dataReady, &loadLoop, &QEventLoop::quit);
+            loadLoop.exec();
+        }
+        qunsetenv("CHATSIM_SERVER");
+
+        // Connected after the window's own handler, so the message is on screen
+        QObject::connect(window->service(), &MessageService::messageAdded, [&](const QString &, const Message &msg) {
+            auto it = sentNs.find(msg.id);
+            if (msg.isCurrentUser || it == sentNs.end()) return;
+            displayLatency.add(clock.nsecsElapsed() - it.value());
+            sentNs.erase(it);
+            ++delivered;
+        });
+        names.append(BenchmarkUser);
+    }
+
+    auto allConnected = [&]() {
+        bool windowConnected = !window || (window->service()->client() && window->service()->client()->isConnected());
+        return connectedCount == clients && windowConnected;
+    };
+    QElapsedTimer connectTimer;
+    connectTimer.start();
+    while (!allConnected() && connectTimer.elapsed() < 10000) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+    }
+    if (!allConnected()) {
+        qDebug() << "Only" << connectedCount << "of" << clients << "clients connected";
+    }
+
+    QVector<qint64> frameNs;
+    qint64 lastTick = clock.nsecsElapsed();
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(0);
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        qint64 now = clock.nsecsElapsed();
+        frameNs.append(now - lastTick);
+        lastTick = now;
+    });
+
+    // Sends are paced to the target rate from one millisecond timer; each
+    // goes from a random client to a random other user
+    QRandomGenerator random(7);
+    QEventLoop loop;
+    const qint64 durationNs = seconds * 1000000000LL;
+    qint64 sendStartNs = clock.nsecsElapsed();
+    qint64 sendEndNs = 0;
+    QTimer sender;
+    sender.setTimerType(Qt::PreciseTimer);
+    sender.setInterval(1);
+    QObject::connect(&sender, &QTimer::timeout, [&]() {
+        qint64 elapsedNs = clock.nsecsElapsed() - sendStartNs;
+        qint64 due = qint64(double(rate) * qMin(elapsedNs, durationNs) / 1e9);
+        while (sent < due) {
+            int from = random.bounded(clients);
+            int to = random.bounded(names.size() - 1);
+            if (to >= from) ++to;
+
+            Message msg(names[from], syntheticMessage(random), QDateTime::currentDateTime(), true);
+            qint64 now = clock.nsecsElapsed();
+            sentNs.insert(msg.id, now);
+            unackedNs.insert(msg.id, now);
+            peers[from]->sendMessage(names[to], msg);
+            ++sent;
+        }
+        if (elapsedNs >= durationNs) {
+            sender.stop();
+            sendEndNs = clock.nsecsElapsed();
+            // Stragglers get a few seconds to arrive
+            QTimer::singleShot(3000, &loop, &QEventLoop::quit);
+        }
+    });
+    if (window) {
+        window->selectContact(names.first());
+        lastTick = clock.nsecsElapsed();
+        ticker.start();
+    }
+    sender.start();
+    loop.exec();
+    ticker.stop();
+
+    double sendSeconds = (sendEndNs - sendStartNs) / 1e9;
+    qDebug().noquote() << QString("Server round trip: %1 clients over %2, %3 msg/s offered, %4")
+                              .arg(clients)
+                              .arg(address)
+                              .arg(rate)
+                              .arg(headless ? QString("headless") : QString("with chat window"));
+    qDebug().noquote() << QString("Sent %1 in %2 s, %3 acknowledged, %4 delivered, %5 lost or late")
+                              .arg(sent)
+                              .arg(sendSeconds, 0, 'f', 2)
+                              .arg(sent - unackedNs.size())
+                              .arg(delivered)
+                              .arg(sentNs.size());
+    printLatency("Ack (send to server's acknowledgement)", ackLatency);
+    printLatency("Delivery (send to receiving client)", deliveryLatency);
+    if (window) {
+        printLatency("Display (send to chat window)", displayLatency);
+        printFrameTimes("Frame times", frameNs);
+        delete window;
+    }
+
+    qDeleteAll(peers);
+    stopServer(serverProcess);
+    removeBenchmarkData();
+    return 0;
+}
+
+int Benchmarks::runCodec(int messages)
+{
+    if (messages < 1) {
+        qDebug() << "Codec benchmark needs at least one message";
+        return 1;
+    }
+
+    // Send frames as a client writes them: short names, UUIDs, chat-length text
+    QRandomGenerator random(11);
+    QVector<ChatProtocol::Frame> frames;
+    frames.reserve(messages);
+    qint64 characters = 0;
+    qint64 baseTime = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < messages; ++i) {
+        ChatProtocol::Frame frame;
+        frame.op = ChatProtocol::Op::Send;
+        frame.contact = PeerSimulator::contactName(random.bounded(1000));
+        frame.messageId = QUuid::createUuid().toString();
+        frame.content = syntheticMessage(random);
+        frame.time = baseTime + i;
+        characters += frame.content.size();
+        frames.append(frame);
+    }
+
+    // Streams are cut into socket-sized reads and writes
+    const int ChunkBytes = 64 * 1024;
+    auto rate = [messages](qint64 ns) { return ns > 0 ? messages / (ns / 1e9) : 0.0; };
+
+    QElapsedTimer timer;
+    timer.start();
+    ChatProtocol::Writer writer;
+    QByteArray stream;
+    stream.reserve(messages * 128);
+    for (const ChatProtocol::Frame &frame : frames) {
+        writer.append(frame);
+        if (writer.data().size() >= ChunkBytes) {
+            stream.append(writer.data());
+            writer.clear();
+        }
+    }
+    stream.append(writer.data());
+    writer.clear();
+    qint64 encodeNs = timer.nsecsElapsed();
+
+    // In place: only the views are touched
+    qint64 viewed = 0;
+    qint64 viewedBytes = 0;
+    ChatProtocol::Reader reader;
+    ChatProtocol::FrameView view;
+    timer.restart();
+    for (int offset = 0; offset < stream.size(); offset += ChunkBytes) {
+        reader.append(stream.constData() + offset, qMin(ChunkBytes, int(stream.size()) - offset));
+        while (reader.next(&view)) {
+            ++viewed;
+            viewedBytes += view.content.size;
+        }
+    }
+    qint64 viewNs = timer.nsecsElapsed();
+
+    // As ChatClient does on delivery: every field becomes a QString
+    qint64 copied = 0;
+    bool roundTrip = true;
+    reader.clear();
+    timer.restart();
+    for (int offset = 0; offset < stream.size(); offset += ChunkBytes) {
+        reader.append(stream.constData() + offset, qMin(ChunkBytes, int(stream.size()) - offset));
+        while (reader.next(&view)) {
+            QString contact = view.contact.toString();
+            QString messageId = view.messageIdString();
+            QString content = view.content.toString();
+            if (copied < 1000) {
+                const ChatProtocol::Frame &original = frames[int(copied)];
+                roundTrip = roundTrip && contact == original.contact && messageId == original.messageId
+                            && content == original.content && view.time == original.time;
+            }
+            ++copied;
+        }
+    }
+    qint64 copyNs = timer.nsecsElapsed();
+
+    // The same messages as one Message::toJson object per line
+    QList<Message> asMessages;
+    asMessages.reserve(messages);
+    for (const ChatProtocol::Frame &frame : frames) {
+        Message msg(frame.contact, frame.content, QDateTime::fromMSecsSinceEpoch(frame.time), false);
+        msg.id = frame.messageId;
+        asMessages.append(msg);
+    }
+    timer.restart();
+    QByteArray json;
+    json.reserve(messages * 256);
+    for (const Message &msg : asMessages) {
+        json.append(QJsonDocument(msg.toJson()).toJson(QJsonDocument::Compact));
+        json.append('\n');
+    }
+    qint64 jsonEncodeNs = timer.nsecsElapsed();
+
+    qint64 jsonDecoded = 0;
+    timer.restart();
+    int start = 0;
+    for (int end = json.indexOf('\n'); end >= 0; end = json.indexOf('\n', start)) {
+        Message msg = Message::fromJson(QJsonDocument::fromJson(json.mid(start, end - start)).object());
+        jsonDecoded += msg.content.isEmpty() ? 0 : 1;
+        start = end + 1;
+    }
+    qint64 jsonDecodeNs = timer.nsecsElapsed();
+
+    qDebug().noquote() << QString("Codec: %1 Send frames, %2 characters of text per message")
+                              .arg(messages)
+                              .arg(double(characters) / messages, 0, 'f', 1);
+    qDebug().noquote() << QString("Binary: %1 bytes/message, encode %2 msg/s, decode in place %3 msg/s, decode to QStrings %4 msg/s")
+                              .arg(double(stream.size()) / messages, 0, 'f', 1)
+                              .arg(rate(encodeNs), 0, 'f', 0)
+                              .arg(rate(viewNs), 0, 'f', 0)
+                              .arg(rate(copyNs), 0, 'f', 0);
+    qDebug().noquote() << QString("JSON (Message::toJson): %1 bytes/message, encode %2 msg/s, decode %3 msg/s")
+                              .arg(double(json.size()) / messages, 0, 'f', 1)
+                              .arg(rate(jsonEncodeNs), 0, 'f', 0)
+                              .arg(rate(jsonDecodeNs), 0, 'f', 0);
+
+    bool consistent = roundTrip && viewed == messages && copied == messages && jsonDecoded == messages
+                      && viewedBytes > 0 && !reader.hasError();
+    if (!consistent) {
+        qDebug() << "Codec mismatch:" << viewed << "viewed," << copied << "copied,"
+                 << jsonDecoded << "from JSON, round trip" << (roundTrip ? "ok" : "failed");
+    }
+    return consistent ? 0 : 1;
+}
+
+int Benchmarks::runFanout(int messages, int threads)
+{
+    if (messages < 1) {
+        qDebug() << "Fanout benchmark needs at least one message";
+        return 1;
+    }
+
+    const QString group = "#benchmark";
+    QRandomGenerator random(13);
+    QVector<Message> posts;
+    posts.reserve(messages);
+    qint64 baseTime = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < messages; ++i) {
+        posts.append(Message(PeerSimulator::contactName(0), syntheticMessage(random),
+                             QDateTime::fromMSecsSinceEpoch(baseTime + i), false));
+    }
+
+    qDebug().noquote() << QString("Fanout: %1 messages per group, %2 worker threads")
+                              .arg(messages)
+                              .arg(qMax(0, threads));
+
+    bool consistent = true;
+    for (int size : {10, 100, 1000}) {
+        double p50[2] = {0, 0};
+        for (int run = 0; run < 2; ++run) {
+            // First the calling thread alone, then with the workers
+            WorkStealingPool pool(run == 0 ? 0 : threads);
+            GroupFanout fanout(&pool);
+
+            QVector<ConversationStore*> stores;
+            QVector<GroupFanout::Member> members;
+            for (int i = 0; i < size; ++i) {
+                stores.append(new ConversationStore(PeerSimulator::contactName(i)));
+                members.append(GroupFanout::Member{stores.last(), i == 0});
+            }
+
+            QVector<qint64> samples;
+            samples.reserve(messages);
+            QElapsedTimer timer;
+            for (const Message &post : posts) {
+                timer.start();
+                fanout.deliver(group, post, members);
+                samples.append(timer.nsecsElapsed());
+            }
+
+            // Every member's copy of the last message is the one text, not a copy of it
+            const QChar *text = posts.last().content.constData();
+            for (ConversationStore *store : stores) {
+                QList<Message> history = store->messages(group);
+                consistent = consistent && history.size() == messages
+                             && history.last().content.constData() == text
+                             && history.last().isCurrentUser == (store == stores.first());
+            }
+            qDeleteAll(stores);
+
+            p50[run] = percentileMs(samples, 0.50);
+            qDebug().noquote() << QString("%1 members, %2: p50 %3 ms, p95 %4 ms, p99 %5 ms")
+                                      .arg(size, 4)
+                                      .arg(run == 0 ? QString("1 thread") : QString("%1 threads").arg(pool.threadCount() + 1))
+                                      .arg(p50[run], 0, 'f', 3)
+                                      .arg(percentileMs(samples, 0.95), 0, 'f', 3)
+                                      .arg(percentileMs(samples, 0.99), 0, 'f', 3);
+        }
+        qDebug().noquote() << QString("%1 members: %2x at p50 with the pool")
+                                  .arg(size, 4)
+                                  .arg(p50[1] > 0 ? p50[0] / p50[1] : 0.0, 0, 'f', 2);
+    }
+
+    if (!consistent) {
+        qDebug() << "Fanout mismatch: a member's history is missing messages or holds a copy of the text";
+    }
+    return consistent ? 0 : 1;
+}
+
+int Benchmarks::runSync(int history, const QString &server, int tcpPort)
+{
+    if (history < 1) {
+        qDebug() << "Sync benchmark needs some history";
+        return 1;
+    }
+
+    QString address = server;
+    QProcess serverProcess;
+    QTemporaryDir serverData;
+    if (address.isEmpty()) {
+        address = startServer(serverProcess, serverData.path(), tcpPort);
+        if (address.isEmpty()) return 1;
+    }
+    if (!waitForServer(address, 5000)) {
+        qDebug() << "No server listening on" << address;
+        return 1;
+    }
+
+    auto waitUntil = [](const std::function<bool()> &done, int timeoutMs) {
+        QElapsedTimer timer;
+        timer.start();
+        while (!done() && timer.elapsed() < timeoutMs) {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 50);
+        }
+        return done();
+    };
+
+    // Fresh names, so a named server has no history for them yet
+    QString suffix = QString::number(QDateTime::currentMSecsSinceEpoch());
+    ChatClient sender("Sync sender " + suffix);
+    ChatClient reader("Sync reader " + suffix);
+    int connectedCount = 0;
+    qint64 acked = 0;
+    qint64 received = 0;
+    int resets = 0;
+    QObject::connect(&sender, &ChatClient::connected, [&connectedCount]() { ++connectedCount; });
+    QObject::connect(&reader, &ChatClient::connected, [&connectedCount]() { ++connectedCount; });
+    QObject::connect(&sender, &ChatClient::messageAcked, [&acked]() { ++acked; });
+    QObject::connect(&reader, &ChatClient::messageDelivered, [&received]() { ++received; });
+    QObject::connect(&reader, &ChatClient::conversationReset, [&resets]() { ++resets; });
+    sender.connectToServer(address);
+    reader.connectToServer(address);
+    if (!waitUntil([&]() { return connectedCount == 2; }, 10000)) {
+        qDebug() << "Benchmark clients could not connect to" << address;
+        return 1;
+    }
+
+    QRandomGenerator random(17);
+    auto sendMessages = [&](int count) {
+        for (int i = 0; i < count; ++i) {
+            Message msg(sender.user(), syntheticMessage(random), QDateTime::currentDateTime(), true);
+            sender.sendMessage(reader.user(), msg);
+        }
+    };
+
+    // The history the reader saw live
+    sendMessages(history);
+    if (!waitUntil([&]() { return received == history; }, 60000)) {
+        qDebug() << "Only" << received << "of" << history << "messages arrived";
+        return 1;
+    }
+
+    qDebug().noquote() << QString("Sync over %1: reconnecting after missed messages, %2 already seen")
+                              .arg(address)
+                              .arg(history);
+
+    bool consistent = true;
+    for (int missed : {10, 100, 1000}) {
+        reader.disconnectFromServer();
+        qint64 ackTarget = acked + missed;
+        sendMessages(missed);
+        waitUntil([&]() { return acked >= ackTarget; }, 30000);
+
+        received = 0;
+        QElapsedTimer timer;
+        timer.start();
+        reader.connectToServer(address);
+        waitUntil([&]() { return received >= missed; }, 30000);
+        qint64 catchUpNs = timer.nsecsElapsed();
+
+        // Anything sent twice would turn up meanwhile
+        QElapsedTimer settle;
+        settle.start();
+        while (settle.elapsed() < 200) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+
+        qDebug().noquote() << QString("%1 missed: caught up in %2 ms, %3 messages sent again, %4 conversations sent whole")
+                                  .arg(missed, 4)
+                                  .arg(catchUpNs / 1e6, 0, 'f', 2)
+                                  .arg(received)
+                                  .arg(resets);
+        consistent = consistent && received == missed && resets == 0;
+    }
+
+    sender.disconnectFromServer();
+    reader.disconnectFromServer();
+    stopServer(serverProcess);
+
+    if (!consistent) {
+        qDebug() << "Sync mismatch: the reader got more or less than it missed";
+    }
+    return consistent ? 0 : 1;
+}
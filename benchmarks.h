@@ -0,0 +1,72 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <QString>
+#include <QStringList>
+
+// Synthetic benchmarks, run with "chatsimproj --benchmark <name> [options]".
+// Results are printed to the debug output.
+namespace Benchmarks
+{
+    int run(const QString &name, const QStringList &options);
+
+    // Bursts of incoming messages into the selected chat; reports GUI frame times
+    int runBurstInsertion(int bursts, int burstSize);
+
+    // Recency reordering and unread updates on the contacts model
+    int runContactRecency(int contacts, int messages);
+
+    // Per-keystroke latency of the contacts quick-filter
+    int runContactSearch(int contacts);
+
+    // Incoming-message bursts across several chats; reports windows created
+    // and tray balloons shown by the notification center
+    int runNotificationBurst(int messages, int contacts);
+
+    // Index build time and per-keystroke latency of global message search
+    int runMessageSearch(int messages, int contacts);
+
+    // Case-insensitive substring scan: QString::contains against
+    // FoldedStringMatcher's scalar and vector kernels
+    int runTextSearch(int messages);
+
+    // Structured queries over one long conversation: planned (date slice,
+    // then sender, then text) against checking every message
+    int runQueryPlan(int messages);
+
+    // Trigram index size per million messages, and fragment and misspelling
+    // queries against a full scan
+    int runTrigramSearch(int messages);
+
+    // Simulated contacts sending at a target rate through MessageService, with
+    // a chat window connected or headless; reports throughput and latency
+    int runPeerSimulation(int contacts, int rate, int seconds, const QString &arrival,
+                          int medianChars, bool headless, bool queued);
+
+    // Producer threads pushing messages through MessageService::ingestMessage
+    // as fast as they can; reports push throughput, how long until every
+    // message was applied, batch sizes and push-to-shown latency
+    int runIngest(int producers, int messages, int contacts, bool headless);
+
+    // Many clients exchanging messages through chatsimserver, started for the
+    // run unless `server` names one already listening; reports acknowledgement
+    // and send-to-receive latency, and send-to-display for a chat window
+    int runServerLatency(int clients, int rate, int seconds, const QString &server,
+                         int tcpPort, bool headless);
+
+    // ChatProtocol frames against JSON per message: encode and decode
+    // throughput and bytes per message
+    int runCodec(int messages);
+
+    // Group messages added to every member's history by GroupFanout, for
+    // groups of 10, 100 and 1000; reports fan-out latency with `threads`
+    // workers against the calling thread alone
+    int runFanout(int messages, int threads);
+
+    // One user drops off chatsimserver while another keeps sending, then
+    // reconnects; reports how long catching up takes and how much is sent
+    // for 10, 100 and 1000 missed messages on top of `history`
+    int runSync(int history, const QString &server, int tcpPort);
+}
+
+#endif // BENCHMARKS_H
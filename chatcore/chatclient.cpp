@@ -0,0 +1,333 @@
+#include "chatclient.h"
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+#include <algorithm>
+
+ChatClient::ChatClient(const QString &username, QObject *parent)
+    : QObject(parent), username(username), socket(nullptr), ready(false)
+{
+    reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    reconnectTimer->setInterval(1000);
+    connect(reconnectTimer, &QTimer::timeout, this, &ChatClient::openSocket);
+}
+
+ChatClient::~ChatClient()
+{
+    disconnectFromServer();
+}
+
+QString ChatClient::serverFromEnvironment()
+{
+    return qEnvironmentVariable("CHATSIM_SERVER");
+}
+
+void ChatClient::connectToServer(const QString &address)
+{
+    disconnectFromServer();
+    serverAddress = address;
+    openSocket();
+}
+
+void ChatClient::openSocket()
+{
+    closeSocket();
+    const QString &address = serverAddress;
+
+    if (address.startsWith("tcp:")) {
+        QTcpSocket *tcp = new QTcpSocket(this);
+        connect(tcp, &QTcpSocket::connected, this, &ChatClient::onConnected);
+        connect(tcp, &QTcpSocket::disconnected, this, &ChatClient::onDisconnected);
+        connect(tcp, &QTcpSocket::errorOccurred, this, [this, tcp]() {
+            qDebug() << "Server connection failed:" << tcp->errorString();
+            onDisconnected();
+        });
+        socket = tcp;
+        connect(socket, &QIODevice::readyRead, this, &ChatClient::onReadyRead);
+        tcp->connectToHost(QHostAddress::LocalHost, quint16(address.mid(4).toUInt()));
+    } else {
+        QLocalSocket *local = new QLocalSocket(this);
+        connect(local, &QLocalSocket::connected, this, &ChatClient::onConnected);
+        connect(local, &QLocalSocket::disconnected, this, &ChatClient::onDisconnected);
+        connect(local, &QLocalSocket::errorOccurred, this, [this, local]() {
+            qDebug() << "Server connection failed:" << local->errorString();
+            onDisconnected();
+        });
+        socket = local;
+        connect(socket, &QIODevice::readyRead, this, &ChatClient::onReadyRead);
+        local->connectToServer(address);
+    }
+}
+
+void ChatClient::disconnectFromServer()
+{
+    serverAddress.clear();
+    reconnectTimer->stop();
+    closeSocket();
+    outbox.clear();
+    unacked.clear();
+}
+
+void ChatClient::closeSocket()
+{
+    if (!socket) return;
+
+    QIODevice *closing = socket;
+    socket = nullptr;
+    ready = false;
+    closing->disconnect(this);
+    closing->close();
+    closing->deleteLater();
+    writer.clear();
+    reader.clear();
+    resetting.clear();
+}
+
+void ChatClient::onConnected()
+{
+    if (!socket) return;
+
+    ready = true;
+    if (QTcpSocket *tcp = qobject_cast<QTcpSocket*>(socket)) {
+        // Frames are small and latency is what is measured
+        tcp->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
+
+    // Hello and Sync go first, ahead of anything sent while connecting
+    ChatProtocol::Frame hello;
+    hello.op = ChatProtocol::Op::Hello;
+    hello.user = username;
+    writer.append(hello);
+    writer.append(syncRequest());
+
+    // Sends the last connection took without an Ack may never have reached
+    // the server; those not sent yet go now too
+    QList<ChatProtocol::Frame> retries = unacked.values();
+    std::stable_sort(retries.begin(), retries.end(), [](const ChatProtocol::Frame &a, const ChatProtocol::Frame &b) {
+        return a.time < b.time;
+    });
+    for (const ChatProtocol::Frame &send : std::as_const(retries)) {
+        writer.append(send);
+    }
+    writer.flushTo(socket);
+    outbox.flushTo(socket);
+    emit connected();
+}
+
+void ChatClient::onDisconnected()
+{
+    if (!socket) return;
+
+    closeSocket();
+    reconnectTimer->start();
+    emit disconnected();
+}
+
+void ChatClient::setSyncState(const SyncState &state)
+{
+    changeLogId = state.changeLogId;
+    sequences = state.sequences;
+}
+
+ChatClient::SyncState ChatClient::readSyncState(const QString &filePath)
+{
+    SyncState state;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) return state;
+
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    state.changeLogId = root["changeLogId"].toString();
+    QJsonObject seen = root["sequences"].toObject();
+    for (auto it = seen.constBegin(); it != seen.constEnd(); ++it) {
+        state.sequences.insert(it.key(), it.value().toVariant().toLongLong());
+    }
+    return state;
+}
+
+bool ChatClient::writeSyncState(const QString &filePath, const SyncState &state)
+{
+    QJsonObject seen;
+    for (auto it = state.sequences.constBegin(); it != state.sequences.constEnd(); ++it) {
+        seen[it.key()] = it.value();
+    }
+    QJsonObject root;
+    root["changeLogId"] = state.changeLogId;
+    root["sequences"] = seen;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+ChatProtocol::Frame ChatClient::syncRequest() const
+{
+    ChatProtocol::Frame frame;
+    frame.op = ChatProtocol::Op::Sync;
+    frame.messageId = changeLogId;
+
+    QStringList seen;
+    seen.reserve(sequences.size());
+    for (auto it = sequences.constBegin(); it != sequences.constEnd(); ++it) {
+        seen.append(it.key() + '\t' + QString::number(it.value()));
+    }
+    frame.content = seen.join('\n');
+    return frame;
+}
+
+bool ChatClient::advance(const QString &contact, const ChatProtocol::FrameView &frame)
+{
+    if (!(frame.flags & ChatProtocol::HasSequence)) return true;
+
+    qint64 &seen = sequences[contact];
+    if (frame.sequence <= seen) return false;
+    seen = frame.sequence;
+    return true;
+}
+
+void ChatClient::onReadyRead()
+{
+    if (!socket) return;
+
+    reader.readFrom(socket);
+
+    // Fields become QStrings only here, where they leave the buffer
+    ChatProtocol::FrameView frame;
+    while (reader.next(&frame)) {
+        switch (frame.op) {
+        case ChatProtocol::Op::Deliver: {
+            QString contact = frame.contact.toString();
+            bool whole = frame.flags & ChatProtocol::Reset;
+            if (!whole && !advance(contact, frame)) break;
+
+            // In a group, or for the user's own messages sent back by a sync,
+            // the author is named separately from the conversation
+            QString sender = frame.user.isEmpty() ? contact : frame.user.toString();
+            Message msg(sender, frame.content.toString(), QDateTime::fromMSecsSinceEpoch(frame.time), sender == username);
+            msg.id = frame.messageIdString();
+            if (whole) {
+                resetting[contact].append(msg);
+            } else {
+                emit messageDelivered(contact, msg);
+            }
+            break;
+        }
+        case ChatProtocol::Op::Ack: {
+            QString messageId = frame.messageIdString();
+            QString contact = unacked.take(messageId).contact;
+            if (!contact.isEmpty()) {
+                advance(contact, frame);
+            }
+            emit messageAcked(messageId);
+            break;
+        }
+        case ChatProtocol::Op::Edit: {
+            QString contact = frame.contact.toString();
+            if (advance(contact, frame)) {
+                emit messageEdited(contact, frame.messageIdString(), frame.content.toString());
+            }
+            break;
+        }
+        case ChatProtocol::Op::Delete: {
+            QString contact = frame.contact.toString();
+            if (advance(contact, frame)) {
+                emit messageDeleted(contact, frame.messageIdString());
+            }
+            break;
+        }
+        case ChatProtocol::Op::Sync: {
+            // Without a conversation: the ID the server's numbers go with
+            QString contact = frame.contact.toString();
+            if (contact.isEmpty()) {
+                changeLogId = frame.messageIdString();
+                break;
+            }
+            // Where the server's numbering of the conversation stands
+            sequences.insert(contact, frame.sequence);
+            if (frame.flags & ChatProtocol::Reset) {
+                emit conversationReset(contact, resetting.take(contact));
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        // A receiver may have disconnected, which clears the buffer
+        if (!socket) return;
+    }
+
+    if (reader.hasError()) {
+        qDebug() << "Unreadable frame from the server; disconnecting";
+        onDisconnected();
+    }
+}
+
+void ChatClient::write(const ChatProtocol::Frame &frame)
+{
+    // Held while connecting or reconnecting
+    if (serverAddress.isEmpty()) return;
+
+    outbox.append(frame);
+    if (ready) {
+        outbox.flushTo(socket);
+    }
+}
+
+void ChatClient::sendMessage(const QString &contact, const Message &msg)
+{
+    ChatProtocol::Frame frame;
+    frame.op = ChatProtocol::Op::Send;
+    frame.contact = contact;
+    frame.messageId = msg.id;
+    frame.content = msg.content;
+    frame.time = msg.timestamp.toMSecsSinceEpoch();
+    if (serverAddress.isEmpty()) return;
+
+    // Kept until its Ack, which carries the conversation's sequence number.
+    // While disconnected it waits here rather than in the outbox, so the
+    // next connection sends it once.
+    unacked.insert(msg.id, frame);
+    if (ready) {
+        write(frame);
+    }
+}
+
+void ChatClient::editMessage(const QString &contact, const QString &messageId, const QString &content)
+{
+    ChatProtocol::Frame frame;
+    frame.op = ChatProtocol::Op::Edit;
+    frame.contact = contact;
+    frame.messageId = messageId;
+    frame.content = content;
+    write(frame);
+}
+
+void ChatClient::createGroup(const QString &group, const QStringList &members)
+{
+    QStringList names = members;
+    if (!names.contains(username)) {
+        names.append(username);
+    }
+
+    ChatProtocol::Frame frame;
+    frame.op = ChatProtocol::Op::Group;
+    frame.contact = group;
+    frame.messageId = QUuid::createUuid().toString();
+    frame.content = names.join('\n');
+    write(frame);
+}
+
+void ChatClient::deleteMessage(const QString &contact, const QString &messageId)
+{
+    ChatProtocol::Frame frame;
+    frame.op = ChatProtocol::Op::Delete;
+    frame.contact = contact;
+    frame.messageId = messageId;
+    write(frame);
+}
@@ -0,0 +1,105 @@
+#ifndef CHATCLIENT_H
+#define CHATCLIENT_H
+
+#include "message.h"
+#include "chatprotocol.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+
+class QIODevice;
+class QTimer;
+
+// One user's connection to chatsimserver, over a local socket or loopback
+// TCP. Everything is event-driven on the thread that owns the client: frames
+// are written without waiting and read as they arrive. Frames sent before
+// the connection is up are held and go out once it is.
+//
+// A dropped connection is retried every second until disconnectFromServer().
+// The client remembers the sequence number of the latest change it has seen
+// in each conversation and sends them with Sync on every connection, so it
+// is sent only what it missed; a change seen already is ignored. A message
+// sent without an Ack back is sent again on the next connection, which the
+// server recognizes by its ID. Saved with
+// the chats they went into (syncState()), the numbers carry over to the next
+// run of the app.
+class ChatClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatClient(const QString &username, QObject *parent = nullptr);
+    ~ChatClient();
+
+    QString user() const { return username; }
+
+    // "tcp:<port>" connects to that port on 127.0.0.1; anything else is the
+    // name of a local socket
+    void connectToServer(const QString &address);
+    void disconnectFromServer();
+    bool isConnected() const { return ready; }
+
+    // The address in CHATSIM_SERVER, empty when the app runs on its own
+    static QString serverFromEnvironment();
+
+    // The latest change seen in the conversation, 0 for none
+    qint64 sequence(const QString &contact) const { return sequences.value(contact); }
+
+    // The server's change log ID and the numbers seen under it
+    struct SyncState {
+        QString changeLogId;
+        QHash<QString, qint64> sequences;
+    };
+    SyncState syncState() const { return SyncState{changeLogId, sequences}; }
+    // Before connecting, to pick up where an earlier run left off
+    void setSyncState(const SyncState &state);
+    // An empty state when the file is missing or unreadable
+    static SyncState readSyncState(const QString &filePath);
+    static bool writeSyncState(const QString &filePath, const SyncState &state);
+
+    void sendMessage(const QString &contact, const Message &msg);
+    void editMessage(const QString &contact, const QString &messageId, const QString &content);
+    void deleteMessage(const QString &contact, const QString &messageId);
+    // `group` starts with '#'; the user is added to the members if missing
+    void createGroup(const QString &group, const QStringList &members);
+
+signals:
+    void connected();
+    void disconnected();
+    void messageDelivered(const QString &contact, const Message &msg);
+    void messageAcked(const QString &messageId);
+    void messageEdited(const QString &contact, const QString &messageId, const QString &content);
+    void messageDeleted(const QString &contact, const QString &messageId);
+    // The server sent the conversation whole, to be merged with what is here
+    void conversationReset(const QString &contact, const QList<Message> &messages);
+
+private:
+    void openSocket();
+    void closeSocket();
+    void onConnected();
+    void onDisconnected();
+    void onReadyRead();
+    void write(const ChatProtocol::Frame &frame);
+    // False for a change seen already; otherwise records its number
+    bool advance(const QString &contact, const ChatProtocol::FrameView &frame);
+    ChatProtocol::Frame syncRequest() const;
+
+    QString username;
+    QString serverAddress;   // Empty unless connected or reconnecting
+    QIODevice *socket;
+    bool ready;
+    QTimer *reconnectTimer;
+    // Hello and Sync, first on every connection
+    ChatProtocol::Writer writer;
+    // Frames queue here until the connection is up, then go out one write each
+    ChatProtocol::Writer outbox;
+    ChatProtocol::Reader reader;
+
+    QString changeLogId;                       // The server's, for these numbers
+    QHash<QString, qint64> sequences;          // Conversation to its latest change seen
+    QHash<QString, ChatProtocol::Frame> unacked;   // Sends by message ID, until their Ack
+    QHash<QString, QList<Message>> resetting;  // Conversations being sent whole
+};
+
+#endif // CHATCLIENT_H
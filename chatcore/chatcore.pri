@@ -0,0 +1,15 @@
+# Links a project against the chatcore static library
+# ChatClient talks to chatsimserver over Qt Network
+QT += network
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CHATCORE_LIB_DIR = $$shadowed($$PWD)
+win32:CONFIG(release, debug|release): CHATCORE_LIB_DIR = $$CHATCORE_LIB_DIR/release
+else:win32:CONFIG(debug, debug|release): CHATCORE_LIB_DIR = $$CHATCORE_LIB_DIR/debug
+
+LIBS += -L$$CHATCORE_LIB_DIR -lchatcore
+
+win32:!win32-g++: PRE_TARGETDEPS += $$CHATCORE_LIB_DIR/chatcore.lib
+else: PRE_TARGETDEPS += $$CHATCORE_LIB_DIR/libchatcore.a
@@ -0,0 +1,46 @@
+# Conversations, persistence and search without any GUI dependency, so the
+# data paths can be driven and profiled headless. Clients include chatcore.pri.
+QT = core network
+
+TEMPLATE = lib
+CONFIG += staticlib c++17
+TARGET = chatcore
+
+SOURCES += \
+    chatclient.cpp \
+    chatdataloader.cpp \
+    chatprotocol.cpp \
+    contactsearchindex.cpp \
+    conversationstore.cpp \
+    foldedstringmatcher.cpp \
+    groupfanout.cpp \
+    ingestpipeline.cpp \
+    messageservice.cpp \
+    messagesearchindex.cpp \
+    peersimulator.cpp \
+    perfmonitor.cpp \
+    searchindexstore.cpp \
+    searchquery.cpp \
+    trigramindex.cpp \
+    workstealingpool.cpp
+
+HEADERS += \
+    chatclient.h \
+    chatdataloader.h \
+    chatprotocol.h \
+    contact.h \
+    contactsearchindex.h \
+    conversationstore.h \
+    foldedstringmatcher.h \
+    groupfanout.h \
+    ingestpipeline.h \
+    message.h \
+    messageservice.h \
+    messagesearchindex.h \
+    mpscqueue.h \
+    peersimulator.h \
+    perfmonitor.h \
+    searchindexstore.h \
+    searchquery.h \
+    trigramindex.h \
+    workstealingpool.h
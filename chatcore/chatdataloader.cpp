@@ -0,0 +1,248 @@
+#include "chatdataloader.h"
+#include "messagesearchindex.h"
+#include <QThread>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <algorithm>
+
+ChatDataLoader::ChatDataLoader(const QString &username, QObject *parent)
+    : QObject(parent), username(username), thread(nullptr), cancelled(false), done(false),
+    buffering(false), contactsBuffered(false), bufferedFromFile(false), loadedIndex(nullptr), indexReady(false),
+    loadedCount(0), totalCount(0), loadMs(0)
+{
+}
+
+ChatDataLoader::~ChatDataLoader()
+{
+    // Results still queued for this object are dropped with it
+    cancelled = true;
+    if (thread) {
+        thread->wait();
+        delete thread;
+    }
+    delete loadedIndex;
+}
+
+QString ChatDataLoader::contactsFilePath(const QString &username)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    // Make contacts file user-specific
+    return QDir(dataDir).filePath(QString("contacts_%1.json").arg(username));
+}
+
+QString ChatDataLoader::chatsFilePath(const QString &username)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    // Make chat file user-specific
+    return QDir(dataDir).filePath(QString("chats_%1.json").arg(username));
+}
+
+QString ChatDataLoader::changeLogFilePath(const QString &username)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    return QDir(dataDir).filePath(QString("changelog_%1.json").arg(username));
+}
+
+QString ChatDataLoader::syncFilePath(const QString &username)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    return QDir(dataDir).filePath(QString("sync_%1.json").arg(username));
+}
+
+void ChatDataLoader::start()
+{
+    if (thread) return;
+
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("ChatDataLoader");
+    thread->start();
+}
+
+void ChatDataLoader::discard()
+{
+    cancelled = true;
+    if (thread) {
+        connect(thread, &QThread::finished, this, &QObject::deleteLater);
+    }
+    // Covers a worker that exited before the connection was made
+    if (!thread || thread->isFinished()) {
+        deleteLater();
+    }
+}
+
+void ChatDataLoader::deliverBuffered()
+{
+    if (!buffering) return;
+    buffering = false;
+
+    if (contactsBuffered) {
+        emit contactsLoaded(bufferedContacts, bufferedFromFile);
+        bufferedContacts.clear();
+    }
+    deliverIndex();
+    if (!bufferedChats.isEmpty()) {
+        // Already read, so handed over in one batch
+        ConversationBatch conversations;
+        conversations.swap(bufferedChats);
+        emit chatsLoaded(conversations);
+        emit progress(loadedCount, totalCount);
+    }
+    if (done) {
+        emit finished(loadMs);
+    }
+}
+
+void ChatDataLoader::deliverContacts(const QList<Contact> &contacts, bool fromFile)
+{
+    if (buffering) {
+        contactsBuffered = true;
+        bufferedContacts = contacts;
+        bufferedFromFile = fromFile;
+        return;
+    }
+    emit contactsLoaded(contacts, fromFile);
+}
+
+void ChatDataLoader::deliverIndex()
+{
+    if (buffering || !indexReady) return;
+    indexReady = false;
+
+    MessageSearchIndex *index = loadedIndex;
+    loadedIndex = nullptr;
+    emit indexLoaded(index, loadedIndexState);
+}
+
+void ChatDataLoader::deliverChats(const ConversationBatch &conversations, int loaded, int total)
+{
+    loadedCount = loaded;
+    totalCount = total;
+    if (buffering) {
+        bufferedChats.append(conversations);
+        return;
+    }
+    emit chatsLoaded(conversations);
+    emit progress(loaded, total);
+}
+
+void ChatDataLoader::deliverFinished(qint64 elapsedMs, const QByteArray &digest)
+{
+    done = true;
+    loadMs = elapsedMs;
+    loadedDigest = digest;
+    if (!buffering) {
+        emit finished(elapsedMs);
+    }
+}
+
+void ChatDataLoader::run()
+{
+    // Runs on the worker thread; everything it produces is posted back
+    // to this object's thread as queued calls
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<Contact> contacts;
+    bool contactsFromFile = false;
+    QFile contactsFile(contactsFilePath(username));
+    if (contactsFile.exists() && contactsFile.open(QIODevice::ReadOnly)) {
+        QJsonArray contactsArray = QJsonDocument::fromJson(contactsFile.readAll()).array();
+        contacts.reserve(contactsArray.size());
+        for (const QJsonValue &value : contactsArray) {
+            contacts.append(Contact::fromJson(value.toObject()));
+        }
+        contactsFromFile = true;
+    }
+
+    QMetaObject::invokeMethod(this, [this, contacts, contactsFromFile]() {
+        deliverContacts(contacts, contactsFromFile);
+    }, Qt::QueuedConnection);
+
+    QByteArray chatsBytes;
+    QByteArray digest;
+    QFile chatsFile(chatsFilePath(username));
+    bool chatsRead = !cancelled && chatsFile.exists() && chatsFile.open(QIODevice::ReadOnly);
+    if (chatsRead) {
+        chatsBytes = chatsFile.readAll();
+        digest = SearchIndexStore::chatsDigest(chatsBytes);
+    }
+
+    // Checked against the chats content before it is parsed, so search
+    // works while the history is still on its way
+    if (chatsRead && !cancelled) {
+        loadedIndex = SearchIndexStore::load(username, chatsBytes.size(), digest, &loadedIndexState);
+        if (loadedIndex) {
+            indexReady = true;
+            QMetaObject::invokeMethod(this, [this]() { deliverIndex(); }, Qt::QueuedConnection);
+        }
+    }
+
+    QJsonObject chatsObject;
+    if (chatsRead && !cancelled) {
+        chatsObject = QJsonDocument::fromJson(chatsBytes).object();
+    }
+    chatsBytes.clear();
+
+    // Oldest conversations first: applying each one as "most recent" leaves
+    // the contacts list in recency order without a model reset
+    QVector<QPair<QDateTime, QString>> order;
+    order.reserve(chatsObject.size());
+    for (auto it = chatsObject.constBegin(); it != chatsObject.constEnd(); ++it) {
+        QJsonArray messagesArray = it.value().toArray();
+        QDateTime last;
+        if (!messagesArray.isEmpty()) {
+            last = Message::fromJson(messagesArray.last().toObject()).timestamp;
+        }
+        order.append(qMakePair(last, it.key()));
+    }
+    std::stable_sort(order.begin(), order.end(), [](const QPair<QDateTime, QString> &a,
+                                                     const QPair<QDateTime, QString> &b) {
+        return a.first < b.first;
+    });
+
+    const int total = order.size();
+    int loaded = 0;
+    int batchMessages = 0;
+    ConversationBatch batch;
+
+    auto flush = [&]() {
+        if (batch.isEmpty()) return;
+        QMetaObject::invokeMethod(this, [this, batch, loaded, total]() {
+            deliverChats(batch, loaded, total);
+        }, Qt::QueuedConnection);
+        batch.clear();
+        batchMessages = 0;
+    };
+
+    for (const auto &entry : std::as_const(order)) {
+        if (cancelled) return;
+
+        QJsonArray messagesArray = chatsObject.value(entry.second).toArray();
+        QList<Message> messages;
+        messages.reserve(messagesArray.size());
+        for (const QJsonValue &value : messagesArray) {
+            messages.append(Message::fromJson(value.toObject()));
+        }
+
+        batchMessages += messages.size();
+        batch.append(qMakePair(entry.second, messages));
+        ++loaded;
+        if (batchMessages >= BatchMessages) {
+            flush();
+        }
+    }
+    flush();
+
+    qint64 elapsed = timer.elapsed();
+    QMetaObject::invokeMethod(this, [this, elapsed, digest]() {
+        deliverFinished(elapsed, digest);
+    }, Qt::QueuedConnection);
+}
@@ -0,0 +1,90 @@
+#ifndef CHATDATALOADER_H
+#define CHATDATALOADER_H
+
+#include "message.h"
+#include "contact.h"
+#include "searchindexstore.h"
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <atomic>
+
+class QThread;
+
+// Reads a user's contacts and chat history on a worker thread and hands the
+// results to the GUI thread in pieces: contacts first, then conversations in
+// batches, oldest activity first so each batch can be applied as recency moves.
+// A persisted search index that still matches the chats file is handed over
+// between the two, so search works before the history is parsed.
+class ChatDataLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatDataLoader(const QString &username, QObject *parent = nullptr);
+    ~ChatDataLoader();
+
+    static QString contactsFilePath(const QString &username);
+    static QString chatsFilePath(const QString &username);
+    // What a server connection has seen (see ChatClient::SyncState)
+    static QString syncFilePath(const QString &username);
+    // The change log a server keeps with the history (see ConversationStore)
+    static QString changeLogFilePath(const QString &username);
+
+    QString user() const { return username; }
+
+    void start();
+    bool isFinished() const { return done; }
+    // SearchIndexStore::chatsDigest() of the chats file as it was read;
+    // empty until finished, or when there is no chats file
+    QByteArray chatsDigest() const { return loadedDigest; }
+
+    // A prefetching loader keeps what it has read until someone takes it.
+    // deliverBuffered() replays it as signals and then streams as usual.
+    void setBuffered(bool buffer) { buffering = buffer; }
+    void deliverBuffered();
+
+    // Stops reading and deletes the loader once the worker has exited,
+    // without blocking the caller on a file still being parsed
+    void discard();
+
+    // Messages per batch handed to the GUI thread
+    static const int BatchMessages = 2000;
+
+signals:
+    // fromFile is false when the user has no contacts file yet
+    void contactsLoaded(const QList<Contact> &contacts, bool fromFile);
+    // Not emitted when there is no usable index; the receiver owns `index`
+    void indexLoaded(MessageSearchIndex *index, const SearchIndexStore::State &state);
+    void chatsLoaded(const ConversationBatch &conversations);
+    void progress(int conversationsLoaded, int conversationsTotal);
+    void finished(qint64 elapsedMs);
+
+private:
+    void run();
+    void deliverContacts(const QList<Contact> &contacts, bool fromFile);
+    void deliverIndex();
+    void deliverChats(const ConversationBatch &conversations, int loaded, int total);
+    void deliverFinished(qint64 elapsedMs, const QByteArray &digest);
+
+    QString username;
+    QThread *thread;
+    std::atomic<bool> cancelled;
+    bool done;
+
+    // Results held back while buffering
+    bool buffering;
+    bool contactsBuffered;
+    QList<Contact> bufferedContacts;
+    bool bufferedFromFile;
+    // Written by the worker before it sets indexReady; owned here until delivered
+    MessageSearchIndex *loadedIndex;
+    SearchIndexStore::State loadedIndexState;
+    std::atomic<bool> indexReady;
+    ConversationBatch bufferedChats;
+    int loadedCount;
+    int totalCount;
+    qint64 loadMs;
+    QByteArray loadedDigest;
+};
+
+#endif // CHATDATALOADER_H
@@ -0,0 +1,309 @@
+#include "chatprotocol.h"
+#include <QIODevice>
+#include <QUuid>
+#include <QtEndian>
+#include <cstring>
+
+namespace
+{
+// Bounds-checked reads from a frame body
+struct Cursor {
+    const char *p;
+    const char *end;
+
+    bool u8(quint8 *value)
+    {
+        if (end - p < 1) return false;
+        *value = quint8(*p++);
+        return true;
+    }
+    bool i64(qint64 *value)
+    {
+        if (end - p < 8) return false;
+        *value = qFromLittleEndian<qint64>(p);
+        p += 8;
+        return true;
+    }
+    bool bytes(int size, ChatProtocol::Bytes *value)
+    {
+        if (size < 0 || end - p < size) return false;
+        value->data = p;
+        value->size = size;
+        p += size;
+        return true;
+    }
+    bool str16(ChatProtocol::Bytes *value)
+    {
+        if (end - p < 2) return false;
+        int size = qFromLittleEndian<quint16>(p);
+        p += 2;
+        return bytes(size, value);
+    }
+    bool str32(ChatProtocol::Bytes *value)
+    {
+        if (end - p < 4) return false;
+        quint32 size = qFromLittleEndian<quint32>(p);
+        p += 4;
+        return size <= quint32(ChatProtocol::MaxFrameBytes) && bytes(int(size), value);
+    }
+    bool id(quint8 flags, ChatProtocol::Bytes *value)
+    {
+        return (flags & ChatProtocol::IdIsUuid) ? bytes(16, value) : str16(value);
+    }
+};
+
+// UTF-16 to UTF-8 straight into `out`, which has room for 3 bytes per
+// QChar; unpaired surrogates become U+FFFD. Returns the bytes written.
+int writeUtf8(char *out, const QString &text)
+{
+    const QChar *chars = text.constData();
+    const int length = text.size();
+    uchar *o = reinterpret_cast<uchar*>(out);
+
+    for (int i = 0; i < length; ++i) {
+        uint c = chars[i].unicode();
+        if (c < 0x80) {
+            *o++ = uchar(c);
+            continue;
+        }
+        if (c < 0x800) {
+            *o++ = uchar(0xc0 | (c >> 6));
+            *o++ = uchar(0x80 | (c & 0x3f));
+            continue;
+        }
+        if (QChar::isSurrogate(c)) {
+            if (QChar::isHighSurrogate(c) && i + 1 < length && chars[i + 1].isLowSurrogate()) {
+                uint code = QChar::surrogateToUcs4(ushort(c), chars[++i].unicode());
+                *o++ = uchar(0xf0 | (code >> 18));
+                *o++ = uchar(0x80 | ((code >> 12) & 0x3f));
+                *o++ = uchar(0x80 | ((code >> 6) & 0x3f));
+                *o++ = uchar(0x80 | (code & 0x3f));
+                continue;
+            }
+            c = 0xfffd;
+        }
+        *o++ = uchar(0xe0 | (c >> 12));
+        *o++ = uchar(0x80 | ((c >> 6) & 0x3f));
+        *o++ = uchar(0x80 | (c & 0x3f));
+    }
+    return int(o - reinterpret_cast<uchar*>(out));
+}
+
+// Encodes into `out`; the caller has reserved the worst case
+struct Encoder {
+    char *p;
+
+    void u8(quint8 value) { *p++ = char(value); }
+    void i64(qint64 value) { qToLittleEndian<qint64>(value, p); p += 8; }
+    void str16(const QString &text)
+    {
+        char *sizeAt = p;
+        p += 2;
+        int size = writeUtf8(p, text);
+        // Names and IDs are short; anything longer is cut at the last whole
+        // character within the limit, never inside one
+        if (size > 0xffff) {
+            size = 0xffff;
+            while (size > 0 && (uchar(p[size]) & 0xc0) == 0x80) {
+                --size;
+            }
+        }
+        qToLittleEndian<quint16>(quint16(size), sizeAt);
+        p += size;
+    }
+    void str32(const QString &text)
+    {
+        char *sizeAt = p;
+        p += 4;
+        int size = writeUtf8(p, text);
+        qToLittleEndian<quint32>(quint32(size), sizeAt);
+        p += size;
+    }
+    void uuid(const QUuid &uuid)
+    {
+        // RFC 4122 byte order, as QUuid::toRfc4122() but without the QByteArray
+        qToBigEndian<quint32>(uuid.data1, p);
+        qToBigEndian<quint16>(uuid.data2, p + 4);
+        qToBigEndian<quint16>(uuid.data3, p + 6);
+        std::memcpy(p + 8, uuid.data4, 8);
+        p += 16;
+    }
+};
+
+bool hasContact(ChatProtocol::Op op)
+{
+    return op != ChatProtocol::Op::Hello && op != ChatProtocol::Op::Ack;
+}
+
+bool hasContent(ChatProtocol::Op op)
+{
+    return op == ChatProtocol::Op::Send || op == ChatProtocol::Op::Deliver
+           || op == ChatProtocol::Op::Edit || op == ChatProtocol::Op::Group
+           || op == ChatProtocol::Op::Sync;
+}
+
+bool hasTime(ChatProtocol::Op op)
+{
+    return op == ChatProtocol::Op::Send || op == ChatProtocol::Op::Deliver;
+}
+}
+
+QString ChatProtocol::FrameView::messageIdString() const
+{
+    if (!(flags & IdIsUuid)) return messageId.toString();
+    return QUuid::fromRfc4122(QByteArray::fromRawData(messageId.data, messageId.size)).toString();
+}
+
+ChatProtocol::Reader::Reader()
+    : begin(0), end(0), error(false)
+{
+    buffer.resize(64 * 1024);
+}
+
+void ChatProtocol::Reader::clear()
+{
+    begin = 0;
+    end = 0;
+    error = false;
+}
+
+char *ChatProtocol::Reader::reserve(int size)
+{
+    // Only a partial frame is left before the unread bytes, so this moves little
+    if (begin > 0) {
+        std::memmove(buffer.data(), buffer.constData() + begin, size_t(end - begin));
+        end -= begin;
+        begin = 0;
+    }
+    if (buffer.size() < end + size) {
+        buffer.resize(qMax(end + size, buffer.size() * 2));
+    }
+    return buffer.data() + end;
+}
+
+void ChatProtocol::Reader::readFrom(QIODevice *device)
+{
+    qint64 available = device->bytesAvailable();
+    if (available <= 0) return;
+
+    char *target = reserve(int(qMin<qint64>(available, MaxFrameBytes)));
+    qint64 read = device->read(target, qMin<qint64>(available, MaxFrameBytes));
+    if (read > 0) {
+        end += int(read);
+    }
+}
+
+void ChatProtocol::Reader::append(const char *data, int size)
+{
+    std::memcpy(reserve(size), data, size_t(size));
+    end += size;
+}
+
+bool ChatProtocol::Reader::next(FrameView *frame)
+{
+    if (error || end - begin < 4) return false;
+
+    const char *start = buffer.constData() + begin;
+    quint32 length = qFromLittleEndian<quint32>(start);
+    if (length < 2 || length > quint32(MaxFrameBytes)) {
+        error = true;
+        return false;
+    }
+    if (quint32(end - begin - 4) < length) return false;
+
+    Cursor cursor{start + 4, start + 4 + length};
+    quint8 op = 0;
+    *frame = FrameView();
+    bool ok = cursor.u8(&op) && cursor.u8(&frame->flags) && op <= quint8(Op::Sync);
+    frame->op = Op(op);
+
+    if (ok && frame->op == Op::Hello) {
+        ok = cursor.str16(&frame->user);
+    } else if (ok) {
+        if (hasContact(frame->op)) ok = cursor.str16(&frame->contact);
+        ok = ok && cursor.id(frame->flags, &frame->messageId);
+        if (hasTime(frame->op)) ok = ok && cursor.i64(&frame->time);
+        if (hasContent(frame->op)) ok = ok && cursor.str32(&frame->content);
+        if (frame->op == Op::Deliver && (frame->flags & HasSender)) ok = ok && cursor.str16(&frame->user);
+        if (frame->flags & HasSequence) ok = ok && cursor.i64(&frame->sequence);
+    }
+    if (!ok) {
+        error = true;
+        return false;
+    }
+
+    begin += 4 + int(length);
+    if (begin == end) {
+        begin = 0;
+        end = 0;
+    }
+    return true;
+}
+
+ChatProtocol::Writer::Writer()
+{
+    buffer.reserve(64 * 1024);
+}
+
+void ChatProtocol::Writer::clear()
+{
+    buffer.resize(0);
+}
+
+void ChatProtocol::Writer::append(const Frame &frame)
+{
+    // A message ID that is a QUuid in its usual form goes as 16 bytes. Only
+    // the exact form QUuid::toString() gives back, lowercase in braces, so
+    // the peer decodes the same string.
+    QUuid uuid;
+    bool idIsUuid = false;
+    if (frame.messageId.size() == 38) {
+        uuid = QUuid(frame.messageId);
+        idIsUuid = !uuid.isNull() && uuid.toString() == frame.messageId;
+    }
+    bool hasSender = frame.op == Op::Deliver && !frame.user.isEmpty();
+    bool hasSequence = frame.op != Op::Hello && frame.sequence > 0;
+
+    // Worst case: 3 UTF-8 bytes per QChar
+    int worst = 4 + 2 + 2 + 3 * frame.user.size() + 2 + 3 * frame.contact.size()
+                + 2 + 3 * frame.messageId.size() + 8 + 4 + 3 * frame.content.size() + 8;
+    int start = buffer.size();
+    buffer.resize(start + worst);
+
+    Encoder encoder{buffer.data() + start + 4};
+    encoder.u8(quint8(frame.op));
+    encoder.u8(quint8((idIsUuid ? IdIsUuid : 0) | (hasSender ? HasSender : 0)
+                      | (hasSequence ? HasSequence : 0) | (frame.reset ? Reset : 0)));
+    if (frame.op == Op::Hello) {
+        encoder.str16(frame.user);
+    } else {
+        if (hasContact(frame.op)) encoder.str16(frame.contact);
+        if (idIsUuid) {
+            encoder.uuid(uuid);
+        } else {
+            encoder.str16(frame.messageId);
+        }
+        if (hasTime(frame.op)) encoder.i64(frame.time);
+        if (hasContent(frame.op)) encoder.str32(frame.content);
+        if (hasSender) encoder.str16(frame.user);
+        // Last, where setLastSequence() finds it
+        if (hasSequence) encoder.i64(frame.sequence);
+    }
+
+    int length = int(encoder.p - (buffer.constData() + start + 4));
+    qToLittleEndian<quint32>(quint32(length), buffer.data() + start);
+    // Shrinking keeps the capacity
+    buffer.resize(start + 4 + length);
+}
+
+void ChatProtocol::Writer::setLastSequence(qint64 sequence)
+{
+    qToLittleEndian<qint64>(sequence, buffer.data() + buffer.size() - 8);
+}
+
+void ChatProtocol::Writer::flushTo(QIODevice *device)
+{
+    if (buffer.isEmpty()) return;
+    device->write(buffer);
+    clear();
+}
@@ -0,0 +1,143 @@
+#ifndef CHATPROTOCOL_H
+#define CHATPROTOCOL_H
+
+#include <QString>
+#include <QByteArray>
+
+class QIODevice;
+
+// What ChatClient and chatsimserver say to each other. A connection opens
+// with Hello naming the user; after that the client sends Send, Edit and
+// Delete for a contact, and the server answers each Send with an Ack and
+// passes it on to the contact as a Deliver. Edit and Delete are passed on
+// the same way. `contact` is the other side of the conversation from the
+// point of view of whoever receives the frame.
+//
+// A contact whose name starts with '#' is a group. Group creates or
+// replaces one, with its members' names in `content`, one per line; a Send
+// to it reaches every other member as a Deliver from the group that names
+// its author.
+//
+// Every change to a conversation has a sequence number, counted per user
+// and conversation (see ConversationStore). The server puts it on what it
+// sends about a conversation: Deliver, Edit and Delete, and the Ack of a
+// Send. A client that reconnects sends Sync with the numbers it has seen
+// and gets back only what came after them; see ChatServer for the reply.
+//
+// Frames are binary and length-prefixed, integers little-endian:
+//   u32 length      bytes after this field
+//   u8  op
+//   u8  flags       IdIsUuid: the message ID is 16 raw bytes
+//                   HasSender: a Deliver ends with str16 user, its author
+//                   HasSequence: the frame ends with i64 sequence
+//                   Reset: part of a conversation sent whole (see Sync)
+//   Hello           str16 user
+//   Send, Deliver   str16 contact, id, i64 time (ms since the epoch), str32 content
+//   Ack             id
+//   Edit, Group     str16 contact, id, str32 content
+//   Sync            str16 contact, id, str32 content
+//   Delete          str16 contact, id
+// where strN is a uN byte count and UTF-8, and id is 16 bytes or a str16.
+// A typical Send is roughly half the size of Message::toJson as compact JSON.
+namespace ChatProtocol
+{
+    enum class Op : quint8 { Hello, Send, Deliver, Ack, Edit, Delete, Group, Sync };
+
+    enum Flag : quint8 { IdIsUuid = 0x01, HasSender = 0x02, HasSequence = 0x04, Reset = 0x08 };
+
+    inline bool isGroup(const QString &contact) { return contact.startsWith(QLatin1Char('#')); }
+
+    // Frames larger than this are treated as a broken stream
+    const int MaxFrameBytes = 16 * 1024 * 1024;
+
+    // Local socket name, or "tcp:<port>" for loopback TCP
+    const char *const DefaultServer = "chatsim";
+
+    // A frame to send, with its own copies of every field
+    struct Frame {
+        Op op = Op::Hello;
+        QString user;        // Hello; Deliver from a group: the author
+        QString contact;     // All but Hello and Ack
+        QString messageId;   // All but Hello; Sync: the change log's ID
+        QString content;     // Send, Deliver, Edit; Group: members, one per line;
+                             // Sync to the server: "contact\tsequence" per line
+        qint64 time = 0;     // Send, Deliver
+        qint64 sequence = 0; // Sent when above 0
+        bool reset = false;  // Deliver and Sync: the Reset flag
+    };
+
+    // UTF-8 bytes inside a Reader's buffer
+    struct Bytes {
+        const char *data = nullptr;
+        int size = 0;
+
+        QString toString() const { return QString::fromUtf8(data, size); }
+        bool isEmpty() const { return size == 0; }
+    };
+
+    // A received frame, read in place: the fields point into the Reader's
+    // buffer and nothing is allocated until a field is turned into a QString
+    struct FrameView {
+        Op op = Op::Hello;
+        quint8 flags = 0;
+        Bytes user;
+        Bytes contact;
+        Bytes messageId;     // 16 bytes when flags has IdIsUuid
+        Bytes content;
+        qint64 time = 0;
+        qint64 sequence = 0;
+
+        QString messageIdString() const;
+    };
+
+    // Receive buffer for one connection, reused for its lifetime. Bytes are
+    // read from the device straight into it; a partial frame stays and is
+    // moved to the front before the next read.
+    class Reader
+    {
+    public:
+        Reader();
+
+        // Reads everything the device has ready
+        void readFrom(QIODevice *device);
+        void append(const char *data, int size);
+        void clear();
+
+        // The next complete frame, valid until the next readFrom(), append()
+        // or clear(). False when none is complete or the stream is broken.
+        bool next(FrameView *frame);
+        bool hasError() const { return error; }
+
+    private:
+        char *reserve(int size);
+
+        QByteArray buffer;
+        int begin;           // First unread byte
+        int end;             // One past the last byte read
+        bool error;
+    };
+
+    // Send buffer, reused: frames are encoded straight into it, UTF-8
+    // included, then handed to the device in one write
+    class Writer
+    {
+    public:
+        Writer();
+
+        void append(const Frame &frame);
+        // Rewrites the sequence of the frame appended last, which has one, so
+        // copies that differ only in their sequence are encoded once
+        void setLastSequence(qint64 sequence);
+        const QByteArray &data() const { return buffer; }
+        bool isEmpty() const { return buffer.isEmpty(); }
+        // Keeps the capacity
+        void clear();
+        // Writes everything appended so far, then clears
+        void flushTo(QIODevice *device);
+
+    private:
+        QByteArray buffer;
+    };
+}
+
+#endif // CHATPROTOCOL_H
@@ -0,0 +1,38 @@
+#ifndef CONTACT_H
+#define CONTACT_H
+
+#include <QString>
+#include <QUuid>
+#include <QJsonObject>
+
+struct Contact {
+    QString id;           // Stable identifier, survives renames
+    QString name;
+    QString phone;
+    Contact() {
+        id = QUuid::createUuid().toString();
+    }
+    Contact(const QString &n, const QString &p) : name(n), phone(p) {
+        id = QUuid::createUuid().toString();
+    }
+
+    // Methods for JSON serialization
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["id"] = id;
+        obj["name"] = name;
+        obj["phone"] = phone;
+        return obj;
+    }
+
+    static Contact fromJson(const QJsonObject &obj) {
+        Contact contact(obj["name"].toString(), obj["phone"].toString());
+        // Keep the generated ID if not present (for backward compatibility)
+        if (!obj["id"].toString().isEmpty()) {
+            contact.id = obj["id"].toString();
+        }
+        return contact;
+    }
+};
+
+#endif // CONTACT_H
@@ -0,0 +1,255 @@
+#include "contactsearchindex.h"
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace
+{
+// Shorter words would match too much of the list after an edit
+const int MinimumFuzzyLength = 3;
+
+int maxEditsFor(const QString &token)
+{
+    return token.size() <= 4 ? 1 : 2;
+}
+}
+
+ContactSearchIndex::ContactSearchIndex()
+{
+}
+
+QStringList ContactSearchIndex::keysFor(const Contact &contact)
+{
+    static const QRegularExpression separators("[^\\w]+");
+
+    QStringList result = contact.name.toCaseFolded().split(separators, Qt::SkipEmptyParts);
+
+    QString digits;
+    for (QChar ch : contact.phone) {
+        if (ch.isDigit()) digits.append(ch);
+    }
+    if (!digits.isEmpty()) {
+        result.append(digits);
+    }
+
+    result.removeDuplicates();
+    return result;
+}
+
+QStringList ContactSearchIndex::queryTokens(const QString &query)
+{
+    static const QRegularExpression separators("[^\\w]+");
+    return query.toCaseFolded().split(separators, Qt::SkipEmptyParts);
+}
+
+int ContactSearchIndex::allocateHandle(const QString &contactId)
+{
+    int handle;
+    if (!freeHandles.isEmpty()) {
+        handle = freeHandles.takeLast();
+        idByHandle[handle] = contactId;
+    } else {
+        handle = idByHandle.size();
+        idByHandle.append(contactId);
+        keysByHandle.append(QStringList());
+        matchCounts.append(0);
+    }
+    handleById.insert(contactId, handle);
+    return handle;
+}
+
+void ContactSearchIndex::clear()
+{
+    keys.clear();
+    idByHandle.clear();
+    keysByHandle.clear();
+    handleById.clear();
+    freeHandles.clear();
+    matchCounts.clear();
+}
+
+void ContactSearchIndex::setContacts(const QList<Contact> &contacts)
+{
+    clear();
+
+    idByHandle.reserve(contacts.size());
+    keysByHandle.reserve(contacts.size());
+    keys.reserve(contacts.size() * 3);
+
+    for (const Contact &contact : contacts) {
+        int handle = allocateHandle(contact.id);
+        QStringList contactKeys = keysFor(contact);
+        for (const QString &text : contactKeys) {
+            keys.append({text, handle});
+        }
+        keysByHandle[handle] = contactKeys;
+    }
+
+    std::sort(keys.begin(), keys.end());
+}
+
+void ContactSearchIndex::addContact(const Contact &contact)
+{
+    if (handleById.contains(contact.id)) {
+        removeContact(contact.id);
+    }
+
+    int handle = allocateHandle(contact.id);
+    QStringList contactKeys = keysFor(contact);
+    for (const QString &text : contactKeys) {
+        Key key{text, handle};
+        keys.insert(std::upper_bound(keys.begin(), keys.end(), key), key);
+    }
+    keysByHandle[handle] = contactKeys;
+}
+
+void ContactSearchIndex::removeContact(const QString &contactId)
+{
+    int handle = handleById.value(contactId, -1);
+    if (handle < 0) return;
+
+    for (const QString &text : std::as_const(keysByHandle[handle])) {
+        Key probe{text, handle};
+        auto range = std::equal_range(keys.begin(), keys.end(), probe);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->handle == handle) {
+                keys.erase(it);
+                break;
+            }
+        }
+    }
+
+    handleById.remove(contactId);
+    idByHandle[handle].clear();
+    keysByHandle[handle].clear();
+    freeHandles.append(handle);
+}
+
+int ContactSearchIndex::rangeStart(const QString &prefix) const
+{
+    return std::lower_bound(keys.begin(), keys.end(), prefix,
+                            [](const Key &key, const QString &value) { return key.text < value; })
+           - keys.begin();
+}
+
+int ContactSearchIndex::rangeEnd(const QString &prefix) const
+{
+    // Every key starting with `prefix` sorts below prefix + U+FFFF
+    return rangeStart(prefix + QChar(0xFFFF));
+}
+
+template <typename Fn>
+void ContactSearchIndex::forEachPrefixMatch(const QString &prefix, Fn match) const
+{
+    int end = rangeEnd(prefix);
+    for (int i = rangeStart(prefix); i < end; ++i) {
+        match(keys[i].handle);
+    }
+}
+
+template <typename Fn>
+void ContactSearchIndex::forEachFuzzyMatch(const QString &token, int maxDistance, Fn match) const
+{
+    // Walks the sorted keys as a trie. rows[d] is the edit-distance row for
+    // the first d characters of the current key against the token; keys
+    // sharing a prefix with the previous one reuse its rows.
+    const int m = token.size();
+    QVector<QVector<int>> rows(1, QVector<int>(m + 1));
+    for (int j = 0; j <= m; ++j) {
+        rows[0][j] = j;
+    }
+
+    QString pathKey;
+    int i = 0;
+    while (i < keys.size()) {
+        const QString &text = keys[i].text;
+
+        int depth = 0;
+        int shared = qMin(pathKey.size(), text.size());
+        while (depth < shared && pathKey[depth] == text[depth]) {
+            ++depth;
+        }
+        pathKey = text;
+
+        int next = i + 1;
+        for (int d = depth + 1; d <= text.size(); ++d) {
+            if (rows.size() <= d) {
+                rows.append(QVector<int>(m + 1));
+            }
+            const QVector<int> &above = rows[d - 1];
+            QVector<int> &row = rows[d];
+            row[0] = d;
+            int rowMin = row[0];
+            for (int j = 1; j <= m; ++j) {
+                int cost = (text[d - 1] == token[j - 1]) ? 0 : 1;
+                row[j] = qMin(qMin(above[j] + 1, row[j - 1] + 1), above[j - 1] + cost);
+                rowMin = qMin(rowMin, row[j]);
+            }
+
+            if (row[m] <= maxDistance) {
+                // This prefix is close enough: every key below it matches
+                QString prefix = text.left(d);
+                next = rangeEnd(prefix);
+                for (int k = i; k < next; ++k) {
+                    match(keys[k].handle);
+                }
+                pathKey = prefix;
+                break;
+            }
+            if (rowMin > maxDistance) {
+                // No extension of this prefix can get close enough
+                QString prefix = text.left(d);
+                next = rangeEnd(prefix);
+                pathKey = prefix;
+                break;
+            }
+        }
+        i = qMax(next, i + 1);
+    }
+}
+
+QVector<QString> ContactSearchIndex::intersect(const QStringList &tokens, bool fuzzy) const
+{
+    // matchCounts[h] == t means the contact matched the first t tokens
+    QVector<int> candidates;
+    for (int t = 0; t < tokens.size(); ++t) {
+        auto mark = [&](int handle) {
+            if (matchCounts[handle] == t) {
+                matchCounts[handle] = t + 1;
+                if (t == 0) candidates.append(handle);
+            }
+        };
+
+        const QString &token = tokens[t];
+        if (fuzzy && token.size() >= MinimumFuzzyLength) {
+            forEachFuzzyMatch(token, maxEditsFor(token), mark);
+        } else {
+            forEachPrefixMatch(token, mark);
+        }
+    }
+
+    QVector<QString> result;
+    for (int handle : std::as_const(candidates)) {
+        if (matchCounts[handle] == tokens.size()) {
+            result.append(idByHandle[handle]);
+        }
+        matchCounts[handle] = 0;
+    }
+    return result;
+}
+
+QVector<QString> ContactSearchIndex::search(const QString &query, bool *fuzzy) const
+{
+    if (fuzzy) *fuzzy = false;
+
+    QStringList tokens = queryTokens(query);
+    if (tokens.isEmpty()) {
+        return QVector<QString>();
+    }
+
+    QVector<QString> result = intersect(tokens, false);
+    if (result.isEmpty()) {
+        result = intersect(tokens, true);
+        if (fuzzy) *fuzzy = true;
+    }
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef CONTACTSEARCHINDEX_H
+#define CONTACTSEARCHINDEX_H
+
+#include "contact.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+// Prefix index for the contacts quick-filter. Every contact contributes one
+// key per name word plus the digits of its phone number; keys are kept in a
+// sorted array, which acts as a flattened trie: a prefix is a contiguous
+// range found by binary search. When no contact matches exactly, the same
+// array is walked as a trie with an edit-distance row per depth so that
+// typos still find the contact.
+class ContactSearchIndex
+{
+public:
+    ContactSearchIndex();
+
+    // Bulk build, O(n log n)
+    void setContacts(const QList<Contact> &contacts);
+    void addContact(const Contact &contact);
+    void removeContact(const QString &contactId);
+    void clear();
+
+    // Contact IDs matching every word of the query as a prefix. Falls back to
+    // fuzzy matching when nothing matches exactly; `fuzzy` reports which ran.
+    QVector<QString> search(const QString &query, bool *fuzzy = nullptr) const;
+
+    int contactCount() const { return handleById.size(); }
+    int keyCount() const { return keys.size(); }
+
+private:
+    struct Key {
+        QString text;
+        int handle;
+        bool operator<(const Key &other) const { return text < other.text; }
+    };
+
+    static QStringList keysFor(const Contact &contact);
+    static QStringList queryTokens(const QString &query);
+    int allocateHandle(const QString &contactId);
+
+    // Calls `match` with the handle of every key that starts with `prefix`
+    template <typename Fn> void forEachPrefixMatch(const QString &prefix, Fn match) const;
+    // Same for keys whose prefix is within `maxDistance` edits of `token`
+    template <typename Fn> void forEachFuzzyMatch(const QString &token, int maxDistance, Fn match) const;
+
+    QVector<QString> intersect(const QStringList &tokens, bool fuzzy) const;
+    int rangeStart(const QString &prefix) const;
+    int rangeEnd(const QString &prefix) const;
+
+    QVector<Key> keys;                 // Sorted by text
+    QVector<QString> idByHandle;       // Empty for freed handles
+    QVector<QStringList> keysByHandle; // For removal
+    QHash<QString, int> handleById;
+    QVector<int> freeHandles;
+
+    // Scratch space for intersecting token matches without allocating per query
+    mutable QVector<int> matchCounts;
+};
+
+#endif // CONTACTSEARCHINDEX_H
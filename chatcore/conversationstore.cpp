@@ -0,0 +1,430 @@
+#include "conversationstore.h"
+#include "chatdataloader.h"
+#include "messagesearchindex.h"
+#include "trigramindex.h"
+#include "perfmonitor.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <QSet>
+#include <algorithm>
+
+ConversationStore::ConversationStore(const QString &username)
+    : username(username), logId(QUuid::createUuid().toString()), changeLogLimit(0), indexFromDisk(false)
+{
+    messageIndex = new MessageSearchIndex();
+    trigramIndex = TrigramIndex::isEnabled() ? new TrigramIndex() : nullptr;
+    indexStore = new SearchIndexStore(username);
+}
+
+ConversationStore::~ConversationStore()
+{
+    // Waits for a segment still being written
+    delete indexStore;
+    delete messageIndex;
+    delete trigramIndex;
+}
+
+void ConversationStore::setContacts(const QList<Contact> &contacts)
+{
+    contactList = contacts;
+}
+
+QStringList ConversationStore::contactNames() const
+{
+    QStringList names;
+    for (const Contact &contact : contactList) {
+        names.append(contact.name);
+    }
+    return names;
+}
+
+int ConversationStore::contactIndex(const QString &name) const
+{
+    for (int i = 0; i < contactList.size(); ++i) {
+        if (contactList[i].name == name) return i;
+    }
+    return -1;
+}
+
+bool ConversationStore::isNameTaken(const QString &name, int except) const
+{
+    for (int i = 0; i < contactList.size(); ++i) {
+        if (i != except && contactList[i].name.toLower() == name.toLower()) return true;
+    }
+    return false;
+}
+
+void ConversationStore::addContact(const Contact &contact)
+{
+    contactList.append(contact);
+}
+
+void ConversationStore::updateContact(const QString &oldName, const Contact &contact)
+{
+    int index = contactIndex(oldName);
+    if (index < 0) return;
+    contactList[index] = contact;
+
+    // Update chat history if contact name changed
+    if (oldName != contact.name && chatHistory.contains(oldName)) {
+        chatHistory[contact.name] = chatHistory.take(oldName);
+        messageIndex->renameContact(oldName, contact.name);
+        if (trigramIndex) trigramIndex->renameContact(oldName, contact.name);
+        restartChangeLog(oldName);
+        restartChangeLog(contact.name);
+    }
+}
+
+void ConversationStore::removeContact(const QString &name)
+{
+    int index = contactIndex(name);
+    if (index >= 0) {
+        contactList.removeAt(index);
+    }
+
+    chatHistory.remove(name);
+    messageIndex->removeContact(name);
+    if (trigramIndex) trigramIndex->removeContact(name);
+    // Numbered on, so a re-added contact's changes never reuse a number
+    restartChangeLog(name);
+}
+
+const Message *ConversationStore::findMessage(const QString &contact, const QString &messageId) const
+{
+    auto it = chatHistory.constFind(contact);
+    if (it == chatHistory.constEnd()) return nullptr;
+
+    // Lookups are mostly for recent messages, so search from the end of the history
+    const QList<Message> &messages = it.value();
+    for (int i = messages.size() - 1; i >= 0; --i) {
+        if (messages[i].id == messageId) return &messages[i];
+    }
+    return nullptr;
+}
+
+void ConversationStore::appendMessage(const QString &contact, const Message &msg)
+{
+    chatHistory[contact].append(msg);
+    messageIndex->addMessage(contact, msg);
+    if (trigramIndex) trigramIndex->addMessage(contact, msg);
+    logChange(contact, Operation::Added, msg);
+}
+
+void ConversationStore::appendPrepared(const QString &contact, const Message &msg, const MessageSearchIndex::Change &change)
+{
+    chatHistory[contact].append(msg);
+    messageIndex->addPrepared(change);
+    if (trigramIndex) trigramIndex->addMessage(contact, msg);
+    logChange(contact, Operation::Added, msg);
+}
+
+const Message *ConversationStore::editMessage(const QString &contact, const QString &messageId, const QString &content)
+{
+    auto it = chatHistory.find(contact);
+    if (it == chatHistory.end()) return nullptr;
+
+    QList<Message> &messages = it.value();
+    for (int i = messages.size() - 1; i >= 0; --i) {
+        if (messages[i].id != messageId) continue;
+        messages[i].content = content;
+        messageIndex->updateMessage(contact, messages[i]);
+        if (trigramIndex) trigramIndex->updateMessage(contact, messages[i]);
+        logChange(contact, Operation::Edited, messages[i]);
+        return &messages[i];
+    }
+    return nullptr;
+}
+
+bool ConversationStore::removeMessage(const QString &contact, const QString &messageId)
+{
+    auto it = chatHistory.find(contact);
+    if (it == chatHistory.end()) return false;
+
+    QList<Message> &messages = it.value();
+    for (int i = messages.size() - 1; i >= 0; --i) {
+        if (messages[i].id != messageId) continue;
+        Message removed = messages.takeAt(i);
+        messageIndex->removeMessage(messageId);
+        if (trigramIndex) trigramIndex->removeMessage(messageId);
+        logChange(contact, Operation::Removed, removed);
+        return true;
+    }
+    return false;
+}
+
+bool ConversationStore::mergeLoadedConversation(const QString &contact, const QList<Message> &messages)
+{
+    QList<Message> &history = chatHistory[contact];
+    bool hadLiveMessages = !history.isEmpty();
+
+    // Anything already here arrived while loading and is newer
+    history = messages + history;
+    if (!indexFromDisk) {
+        messageIndex->addConversation(contact, messages);
+    } else {
+        messageIndex->attachText(messages);
+    }
+    // Not persisted, so always built from the loaded history
+    if (trigramIndex) trigramIndex->addConversation(contact, messages);
+    if (!messages.isEmpty()) {
+        restartChangeLog(contact);
+    }
+    return !hadLiveMessages;
+}
+
+void ConversationStore::mergeConversation(const QString &contact, const QList<Message> &messages)
+{
+    QSet<QString> sent;
+    sent.reserve(messages.size());
+    for (const Message &msg : messages) {
+        sent.insert(msg.id);
+    }
+
+    QList<Message> &history = chatHistory[contact];
+    QList<Message> merged = messages;
+    for (const Message &msg : std::as_const(history)) {
+        if (!sent.contains(msg.id)) merged.append(msg);
+    }
+    std::stable_sort(merged.begin(), merged.end(), [](const Message &a, const Message &b) {
+        return a.timestamp < b.timestamp;
+    });
+    history = merged;
+
+    messageIndex->removeContact(contact);
+    messageIndex->addConversation(contact, merged);
+    if (trigramIndex) {
+        trigramIndex->removeContact(contact);
+        trigramIndex->addConversation(contact, merged);
+    }
+    restartChangeLog(contact);
+}
+
+qint64 ConversationStore::sequence(const QString &contact) const
+{
+    auto it = changeLogs.constFind(contact);
+    return it == changeLogs.constEnd() ? 0 : it->sequence;
+}
+
+bool ConversationStore::operationsSince(const QString &contact, qint64 since, QList<Operation> *operations) const
+{
+    operations->clear();
+    auto it = changeLogs.constFind(contact);
+    if (it == changeLogs.constEnd()) return since == 0;
+
+    // The kept changes are numbered without gaps up to the latest
+    const ChangeLog &log = it.value();
+    qint64 missed = log.sequence - since;
+    if (missed < 0 || missed > log.operations.size()) return false;
+
+    *operations = log.operations.mid(log.operations.size() - int(missed));
+    return true;
+}
+
+void ConversationStore::logChange(const QString &contact, Operation::Kind kind, const Message &msg)
+{
+    ChangeLog &log = changeLogs[contact];
+    ++log.sequence;
+    if (changeLogLimit <= 0) return;
+
+    log.operations.append(Operation{kind, log.sequence, msg});
+    if (log.operations.size() > changeLogLimit) {
+        log.operations.removeFirst();
+    }
+}
+
+void ConversationStore::restartChangeLog(const QString &contact)
+{
+    ChangeLog &log = changeLogs[contact];
+    ++log.sequence;
+    log.operations.clear();
+}
+
+bool ConversationStore::saveChangeLog(const QByteArray &chatsDigest) const
+{
+    QJsonObject conversationsObject;
+    for (auto it = changeLogs.constBegin(); it != changeLogs.constEnd(); ++it) {
+        QJsonArray operationsArray;
+        for (const Operation &operation : it.value().operations) {
+            QJsonObject obj;
+            obj["kind"] = int(operation.kind);
+            obj["sequence"] = operation.sequence;
+            obj["message"] = operation.message.toJson();
+            operationsArray.append(obj);
+        }
+        QJsonObject logObject;
+        logObject["sequence"] = it.value().sequence;
+        logObject["operations"] = operationsArray;
+        conversationsObject[it.key()] = logObject;
+    }
+
+    QJsonObject root;
+    root["id"] = logId;
+    root["chats"] = QString::fromLatin1(chatsDigest);
+    root["conversations"] = conversationsObject;
+
+    QSaveFile file(changeLogFilePath());
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(QJsonDocument(root).toJson());
+    return file.commit();
+}
+
+bool ConversationStore::restoreChangeLog(const QByteArray &chatsDigest)
+{
+    QFile file(changeLogFilePath());
+    if (chatsDigest.isEmpty() || !file.open(QIODevice::ReadOnly)) return false;
+
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root["chats"].toString().toLatin1() != chatsDigest || root["id"].toString().isEmpty()) return false;
+
+    logId = root["id"].toString();
+    QJsonObject conversationsObject = root["conversations"].toObject();
+    for (auto it = conversationsObject.constBegin(); it != conversationsObject.constEnd(); ++it) {
+        QJsonObject logObject = it.value().toObject();
+        qint64 saved = logObject["sequence"].toVariant().toLongLong();
+        ChangeLog &log = changeLogs[it.key()];
+
+        // Only the restart for the loaded history: the saved log describes it
+        if (log.sequence <= 1 && log.operations.isEmpty()) {
+            log.sequence = saved;
+            for (const QJsonValue &value : logObject["operations"].toArray()) {
+                QJsonObject obj = value.toObject();
+                log.operations.append(Operation{Operation::Kind(obj["kind"].toInt()),
+                                                obj["sequence"].toVariant().toLongLong(),
+                                                Message::fromJson(obj["message"].toObject())});
+            }
+            continue;
+        }
+        // Changed while loading: numbered after the saved changes, and
+        // anyone behind gets the conversation whole
+        log.sequence += saved;
+        log.operations.clear();
+    }
+    return true;
+}
+
+void ConversationStore::adoptSearchIndex(MessageSearchIndex *index, const SearchIndexStore::State &state)
+{
+    // Live messages are not in the chats file yet, so they go in as journaled changes
+    index->setJournaling(true);
+    for (auto it = chatHistory.constBegin(); it != chatHistory.constEnd(); ++it) {
+        index->addConversation(it.key(), it.value());
+    }
+
+    delete messageIndex;
+    messageIndex = index;
+    indexFromDisk = true;
+    indexStore->adopt(state);
+}
+
+QString ConversationStore::contactsFilePath() const
+{
+    return ChatDataLoader::contactsFilePath(username);
+}
+
+QString ConversationStore::chatsFilePath() const
+{
+    return ChatDataLoader::chatsFilePath(username);
+}
+
+QString ConversationStore::syncFilePath() const
+{
+    return ChatDataLoader::syncFilePath(username);
+}
+
+QString ConversationStore::changeLogFilePath() const
+{
+    return ChatDataLoader::changeLogFilePath(username);
+}
+
+bool ConversationStore::saveContacts() const
+{
+    QJsonArray contactsArray;
+    for (const Contact &contact : contactList) {
+        contactsArray.append(contact.toJson());
+    }
+
+    QJsonDocument doc(contactsArray);
+
+    QFile file(contactsFilePath());
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(doc.toJson());
+    return true;
+}
+
+bool ConversationStore::saveChats()
+{
+    ChatsSnapshot snapshot = snapshotChats();
+    bool written = writeSnapshot(chatsFilePath(), &snapshot);
+    finishSave(snapshot, written);
+    // After the chats, and stamped with them, so a log is never taken for
+    // a file it does not describe
+    if (written && changeLogLimit > 0 && !saveChangeLog(snapshot.chatsDigest)) {
+        qDebug() << "Could not write" << changeLogFilePath();
+    }
+    return written;
+}
+
+ConversationStore::ChatsSnapshot ConversationStore::snapshotChats()
+{
+    ChatsSnapshot snapshot;
+    snapshot.conversations = chatHistory;
+    snapshot.index = indexStore->prepareCommit(messageIndex);
+    return snapshot;
+}
+
+bool ConversationStore::writeChats(const QString &filePath, const QMap<QString, QList<Message>> &conversations,
+                                   QByteArray *digest)
+{
+    QJsonObject chatsObject;
+
+    for (auto it = conversations.begin(); it != conversations.end(); ++it) {
+        const QString &contact = it.key();
+        const QList<Message> &messages = it.value();
+
+        QJsonArray messagesArray;
+        for (const Message &msg : messages) {
+            messagesArray.append(msg.toJson());
+        }
+
+        chatsObject[contact] = messagesArray;
+    }
+
+    QByteArray bytes = QJsonDocument(chatsObject).toJson();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    if (file.write(bytes) != bytes.size()) return false;
+    file.close();
+    if (digest) {
+        *digest = SearchIndexStore::chatsDigest(bytes);
+    }
+    return true;
+}
+
+bool ConversationStore::writeSnapshot(const QString &filePath, ChatsSnapshot *snapshot)
+{
+    if (!writeChats(filePath, snapshot->conversations, &snapshot->chatsDigest)) return false;
+    // The index is stamped with the file as just written
+    SearchIndexStore::writeCommit(&snapshot->index, filePath, snapshot->chatsDigest);
+    return true;
+}
+
+void ConversationStore::finishSave(const ChatsSnapshot &snapshot, bool written)
+{
+    PerfScope scope(QStringLiteral("index.commit"));
+    if (written) {
+        indexStore->finishCommit(snapshot.index, messageIndex);
+    } else {
+        indexStore->abandon(messageIndex);
+    }
+}
+
+void ConversationStore::commitSearchIndex()
+{
+    PerfScope scope(QStringLiteral("index.commit"));
+    indexStore->commit(messageIndex, chatsFilePath());
+}
@@ -0,0 +1,158 @@
+#ifndef CONVERSATIONSTORE_H
+#define CONVERSATIONSTORE_H
+
+#include "message.h"
+#include "contact.h"
+#include "searchindexstore.h"
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QMap>
+#include <QHash>
+
+class MessageSearchIndex;
+class TrigramIndex;
+
+// A user's contacts and chat history, with the search indexes kept in step
+// and the files they are saved to. Every change to a conversation goes
+// through here, so the message index, the optional trigram index and the
+// persisted index always describe the history as it is. No timers and no
+// widgets: MessageService decides when changes are saved.
+//
+// Every change to a conversation also takes the next number in that
+// conversation's sequence, so "what changed after n" has an answer. The
+// numbers restart with the store and changeLogId() tells one store's
+// numbers from another's; with a limit set, each conversation's latest
+// changes are kept to answer it. With a limit, saveChats() also saves the
+// log next to the chats file, and restoreChangeLog() carries it on in the
+// next store, so the numbers survive a restart.
+class ConversationStore
+{
+public:
+    explicit ConversationStore(const QString &username);
+    ~ConversationStore();
+
+    QString user() const { return username; }
+
+    // Contacts, in list order
+    const QList<Contact> &contacts() const { return contactList; }
+    void setContacts(const QList<Contact> &contacts);
+    QStringList contactNames() const;
+    // -1 when there is no contact with that name
+    int contactIndex(const QString &name) const;
+    // Names compare case-insensitively; the contact at `except` is skipped
+    bool isNameTaken(const QString &name, int except = -1) const;
+    void addContact(const Contact &contact);
+    // Replaces the contact called `oldName`; its history follows a rename
+    void updateContact(const QString &oldName, const Contact &contact);
+    // Removes the contact and its history
+    void removeContact(const QString &name);
+
+    // Conversations by contact name, each oldest first
+    const QMap<QString, QList<Message>> &conversations() const { return chatHistory; }
+    // Implicitly shared, so a worker can read it while messages are appended
+    QList<Message> messages(const QString &contact) const { return chatHistory.value(contact); }
+    bool hasConversation(const QString &contact) const { return chatHistory.contains(contact); }
+    const Message *findMessage(const QString &contact, const QString &messageId) const;
+
+    void appendMessage(const QString &contact, const Message &msg);
+    // As appendMessage(), with the search index change prepared on another thread
+    void appendPrepared(const QString &contact, const Message &msg, const MessageSearchIndex::Change &change);
+    // The edited message, or nullptr if the conversation has no such message
+    const Message *editMessage(const QString &contact, const QString &messageId, const QString &content);
+    bool removeMessage(const QString &contact, const QString &messageId);
+
+    // Loaded history goes before anything that arrived while loading.
+    // Returns false if the conversation already had messages.
+    bool mergeLoadedConversation(const QString &contact, const QList<Message> &messages);
+    // Takes in a conversation sent whole, as a client does when it has
+    // fallen too far behind the server: its messages replace those with the
+    // same ID, the ones only here (such as sends not yet acknowledged) are
+    // kept, and the result is put back in time order
+    void mergeConversation(const QString &contact, const QList<Message> &messages);
+
+    struct Operation {
+        enum Kind : quint8 { Added, Edited, Removed };
+        Kind kind;
+        qint64 sequence;
+        Message message;     // As it was after the change
+    };
+    QString changeLogId() const { return logId; }
+    // The number of the conversation's latest change, 0 before the first
+    qint64 sequence(const QString &contact) const;
+    // Changes kept per conversation; 0, the default, keeps only the numbers
+    void setChangeLogLimit(int operations) { changeLogLimit = operations; }
+    // The changes after `since`, oldest first. False when they are no longer
+    // all kept; the conversation then has to be sent whole.
+    bool operationsSince(const QString &contact, qint64 since, QList<Operation> *operations) const;
+    // Once the history has loaded, with the digest of the chats file it was
+    // loaded from (ChatDataLoader::chatsDigest()): takes over the log saved
+    // with that file. A conversation changed while loading keeps only its
+    // numbers, moved past the saved ones. False, with nothing changed, when
+    // no log was saved with that file.
+    bool restoreChangeLog(const QByteArray &chatsDigest);
+    // Replaces the index being built with one read from disk. Arrives before
+    // any history, so the messages already here are the live ones.
+    void adoptSearchIndex(MessageSearchIndex *index, const SearchIndexStore::State &state);
+    bool isSearchIndexFromDisk() const { return indexFromDisk; }
+
+    MessageSearchIndex *searchIndex() const { return messageIndex; }
+    // Null unless CHATSIM_TRIGRAM_INDEX is set
+    TrigramIndex *fragmentIndex() const { return trigramIndex; }
+
+    QString contactsFilePath() const;
+    QString chatsFilePath() const;
+    QString syncFilePath() const;
+    QString changeLogFilePath() const;
+    bool saveContacts() const;
+    // Writes the chats file, then commits the search index against it
+    bool saveChats();
+
+    // saveChats() in three steps, so the files can be written on another
+    // thread: take a snapshot, write it anywhere, then finish the save here.
+    // The history and index may change in between; only one save at a time.
+    struct ChatsSnapshot {
+        QMap<QString, QList<Message>> conversations;   // Implicitly shared
+        SearchIndexStore::PendingCommit index;
+        QByteArray chatsDigest;   // Set by writeSnapshot()
+    };
+    ChatsSnapshot snapshotChats();
+    // `digest`, if given, gets the SearchIndexStore::chatsDigest() of what was written
+    static bool writeChats(const QString &filePath, const QMap<QString, QList<Message>> &conversations,
+                           QByteArray *digest = nullptr);
+    // Safe on any thread: the chats file, then the search index delta and
+    // manifest that go with it. False if the chats file was not written.
+    static bool writeSnapshot(const QString &filePath, ChatsSnapshot *snapshot);
+    void finishSave(const ChatsSnapshot &snapshot, bool written);
+    // Stamps the index with the chats file as it is on disk now
+    void commitSearchIndex();
+
+private:
+    struct ChangeLog {
+        qint64 sequence = 0;
+        QList<Operation> operations;   // The latest, the last one numbered `sequence`
+    };
+
+    void logChange(const QString &contact, Operation::Kind kind, const Message &msg);
+    // For a change the log can't describe, such as history loaded from
+    // disk: takes a number and drops the kept changes, so anyone behind it
+    // gets the conversation whole
+    void restartChangeLog(const QString &contact);
+    bool saveChangeLog(const QByteArray &chatsDigest) const;
+
+    QString username;
+    QList<Contact> contactList;
+    QMap<QString, QList<Message>> chatHistory;
+    QHash<QString, ChangeLog> changeLogs;
+    QString logId;
+    int changeLogLimit;
+
+    MessageSearchIndex *messageIndex;
+    TrigramIndex *trigramIndex;
+    // Persists the index with every chats save; when it was loaded from
+    // there, loaded history is not indexed again
+    SearchIndexStore *indexStore;
+    bool indexFromDisk;
+};
+
+#endif // CONVERSATIONSTORE_H
@@ -0,0 +1,279 @@
+#include "foldedstringmatcher.h"
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FOLDED_MATCHER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FOLDED_MATCHER_AVX2_TARGET
+#else
+#define FOLDED_MATCHER_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+// Anchors with more variants than this go through the scalar loop
+const int MaxAnchorVariants = 4;
+
+bool vectorEnabled = true;
+
+inline char32_t foldUnit(char16_t unit)
+{
+    // ASCII folds with a range check; everything else asks Qt
+    if (unit < 0x80) {
+        return (unit >= 'A' && unit <= 'Z') ? char32_t(unit | 0x20) : char32_t(unit);
+    }
+    return QChar::toCaseFolded(uint(unit));
+}
+
+// Compares text[position..] with a folded pattern, folding the text side.
+// Surrogate pairs are folded as one code point, as QString does.
+bool equalsFoldedAt(const char16_t *text, int position, const char16_t *pattern, int patternLength)
+{
+    const char16_t *window = text + position;
+    for (int k = 0; k < patternLength; ++k) {
+        char16_t unit = window[k];
+
+        if (QChar::isHighSurrogate(unit) && k + 1 < patternLength && QChar::isLowSurrogate(window[k + 1])) {
+            char16_t low = window[k + 1];
+            ++k;
+            if (unit == pattern[k - 1] && low == pattern[k]) continue;
+
+            char32_t folded = QChar::toCaseFolded(uint(QChar::surrogateToUcs4(unit, low)));
+            if (QChar::highSurrogate(uint(folded)) != pattern[k - 1]
+                || QChar::lowSurrogate(uint(folded)) != pattern[k]) {
+                return false;
+            }
+            continue;
+        }
+
+        if (unit != pattern[k] && foldUnit(unit) != pattern[k]) return false;
+    }
+    return true;
+}
+
+#ifdef FOLDED_MATCHER_X86
+struct AnchorSet {
+    char16_t first[MaxAnchorVariants];
+    char16_t last[MaxAnchorVariants];
+};
+
+AnchorSet makeAnchors(const std::vector<char16_t> &first, const std::vector<char16_t> &last)
+{
+    // Unused slots repeat the first variant so every compare is meaningful
+    AnchorSet anchors;
+    for (int i = 0; i < MaxAnchorVariants; ++i) {
+        anchors.first[i] = first[i < int(first.size()) ? i : 0];
+        anchors.last[i] = last[i < int(last.size()) ? i : 0];
+    }
+    return anchors;
+}
+
+// Scans 8 starting positions per step. Returns the match or -1, and in
+// `resume` the first position left for the scalar tail.
+int scanSse2(const char16_t *text, int length, int from, const char16_t *pattern, int patternLength,
+             const AnchorSet &anchors, int *resume)
+{
+    const __m128i f0 = _mm_set1_epi16(short(anchors.first[0]));
+    const __m128i f1 = _mm_set1_epi16(short(anchors.first[1]));
+    const __m128i f2 = _mm_set1_epi16(short(anchors.first[2]));
+    const __m128i f3 = _mm_set1_epi16(short(anchors.first[3]));
+    const __m128i l0 = _mm_set1_epi16(short(anchors.last[0]));
+    const __m128i l1 = _mm_set1_epi16(short(anchors.last[1]));
+    const __m128i l2 = _mm_set1_epi16(short(anchors.last[2]));
+    const __m128i l3 = _mm_set1_epi16(short(anchors.last[3]));
+    const int lastOffset = patternLength - 1;
+
+    int i = from;
+    for (; i + lastOffset + 8 <= length; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + lastOffset));
+
+        __m128i firstHit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(a, f0), _mm_cmpeq_epi16(a, f1)),
+                                        _mm_or_si128(_mm_cmpeq_epi16(a, f2), _mm_cmpeq_epi16(a, f3)));
+        __m128i lastHit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(b, l0), _mm_cmpeq_epi16(b, l1)),
+                                       _mm_or_si128(_mm_cmpeq_epi16(b, l2), _mm_cmpeq_epi16(b, l3)));
+
+        // Two mask bits per 16-bit lane
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(firstHit, lastHit)));
+        while (mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+#else
+            int bit = __builtin_ctz(mask);
+#endif
+            int position = i + int(bit) / 2;
+            if (equalsFoldedAt(text, position, pattern, patternLength)) return position;
+            mask &= mask - 1;
+            mask &= mask - 1;
+        }
+    }
+    *resume = i;
+    return -1;
+}
+
+// Same as scanSse2 with 16 positions per step
+FOLDED_MATCHER_AVX2_TARGET
+int scanAvx2(const char16_t *text, int length, int from, const char16_t *pattern, int patternLength,
+             const AnchorSet &anchors, int *resume)
+{
+    const __m256i f0 = _mm256_set1_epi16(short(anchors.first[0]));
+    const __m256i f1 = _mm256_set1_epi16(short(anchors.first[1]));
+    const __m256i f2 = _mm256_set1_epi16(short(anchors.first[2]));
+    const __m256i f3 = _mm256_set1_epi16(short(anchors.first[3]));
+    const __m256i l0 = _mm256_set1_epi16(short(anchors.last[0]));
+    const __m256i l1 = _mm256_set1_epi16(short(anchors.last[1]));
+    const __m256i l2 = _mm256_set1_epi16(short(anchors.last[2]));
+    const __m256i l3 = _mm256_set1_epi16(short(anchors.last[3]));
+    const int lastOffset = patternLength - 1;
+
+    int i = from;
+    for (; i + lastOffset + 16 <= length; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + lastOffset));
+
+        __m256i firstHit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(a, f0), _mm256_cmpeq_epi16(a, f1)),
+                                           _mm256_or_si256(_mm256_cmpeq_epi16(a, f2), _mm256_cmpeq_epi16(a, f3)));
+        __m256i lastHit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(b, l0), _mm256_cmpeq_epi16(b, l1)),
+                                          _mm256_or_si256(_mm256_cmpeq_epi16(b, l2), _mm256_cmpeq_epi16(b, l3)));
+
+        unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_and_si256(firstHit, lastHit)));
+        while (mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+#else
+            int bit = __builtin_ctz(mask);
+#endif
+            int position = i + int(bit) / 2;
+            if (equalsFoldedAt(text, position, pattern, patternLength)) return position;
+            mask &= mask - 1;
+            mask &= mask - 1;
+        }
+    }
+    *resume = i;
+    return -1;
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!osSavesAvx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+const bool hasAvx2 = cpuHasAvx2();
+#endif
+}
+
+FoldedStringMatcher::FoldedStringMatcher(const QString &pattern)
+    : folded(pattern.toCaseFolded())
+{
+    if (folded.isEmpty()) return;
+
+    const char16_t *units = reinterpret_cast<const char16_t *>(folded.constData());
+    char16_t first = units[0];
+    char16_t last = units[folded.size() - 1];
+
+    // Surrogate anchors would need pair-aware folding; those patterns stay scalar
+    if (QChar::isSurrogate(first) || QChar::isSurrogate(last)) return;
+
+    std::vector<char16_t> firsts = foldVariants(first);
+    std::vector<char16_t> lasts = foldVariants(last);
+    if (int(firsts.size()) > MaxAnchorVariants || int(lasts.size()) > MaxAnchorVariants) return;
+
+    firstVariants = firsts;
+    lastVariants = lasts;
+}
+
+std::vector<char16_t> FoldedStringMatcher::foldVariants(char16_t unit)
+{
+    // Built once: every BMP unit whose folding differs from itself, by target.
+    // This is how U+212A KELVIN SIGN ends up as a variant of 'k'.
+    static const std::unordered_map<char16_t, std::vector<char16_t>> sources = []() {
+        std::unordered_map<char16_t, std::vector<char16_t>> table;
+        for (uint u = 0; u <= 0xFFFF; ++u) {
+            if (QChar::isSurrogate(u)) continue;
+            uint target = QChar::toCaseFolded(u);
+            if (target != u && target <= 0xFFFF) {
+                table[char16_t(target)].push_back(char16_t(u));
+            }
+        }
+        return table;
+    }();
+
+    std::vector<char16_t> variants{unit};
+    auto it = sources.find(unit);
+    if (it != sources.end()) {
+        variants.insert(variants.end(), it->second.begin(), it->second.end());
+    }
+    return variants;
+}
+
+const char *FoldedStringMatcher::kernelName()
+{
+#ifdef FOLDED_MATCHER_X86
+    if (!vectorEnabled) return "scalar";
+    return hasAvx2 ? "avx2" : "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void FoldedStringMatcher::setVectorEnabled(bool enabled)
+{
+    vectorEnabled = enabled;
+}
+
+int FoldedStringMatcher::indexIn(const QString &text, int from) const
+{
+    const int length = text.size();
+    const int patternLength = folded.size();
+    if (from < 0) from = qMax(0, from + length);
+    if (patternLength == 0) return from <= length ? from : -1;
+    if (length - from < patternLength) return -1;
+
+    const char16_t *units = reinterpret_cast<const char16_t *>(text.constData());
+
+#ifdef FOLDED_MATCHER_X86
+    if (vectorEnabled && !firstVariants.empty()) {
+        const char16_t *pattern = reinterpret_cast<const char16_t *>(folded.constData());
+        AnchorSet anchors = makeAnchors(firstVariants, lastVariants);
+        int resume = from;
+        int found = hasAvx2 ? scanAvx2(units, length, from, pattern, patternLength, anchors, &resume)
+                            : scanSse2(units, length, from, pattern, patternLength, anchors, &resume);
+        if (found >= 0) return found;
+        from = resume;
+    }
+#endif
+
+    return indexInScalar(units, length, from);
+}
+
+int FoldedStringMatcher::indexInScalar(const char16_t *text, int length, int from) const
+{
+    const char16_t *pattern = reinterpret_cast<const char16_t *>(folded.constData());
+    const int patternLength = folded.size();
+    const char16_t first = pattern[0];
+
+    for (int position = from; position + patternLength <= length; ++position) {
+        // Cheap reject on the first unit before the full compare
+        char16_t unit = text[position];
+        if (unit != first && !QChar::isHighSurrogate(unit) && foldUnit(unit) != first) continue;
+        if (equalsFoldedAt(text, position, pattern, patternLength)) return position;
+    }
+    return -1;
+}
@@ -0,0 +1,41 @@
+#ifndef FOLDEDSTRINGMATCHER_H
+#define FOLDEDSTRINGMATCHER_H
+
+#include <QString>
+#include <vector>
+
+// Case-insensitive substring search over UTF-16, with the same matching
+// rules as QString::indexOf(..., Qt::CaseInsensitive) (simple case folding
+// per code point). Like QStringMatcher the pattern is prepared once and can
+// be run over many texts. On x86 the scan is vectorized with SSE2, or AVX2
+// when the CPU has it: the first and last pattern units are compared against
+// every code unit that folds to them, and only positions where both line up
+// are verified. Other platforms use the scalar loop.
+class FoldedStringMatcher
+{
+public:
+    explicit FoldedStringMatcher(const QString &pattern);
+
+    int indexIn(const QString &text, int from = 0) const;
+    bool matches(const QString &text) const { return indexIn(text) >= 0; }
+
+    QString pattern() const { return folded; }
+
+    // Kernel picked for this CPU: "avx2", "sse2" or "scalar"
+    static const char *kernelName();
+    // Forces the scalar loop, for comparing kernels in benchmarks
+    static void setVectorEnabled(bool enabled);
+
+private:
+    // Code units that fold to `unit`, itself included
+    static std::vector<char16_t> foldVariants(char16_t unit);
+
+    int indexInScalar(const char16_t *text, int length, int from) const;
+
+    QString folded;
+    // Anchors for the vector scan; empty if the pattern can't use it
+    std::vector<char16_t> firstVariants;
+    std::vector<char16_t> lastVariants;
+};
+
+#endif // FOLDEDSTRINGMATCHER_H
@@ -0,0 +1,26 @@
+#include "groupfanout.h"
+#include "conversationstore.h"
+#include "messagesearchindex.h"
+#include "workstealingpool.h"
+
+GroupFanout::GroupFanout(WorkStealingPool *pool)
+    : pool(pool)
+{
+}
+
+void GroupFanout::deliver(const QString &group, const Message &msg, const QVector<Member> &members)
+{
+    // Every member indexes the same words under the same conversation name
+    const MessageSearchIndex::Change change = MessageSearchIndex::prepareAdd(group, msg);
+    Message received = msg;
+    received.isCurrentUser = false;
+    Message sent = msg;
+    sent.isCurrentUser = true;
+
+    pool->parallelFor(members.size(), Grain, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const Member &member = members[i];
+            member.store->appendPrepared(group, member.isAuthor ? sent : received, change);
+        }
+    });
+}
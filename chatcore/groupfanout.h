@@ -0,0 +1,38 @@
+#ifndef GROUPFANOUT_H
+#define GROUPFANOUT_H
+
+#include "message.h"
+#include <QString>
+#include <QVector>
+
+class ConversationStore;
+class WorkStealingPool;
+
+// Adds a group message to the group's conversation in every member's
+// store, in parallel on a WorkStealingPool. The message is tokenized once
+// and every member's copy shares its text: Message's strings are
+// implicitly shared, so a member's copy costs reference counts, not text.
+//
+// Members' stores must be distinct and untouched by anything else during
+// deliver(), which returns once every copy is in place.
+class GroupFanout
+{
+public:
+    struct Member {
+        ConversationStore *store;
+        bool isAuthor;      // The author's copy is marked as sent by them
+    };
+
+    explicit GroupFanout(WorkStealingPool *pool);
+
+    void deliver(const QString &group, const Message &msg, const QVector<Member> &members);
+
+    // Members per range; a member's append is a few microseconds, so
+    // smaller ranges cost more in splitting than they gain in balance
+    static const int Grain = 16;
+
+private:
+    WorkStealingPool *pool;
+};
+
+#endif // GROUPFANOUT_H
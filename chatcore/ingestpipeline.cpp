@@ -0,0 +1,179 @@
+#include "ingestpipeline.h"
+#include <QThread>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+IngestPipeline::IngestPipeline(QObject *parent)
+    : QObject(parent), thread(nullptr), wakePending(false), stopping(false), handedOver(false)
+{
+}
+
+IngestPipeline::~IngestPipeline()
+{
+    stop();
+}
+
+qint64 IngestPipeline::nowNs()
+{
+    // QElapsedTimer reads the monotonic clock, which every thread shares
+    static QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed();
+}
+
+void IngestPipeline::start()
+{
+    if (thread) return;
+
+    stopping = false;
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("IngestPipeline");
+    thread->start();
+}
+
+void IngestPipeline::stop()
+{
+    if (!thread) return;
+
+    stopping = true;
+    wakeups.release();
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+void IngestPipeline::push(const QString &contact, const QString &content)
+{
+    Incoming incoming;
+    incoming.contact = contact;
+    incoming.content = content;
+    incoming.receivedMs = QDateTime::currentMSecsSinceEpoch();
+    incoming.queuedNs = nowNs();
+    queue.push(std::move(incoming));
+    wake();
+}
+
+void IngestPipeline::runOnCoreThread(std::function<void()> task)
+{
+    tasks.push(std::move(task));
+    wake();
+}
+
+void IngestPipeline::wake()
+{
+    // One wakeup per sleep, however many producers push in the meantime
+    if (!wakePending.exchange(true)) {
+        wakeups.release();
+    }
+}
+
+IngestPipeline::Item IngestPipeline::prepare(Incoming &incoming)
+{
+    Message msg(incoming.contact, incoming.content,
+                QDateTime::fromMSecsSinceEpoch(incoming.receivedMs), false);
+    MessageSearchIndex::Change change = MessageSearchIndex::prepareAdd(incoming.contact, msg);
+    return Item{incoming.contact, msg, change, incoming.queuedNs};
+}
+
+void IngestPipeline::run()
+{
+    QVector<Item> building;
+    building.reserve(MaxBatch);
+
+    for (;;) {
+        bool progress = false;
+
+        std::function<void()> task;
+        while (tasks.pop(&task)) {
+            task();
+            progress = true;
+        }
+
+        Incoming incoming;
+        while (building.size() < MaxBatch && queue.pop(&incoming)) {
+            building.append(prepare(incoming));
+            progress = true;
+        }
+        if (!building.isEmpty() && offer(building)) {
+            progress = true;
+        }
+
+        if (stopping) break;
+        if (progress) continue;
+
+        // Woken by push(), runOnCoreThread(), a delivered batch or stop()
+        wakeups.acquire();
+        wakePending.exchange(false);
+    }
+
+    // Whatever is still queued is prepared here and left for takeRemaining()
+    std::function<void()> task;
+    while (tasks.pop(&task)) {
+        task();
+    }
+    Incoming incoming;
+    while (queue.pop(&incoming)) {
+        building.append(prepare(incoming));
+    }
+    leftover = std::move(building);
+}
+
+bool IngestPipeline::offer(QVector<Item> &building)
+{
+    {
+        QMutexLocker locker(&handoffLock);
+        if (handedOver) return false;
+        handoff.swap(building);
+        handedOver = true;
+    }
+    building.clear();
+    building.reserve(MaxBatch);
+
+    QMetaObject::invokeMethod(this, [this]() { deliver(); }, Qt::QueuedConnection);
+    return true;
+}
+
+void IngestPipeline::deliver()
+{
+    QVector<Item> batch;
+    {
+        QMutexLocker locker(&handoffLock);
+        batch.swap(handoff);
+    }
+
+    // Empty once takeRemaining() collected it
+    if (!batch.isEmpty()) {
+        emit batchReady(batch);
+    }
+
+    {
+        QMutexLocker locker(&handoffLock);
+        handedOver = false;
+    }
+    // The core thread may be holding a full batch for this
+    wake();
+}
+
+QVector<IngestPipeline::Item> IngestPipeline::takeRemaining()
+{
+    if (thread) return {};
+
+    QVector<Item> remaining;
+    {
+        QMutexLocker locker(&handoffLock);
+        remaining.swap(handoff);
+    }
+    remaining += leftover;
+    leftover.clear();
+
+    // With the core thread gone, this thread is the queue's consumer
+    Incoming incoming;
+    while (queue.pop(&incoming)) {
+        remaining.append(prepare(incoming));
+    }
+    return remaining;
+}
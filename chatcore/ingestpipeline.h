@@ -0,0 +1,96 @@
+#ifndef INGESTPIPELINE_H
+#define INGESTPIPELINE_H
+
+#include "message.h"
+#include "messagesearchindex.h"
+#include "mpscqueue.h"
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QSemaphore>
+#include <atomic>
+#include <functional>
+
+class QThread;
+
+// Incoming messages from any thread, prepared on a core thread and handed
+// to the thread that owns the pipeline in batches.
+//
+// Producers push into a lock-free MPSC queue and never wait for the
+// receiving side. The core thread drains it, builds each Message (ID,
+// timestamp) and tokenizes it for the search index, so what is left for
+// the receiver is appending. One batch is handed over at a time; while the
+// receiver is busy the next keeps growing, so a slow frame produces a
+// bigger batch rather than a backlog of queued events.
+//
+// The core thread also runs tasks in order, such as writing the chats file.
+class IngestPipeline : public QObject
+{
+    Q_OBJECT
+public:
+    struct Item {
+        QString contact;
+        Message message;
+        MessageSearchIndex::Change indexChange;
+        qint64 queuedNs;     // nowNs() when pushed
+    };
+
+    explicit IngestPipeline(QObject *parent = nullptr);
+    ~IngestPipeline();
+
+    void start();
+    // Finishes the tasks, prepares what is queued and joins the core thread.
+    // Anything not handed over yet is then available from takeRemaining().
+    void stop();
+    bool isRunning() const { return thread != nullptr; }
+
+    // Safe on any thread
+    void push(const QString &contact, const QString &content);
+    void runOnCoreThread(std::function<void()> task);
+
+    // After stop(): everything pushed that batchReady has not delivered
+    QVector<Item> takeRemaining();
+
+    // Monotonic nanoseconds, comparable across threads
+    static qint64 nowNs();
+
+    // Largest batch handed over at once
+    static const int MaxBatch = 4096;
+
+signals:
+    // On the pipeline's thread; the next batch follows once this returns
+    void batchReady(const QVector<IngestPipeline::Item> &batch);
+
+private:
+    struct Incoming {
+        QString contact;
+        QString content;
+        qint64 receivedMs = 0;   // Wall clock, for the timestamp
+        qint64 queuedNs = 0;
+    };
+
+    void run();
+    void wake();
+    static Item prepare(Incoming &incoming);
+    // Hands `building` over unless a batch is still with the receiver
+    bool offer(QVector<Item> &building);
+    void deliver();
+
+    MpscQueue<Incoming> queue;
+    MpscQueue<std::function<void()>> tasks;
+
+    QThread *thread;
+    QSemaphore wakeups;
+    std::atomic<bool> wakePending;
+    std::atomic<bool> stopping;
+
+    // The batch on its way to the receiver. Set from offer() until
+    // batchReady has returned, so only one is ever outstanding.
+    QMutex handoffLock;
+    QVector<Item> handoff;
+    bool handedOver;
+    // Prepared but not handed over when the core thread stopped
+    QVector<Item> leftover;
+};
+
+#endif // INGESTPIPELINE_H
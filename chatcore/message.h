@@ -0,0 +1,60 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <QString>
+#include <QDateTime>
+#include <QUuid>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+
+// Message struct for storing individual messages
+struct Message {
+    QString id;           // Unique identifier for each message
+    QString sender;
+    QString content;
+    QDateTime timestamp;
+    bool isCurrentUser;
+
+    Message() {
+        id = QUuid::createUuid().toString();
+    }
+
+    Message(const QString &s, const QString &c, const QDateTime &t, bool isCurrent)
+        : sender(s), content(c), timestamp(t), isCurrentUser(isCurrent) {
+        id = QUuid::createUuid().toString();
+    }
+
+    // Methods for JSON serialization
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["id"] = id;
+        obj["sender"] = sender;
+        obj["content"] = content;
+        obj["timestamp"] = timestamp.toString(Qt::ISODate);
+        obj["isCurrentUser"] = isCurrentUser;
+        return obj;
+    }
+
+    static Message fromJson(const QJsonObject &obj) {
+        Message msg(
+            obj["sender"].toString(),
+            obj["content"].toString(),
+            QDateTime::fromString(obj["timestamp"].toString(), Qt::ISODate),
+            obj["isCurrentUser"].toBool()
+            );
+        msg.id = obj["id"].toString();
+        // Generate ID if not present (for backward compatibility)
+        if (msg.id.isEmpty()) {
+            msg.id = QUuid::createUuid().toString();
+        }
+        return msg;
+    }
+};
+
+// Conversations as loaded from disk: contact name and its history
+using ConversationBatch = QList<QPair<QString, QList<Message>>>;
+// Messages added together, in order, each with its contact
+using MessageBatch = QList<QPair<QString, Message>>;
+
+#endif // MESSAGE_H
@@ -0,0 +1,713 @@
+#include "messagesearchindex.h"
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// Usual BM25 parameters: term frequency saturation and length normalization
+const double Bm25K1 = 1.2;
+const double Bm25B = 0.75;
+
+// Posting lists are sorted by document, so membership is a binary search
+bool containsDocument(const QVector<int> &sortedDocs, int doc)
+{
+    return std::binary_search(sortedDocs.constBegin(), sortedDocs.constEnd(), doc);
+}
+}
+
+MessageSearchIndex::MessageSearchIndex()
+    : deadDocs(0), tombstones(0), postingTotal(0), lengthTotal(0), journaling(false)
+{
+}
+
+QStringList MessageSearchIndex::tokenize(const QString &text)
+{
+    // Hand-rolled rather than a regex split: this runs over every message
+    QStringList tokens;
+    QString current;
+    for (QChar ch : text) {
+        if (ch.isLetterOrNumber()) {
+            current.append(ch.toCaseFolded());
+        } else if (!current.isEmpty()) {
+            tokens.append(current);
+            current.clear();
+        }
+    }
+    if (!current.isEmpty()) {
+        tokens.append(current);
+    }
+    return tokens;
+}
+
+void MessageSearchIndex::clear()
+{
+    postings.clear();
+    docs.clear();
+    docByMessageId.clear();
+    contactNames.clear();
+    contactByName.clear();
+    senderNames.clear();
+    senderByName.clear();
+    deadDocs = 0;
+    tombstones = 0;
+    postingTotal = 0;
+    lengthTotal = 0;
+    journal.clear();
+}
+
+int MessageSearchIndex::contactIndex(const QString &contact)
+{
+    auto it = contactByName.constFind(contact);
+    if (it != contactByName.constEnd()) {
+        return it.value();
+    }
+    int index = contactNames.size();
+    contactNames.append(contact);
+    contactByName.insert(contact, index);
+    return index;
+}
+
+int MessageSearchIndex::senderIndex(const QString &sender)
+{
+    auto it = senderByName.constFind(sender);
+    if (it != senderByName.constEnd()) {
+        return it.value();
+    }
+    int index = senderNames.size();
+    senderNames.append(sender);
+    senderByName.insert(sender, index);
+    return index;
+}
+
+void MessageSearchIndex::addConversation(const QString &contact, const QList<Message> &messages)
+{
+    docs.reserve(docs.size() + messages.size());
+    for (const Message &msg : messages) {
+        addMessage(contact, msg);
+    }
+}
+
+void MessageSearchIndex::addMessage(const QString &contact, const Message &msg)
+{
+    if (docByMessageId.contains(msg.id)) {
+        updateMessage(contact, msg);
+        return;
+    }
+
+    addPrepared(prepareAdd(contact, msg));
+}
+
+MessageSearchIndex::Change MessageSearchIndex::prepareAdd(const QString &contact, const Message &msg)
+{
+    QStringList tokens = tokenize(msg.content);
+
+    // Count each distinct word once, with its frequency
+    std::sort(tokens.begin(), tokens.end());
+    QVector<QPair<QString, int>> terms;
+    for (int i = 0; i < tokens.size();) {
+        int j = i + 1;
+        while (j < tokens.size() && tokens[j] == tokens[i]) ++j;
+        terms.append(qMakePair(tokens[i], j - i));
+        i = j;
+    }
+
+    return Change{Change::Add, msg.id, contact, QString(), msg.sender, msg.isCurrentUser,
+                  msg.timestamp.toMSecsSinceEpoch(), int(tokens.size()), terms, msg.content};
+}
+
+void MessageSearchIndex::addPrepared(const Change &change)
+{
+    addDocument(change.contact, change.sender, change.fromMe, change.messageId,
+                change.time, change.length, change.terms, change.text);
+    if (journaling) {
+        journal.append(change);
+    }
+}
+
+void MessageSearchIndex::addDocument(const QString &contact, const QString &sender, bool fromMe, const QString &messageId,
+                                     qint64 time, int length, const QVector<QPair<QString, int>> &terms,
+                                     const QString &text)
+{
+    int doc = docs.size();
+
+    Document document;
+    document.messageId = messageId;
+    document.text = text;
+    document.contact = contactIndex(contact);
+    document.sender = senderIndex(sender);
+    document.fromMe = fromMe;
+    document.length = length;
+    document.time = time;
+    docs.append(document);
+    docByMessageId.insert(messageId, doc);
+    lengthTotal += length;
+
+    for (const auto &term : terms) {
+        // New documents have the highest ID, so appending keeps lists sorted
+        postings[term.first].append(Posting{doc, term.second});
+        ++postingTotal;
+    }
+}
+
+void MessageSearchIndex::updateMessage(const QString &contact, const Message &msg)
+{
+    auto it = docByMessageId.constFind(msg.id);
+    if (it != docByMessageId.constEnd()) {
+        removeDocument(it.value());
+    }
+    addMessage(contact, msg);
+}
+
+void MessageSearchIndex::attachText(const QList<Message> &messages)
+{
+    for (const Message &msg : messages) {
+        auto it = docByMessageId.constFind(msg.id);
+        if (it != docByMessageId.constEnd()) {
+            docs[it.value()].text = msg.content;
+        }
+    }
+}
+
+void MessageSearchIndex::removeMessage(const QString &messageId)
+{
+    auto it = docByMessageId.constFind(messageId);
+    if (it == docByMessageId.constEnd()) return;
+    removeDocument(it.value());
+}
+
+void MessageSearchIndex::removeDocument(int doc)
+{
+    Document &document = docs[doc];
+    if (document.messageId.isEmpty()) return;
+
+    if (journaling) {
+        Change change{Change::Remove, document.messageId, QString(), QString(), QString(), false, 0, 0, {}};
+        journal.append(change);
+    }
+
+    // Postings stay until compaction; searches skip tombstoned documents
+    docByMessageId.remove(document.messageId);
+    document.messageId.clear();
+    document.text.clear();
+    lengthTotal -= document.length;
+    ++deadDocs;
+    ++tombstones;
+
+    if (tombstones > 1024 && tombstones * 4 > documentCount() + tombstones) {
+        compact();
+    }
+}
+
+void MessageSearchIndex::removeContact(const QString &contact)
+{
+    int index = contactByName.value(contact, -1);
+    if (index < 0) return;
+
+    for (int doc = 0; doc < docs.size(); ++doc) {
+        if (docs[doc].contact == index && !docs[doc].messageId.isEmpty()) {
+            removeDocument(doc);
+        }
+    }
+}
+
+void MessageSearchIndex::renameContact(const QString &oldName, const QString &newName)
+{
+    int index = contactByName.value(oldName, -1);
+    if (index < 0 || oldName == newName) return;
+
+    // Documents refer to the contact by index, so only the name table changes
+    contactByName.remove(oldName);
+    contactByName.insert(newName, index);
+    contactNames[index] = newName;
+
+    if (journaling) {
+        Change change{Change::Rename, QString(), oldName, newName, QString(), false, 0, 0, {}};
+        journal.append(change);
+    }
+}
+
+void MessageSearchIndex::compact()
+{
+    postingTotal = 0;
+    for (auto it = postings.begin(); it != postings.end();) {
+        QVector<Posting> &list = it.value();
+        list.erase(std::remove_if(list.begin(), list.end(), [this](const Posting &posting) {
+                       return docs[posting.doc].messageId.isEmpty();
+                   }), list.end());
+        if (list.isEmpty()) {
+            it = postings.erase(it);
+        } else {
+            list.squeeze();
+            postingTotal += list.size();
+            ++it;
+        }
+    }
+    // Document IDs are kept; dead entries only hold their time and contact
+    tombstones = 0;
+    if (deadDocs == docs.size()) {
+        // Unsaved changes outlive the reset
+        QVector<Change> pending;
+        pending.swap(journal);
+        clear();
+        journal.swap(pending);
+    }
+}
+
+MessageSearchIndex::Filter MessageSearchIndex::makeFilter(const SearchQuery &query) const
+{
+    Filter filter;
+    filter.notBefore = query.notBeforeMs();
+    filter.before = query.beforeMs();
+    filter.fromMe = query.fromMe();
+
+    // A few hundred names at most, against every posting they would otherwise cost
+    if (query.filtersContact()) {
+        filter.contacts.resize(contactNames.size());
+        for (int i = 0; i < contactNames.size(); ++i) {
+            filter.contacts[i] = query.matchesContact(contactNames[i]);
+        }
+    }
+    if (query.filtersSenderName()) {
+        filter.senders.resize(senderNames.size());
+        for (int i = 0; i < senderNames.size(); ++i) {
+            filter.senders[i] = query.matchesSender(senderNames[i], true);
+        }
+    }
+    return filter;
+}
+
+bool MessageSearchIndex::admits(int doc, const Filter &filter) const
+{
+    const Document &document = docs[doc];
+    return !document.messageId.isEmpty()
+           && document.time >= filter.notBefore && document.time < filter.before
+           && (!filter.fromMe || document.fromMe)
+           && (filter.contacts.isEmpty() || filter.contacts[document.contact])
+           && (filter.senders.isEmpty() || filter.senders[document.sender]);
+}
+
+MessageSearchIndex::Hit MessageSearchIndex::makeHit(int doc, double score) const
+{
+    const Document &document = docs[doc];
+    return Hit{contactNames[document.contact], document.messageId,
+               QDateTime::fromMSecsSinceEpoch(document.time), score, document.text};
+}
+
+void MessageSearchIndex::addTermScores(const QVector<Posting> &list, const QVector<int> &matched,
+                                       QVector<double> &scores) const
+{
+    // Posting lists still hold tombstones until compaction, so this slightly
+    // overstates how common a term is
+    double documents = qMax(1, documentCount());
+    double frequency = qMin<double>(list.size(), documents);
+    double idf = std::log(1.0 + (documents - frequency + 0.5) / (frequency + 0.5));
+    double averageLength = qMax(1.0, double(lengthTotal) / documents);
+
+    auto add = [&](int i, const Posting &posting) {
+        double tf = posting.termFrequency;
+        double norm = Bm25K1 * (1.0 - Bm25B + Bm25B * docs[posting.doc].length / averageLength);
+        scores[i] += idf * tf * (Bm25K1 + 1.0) / (tf + norm);
+    };
+
+    // Both sides are sorted by document; walk whichever is shorter and
+    // binary-search the other
+    if (list.size() < matched.size()) {
+        for (const Posting &posting : list) {
+            auto it = std::lower_bound(matched.constBegin(), matched.constEnd(), posting.doc);
+            if (it != matched.constEnd() && *it == posting.doc) add(int(it - matched.constBegin()), posting);
+        }
+    } else {
+        auto from = list.constBegin();
+        for (int i = 0; i < matched.size(); ++i) {
+            from = std::lower_bound(from, list.constEnd(), matched[i], [](const Posting &posting, int value) {
+                return posting.doc < value;
+            });
+            if (from == list.constEnd()) break;
+            if (from->doc == matched[i]) add(i, *from);
+        }
+    }
+}
+
+QVector<int> MessageSearchIndex::matchingDocuments(const QStringList &terms, const QString &prefix, const Filter &filter) const
+{
+    // Exact terms, rarest first so the candidate set starts small
+    QVector<const QVector<Posting>*> lists;
+    for (const QString &term : terms) {
+        auto it = postings.constFind(term);
+        if (it == postings.constEnd()) return {};
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<Posting> *a, const QVector<Posting> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> candidates;
+    bool haveCandidates = !lists.isEmpty();
+    if (haveCandidates) {
+        candidates.reserve(lists.first()->size());
+        // Filters prune the rarest list before anything is intersected with it
+        for (const Posting &posting : *lists.first()) {
+            if (admits(posting.doc, filter)) candidates.append(posting.doc);
+        }
+        for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+            const QVector<Posting> &list = *lists[i];
+            QVector<int> kept;
+            kept.reserve(candidates.size());
+            auto from = list.constBegin();
+            for (int doc : std::as_const(candidates)) {
+                // Both sides are sorted, so each search starts where the last ended
+                from = std::lower_bound(from, list.constEnd(), doc, [](const Posting &posting, int value) {
+                    return posting.doc < value;
+                });
+                if (from == list.constEnd()) break;
+                if (from->doc == doc) kept.append(doc);
+            }
+            candidates.swap(kept);
+        }
+    }
+
+    if (prefix.isEmpty()) {
+        if (!haveCandidates) {
+            // Filters only: every admitted document
+            for (int doc = 0; doc < docs.size(); ++doc) {
+                if (admits(doc, filter)) candidates.append(doc);
+            }
+        }
+        return candidates;
+    }
+    if (haveCandidates && candidates.isEmpty()) {
+        return {};
+    }
+
+    // Union of every term in the prefix range, restricted to the candidates
+    QVector<int> matched;
+    for (auto it = postings.lowerBound(prefix); it != postings.constEnd() && it.key().startsWith(prefix); ++it) {
+        for (const Posting &posting : it.value()) {
+            if (haveCandidates ? !containsDocument(candidates, posting.doc) : !admits(posting.doc, filter)) continue;
+            matched.append(posting.doc);
+        }
+    }
+    std::sort(matched.begin(), matched.end());
+    matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+    return matched;
+}
+
+QVector<MessageSearchIndex::Hit> MessageSearchIndex::search(const QString &query, int limit, int *total) const
+{
+    return search(SearchQuery::parse(query), limit, total);
+}
+
+QVector<MessageSearchIndex::Hit> MessageSearchIndex::search(const SearchQuery &query, int limit, int *total,
+                                                            const std::function<bool(const Hit &)> &accept) const
+{
+    if (total) *total = 0;
+    if (query.isEmpty()) return {};
+
+    // A trailing separator means the last word is complete
+    QStringList terms;
+    for (const QString &word : query.words()) {
+        terms += tokenize(word);
+    }
+    QString prefix;
+    if (query.endsInWord() && !terms.isEmpty()) {
+        prefix = terms.takeLast();
+    }
+    for (const QString &phrase : query.phrases()) {
+        terms += tokenize(phrase);
+    }
+    terms.removeDuplicates();
+    // Text made only of separators matches nothing rather than everything
+    if (query.hasText() && terms.isEmpty() && prefix.isEmpty()) return {};
+
+    QVector<int> matched = matchingDocuments(terms, prefix, makeFilter(query));
+    if (total) *total = matched.size();
+    if (matched.isEmpty() || limit <= 0) return {};
+
+    QVector<double> scores(matched.size(), 0.0);
+    for (const QString &term : std::as_const(terms)) {
+        addTermScores(postings.value(term), matched, scores);
+    }
+    if (!prefix.isEmpty()) {
+        for (auto it = postings.lowerBound(prefix); it != postings.constEnd() && it.key().startsWith(prefix); ++it) {
+            addTermScores(it.value(), matched, scores);
+        }
+    }
+
+    struct Ranked {
+        double score;
+        qint64 time;
+        int doc;
+    };
+    auto better = [](const Ranked &a, const Ranked &b) {
+        return a.score > b.score || (a.score == b.score && a.time > b.time);
+    };
+
+    QVector<Hit> hits;
+    hits.reserve(qMin(limit, int(matched.size())));
+    std::vector<Ranked> ranked;
+    if (accept) {
+        // Rejected candidates make room for lower ones, so candidates come
+        // off a heap of all of them, best first, until the page is full:
+        // O(n) to build and O(log n) per candidate looked at
+        auto worse = [&better](const Ranked &a, const Ranked &b) { return better(b, a); };
+        ranked.reserve(matched.size());
+        for (int i = 0; i < matched.size(); ++i) {
+            ranked.push_back(Ranked{scores[i], docs[matched[i]].time, matched[i]});
+        }
+        std::make_heap(ranked.begin(), ranked.end(), worse);
+        while (!ranked.empty() && hits.size() < limit) {
+            std::pop_heap(ranked.begin(), ranked.end(), worse);
+            Hit hit = makeHit(ranked.back().doc, ranked.back().score);
+            ranked.pop_back();
+            if (accept(hit)) hits.append(hit);
+        }
+        return hits;
+    }
+
+    // Heap of the best `limit` so far, worst on top: O(n log k), not a full sort
+    ranked.reserve(qMin(limit, int(matched.size())));
+    for (int i = 0; i < matched.size(); ++i) {
+        Ranked candidate{scores[i], docs[matched[i]].time, matched[i]};
+        if (int(ranked.size()) < limit) {
+            ranked.push_back(candidate);
+            std::push_heap(ranked.begin(), ranked.end(), better);
+        } else if (better(candidate, ranked.front())) {
+            std::pop_heap(ranked.begin(), ranked.end(), better);
+            ranked.back() = candidate;
+            std::push_heap(ranked.begin(), ranked.end(), better);
+        }
+    }
+    std::sort_heap(ranked.begin(), ranked.end(), better);
+
+    for (const Ranked &candidate : ranked) {
+        hits.append(makeHit(candidate.doc, candidate.score));
+    }
+    return hits;
+}
+
+void MessageSearchIndex::setJournaling(bool enabled)
+{
+    journaling = enabled;
+    if (!enabled) {
+        journal.clear();
+    }
+}
+
+QVector<MessageSearchIndex::Change> MessageSearchIndex::takeChanges()
+{
+    QVector<Change> changes;
+    changes.swap(journal);
+    return changes;
+}
+
+void MessageSearchIndex::applyChanges(const QVector<Change> &changes)
+{
+    // Replaying a journal is not itself a change to record
+    bool wasJournaling = journaling;
+    journaling = false;
+
+    for (const Change &change : changes) {
+        switch (change.type) {
+        case Change::Add:
+            removeMessage(change.messageId);
+            addDocument(change.contact, change.sender, change.fromMe, change.messageId,
+                        change.time, change.length, change.terms, change.text);
+            break;
+        case Change::Remove:
+            removeMessage(change.messageId);
+            break;
+        case Change::Rename:
+            renameContact(change.contact, change.newName);
+            break;
+        }
+    }
+
+    journaling = wasJournaling;
+}
+
+void MessageSearchIndex::writeSnapshot(QDataStream &out) const
+{
+    // Only live documents are written, renumbered densely in the same order
+    QVector<int> remap(docs.size(), -1);
+    quint32 liveCount = 0;
+    for (int doc = 0; doc < docs.size(); ++doc) {
+        if (!docs[doc].messageId.isEmpty()) remap[doc] = int(liveCount++);
+    }
+
+    out << quint32(contactNames.size());
+    for (const QString &name : contactNames) {
+        out << name;
+    }
+    out << quint32(senderNames.size());
+    for (const QString &name : senderNames) {
+        out << name;
+    }
+
+    out << liveCount;
+    for (const Document &document : docs) {
+        if (document.messageId.isEmpty()) continue;
+        out << document.messageId << quint32(document.contact) << quint32(document.sender) << document.fromMe
+            << qint32(document.length) << document.time;
+    }
+
+    QVector<QPair<quint32, quint32>> live;
+    quint32 termCount = 0;
+    for (auto it = postings.constBegin(); it != postings.constEnd(); ++it) {
+        for (const Posting &posting : it.value()) {
+            if (remap[posting.doc] >= 0) {
+                ++termCount;
+                break;
+            }
+        }
+    }
+
+    out << termCount;
+    for (auto it = postings.constBegin(); it != postings.constEnd(); ++it) {
+        live.clear();
+        for (const Posting &posting : it.value()) {
+            if (remap[posting.doc] >= 0) live.append(qMakePair(quint32(remap[posting.doc]), quint32(posting.termFrequency)));
+        }
+        if (live.isEmpty()) continue;
+
+        out << it.key() << quint32(live.size());
+        for (const auto &posting : std::as_const(live)) {
+            out << posting.first << posting.second;
+        }
+    }
+}
+
+bool MessageSearchIndex::readSnapshot(QDataStream &in)
+{
+    clear();
+
+    quint32 contactCount = 0;
+    in >> contactCount;
+    for (quint32 i = 0; i < contactCount && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        in >> name;
+        contactByName.insert(name, contactNames.size());
+        contactNames.append(name);
+    }
+
+    quint32 senderCount = 0;
+    in >> senderCount;
+    for (quint32 i = 0; i < senderCount && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        in >> name;
+        senderByName.insert(name, senderNames.size());
+        senderNames.append(name);
+    }
+
+    quint32 docCount = 0;
+    in >> docCount;
+    for (quint32 i = 0; i < docCount && in.status() == QDataStream::Ok; ++i) {
+        Document document;
+        quint32 contact = 0;
+        quint32 sender = 0;
+        qint32 length = 0;
+        in >> document.messageId >> contact >> sender >> document.fromMe >> length >> document.time;
+        if (contact >= contactCount || sender >= senderCount || document.messageId.isEmpty()) {
+            clear();
+            return false;
+        }
+        document.contact = int(contact);
+        document.sender = int(sender);
+        document.length = length;
+        docByMessageId.insert(document.messageId, docs.size());
+        docs.append(document);
+        lengthTotal += length;
+    }
+
+    quint32 termCount = 0;
+    in >> termCount;
+    for (quint32 i = 0; i < termCount && in.status() == QDataStream::Ok; ++i) {
+        QString term;
+        quint32 count = 0;
+        in >> term >> count;
+
+        QVector<Posting> &list = postings[term];
+        list.reserve(int(qMin<quint32>(count, docCount)));
+        for (quint32 j = 0; j < count && in.status() == QDataStream::Ok; ++j) {
+            quint32 doc = 0;
+            quint32 frequency = 0;
+            in >> doc >> frequency;
+            // Lists must stay sorted for intersection
+            if (doc >= docCount || (!list.isEmpty() && int(doc) <= list.last().doc)) {
+                clear();
+                return false;
+            }
+            list.append(Posting{int(doc), int(frequency)});
+        }
+        postingTotal += list.size();
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+void MessageSearchIndex::writeChanges(QDataStream &out, const QVector<Change> &changes)
+{
+    out << quint32(changes.size());
+    for (const Change &change : changes) {
+        out << quint8(change.type);
+        switch (change.type) {
+        case Change::Add:
+            out << change.messageId << change.contact << change.sender << change.fromMe
+                << change.time << qint32(change.length)
+                << quint32(change.terms.size());
+            for (const auto &term : change.terms) {
+                out << term.first << qint32(term.second);
+            }
+            break;
+        case Change::Remove:
+            out << change.messageId;
+            break;
+        case Change::Rename:
+            out << change.contact << change.newName;
+            break;
+        }
+    }
+}
+
+bool MessageSearchIndex::readChanges(QDataStream &in, QVector<Change> *changes)
+{
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        quint8 type = 0;
+        in >> type;
+
+        Change change{Change::Type(type), QString(), QString(), QString(), QString(), false, 0, 0, {}};
+        switch (type) {
+        case Change::Add: {
+            qint32 length = 0;
+            quint32 termCount = 0;
+            in >> change.messageId >> change.contact >> change.sender >> change.fromMe
+               >> change.time >> length >> termCount;
+            change.length = length;
+            for (quint32 j = 0; j < termCount && in.status() == QDataStream::Ok; ++j) {
+                QString term;
+                qint32 frequency = 0;
+                in >> term >> frequency;
+                change.terms.append(qMakePair(term, int(frequency)));
+            }
+            break;
+        }
+        case Change::Remove:
+            in >> change.messageId;
+            break;
+        case Change::Rename:
+            in >> change.contact >> change.newName;
+            break;
+        default:
+            return false;
+        }
+        changes->append(change);
+    }
+    return in.status() == QDataStream::Ok;
+}
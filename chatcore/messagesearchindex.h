@@ -0,0 +1,162 @@
+#ifndef MESSAGESEARCHINDEX_H
+#define MESSAGESEARCHINDEX_H
+
+#include "message.h"
+#include "searchquery.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <functional>
+
+class QDataStream;
+
+// Inverted index over the text of every message in every conversation.
+// Each case-folded word maps to a posting list of (document, term frequency)
+// in increasing document order. Documents keep an implicitly shared copy of
+// the message text, so a phrase can be checked and a snippet cut without
+// looking the message up in its conversation. Messages are appended as new documents;
+// deletes and edits leave tombstones that are compacted away in bulk once
+// they make up a quarter of the index. Results are ranked with BM25 over
+// the term frequencies and message lengths kept in the index.
+//
+// With journaling on, every change is also recorded so it can be persisted
+// as a delta segment; a snapshot is the whole live index, serialized with
+// its postings so loading it needs no tokenizing.
+class MessageSearchIndex
+{
+public:
+    struct Hit {
+        QString contact;
+        QString messageId;
+        QDateTime timestamp;
+        double score;        // BM25; 0 for filter-only queries
+        QString text;        // Empty while a loaded index waits for attachText()
+    };
+
+    // One journaled change, carrying the words of an added message
+    struct Change {
+        enum Type { Add, Remove, Rename };
+        Type type;
+        QString messageId;   // Add, Remove
+        QString contact;     // Add; old name for Rename
+        QString newName;     // Rename
+        QString sender;      // Add
+        bool fromMe;         // Add
+        qint64 time;
+        int length;
+        QVector<QPair<QString, int>> terms; // Distinct word -> frequency
+        QString text;        // Add; not persisted
+    };
+
+    MessageSearchIndex();
+
+    void clear();
+    void addConversation(const QString &contact, const QList<Message> &messages);
+    void addMessage(const QString &contact, const Message &msg);
+    // Tokenizing, split out so it can run on another thread: prepareAdd() is
+    // safe anywhere, addPrepared() adds the result for a new message ID
+    static Change prepareAdd(const QString &contact, const Message &msg);
+    void addPrepared(const Change &change);
+    // Re-indexes the message's new text under the same message ID
+    void updateMessage(const QString &contact, const Message &msg);
+    void removeMessage(const QString &messageId);
+    void removeContact(const QString &contact);
+    void renameContact(const QString &oldName, const QString &newName);
+    // Gives documents read from disk their text once the history is loaded
+    void attachText(const QList<Message> &messages);
+
+    // Messages containing every word of the query, the last word matching as
+    // a prefix so results follow typing. The best `limit` by score, newest
+    // first among equals, kept in a bounded heap rather than sorting every
+    // match; `total` receives the number of matches.
+    QVector<Hit> search(const QString &query, int limit, int *total = nullptr) const;
+
+    // The same for a parsed query. Time, contact and sender filters are
+    // checked on the rarest word's postings before the others are
+    // intersected. Phrases count as their words; `accept`, if given, sees
+    // candidates best first and can check the actual text, pulled from a
+    // heap only as far as it takes to fill the page. `total` is then the
+    // number of candidates before that check.
+    QVector<Hit> search(const SearchQuery &query, int limit, int *total = nullptr,
+                        const std::function<bool(const Hit &)> &accept = {}) const;
+
+    int documentCount() const { return docs.size() - deadDocs; }
+    int termCount() const { return postings.size(); }
+    qint64 postingCount() const { return postingTotal; }
+
+    // Case-folded words of `text`, in order, duplicates kept
+    static QStringList tokenize(const QString &text);
+
+    void setJournaling(bool enabled);
+    bool isJournaling() const { return journaling; }
+    // Changes since the last call, oldest first
+    QVector<Change> takeChanges();
+    void applyChanges(const QVector<Change> &changes);
+
+    void writeSnapshot(QDataStream &out) const;
+    bool readSnapshot(QDataStream &in);
+    static void writeChanges(QDataStream &out, const QVector<Change> &changes);
+    static bool readChanges(QDataStream &in, QVector<Change> *changes);
+
+private:
+    struct Posting {
+        int doc;
+        int termFrequency;
+    };
+
+    struct Document {
+        QString messageId;   // Empty once deleted
+        QString text;        // Shared with the message
+        int contact;         // Index into contactNames
+        int sender;          // Index into senderNames
+        bool fromMe;
+        int length;          // Words in the message
+        qint64 time;         // Milliseconds since epoch
+    };
+
+    // Query filters resolved against the name tables once per search
+    struct Filter {
+        qint64 notBefore;
+        qint64 before;
+        bool fromMe;
+        QVector<bool> contacts;   // Empty means any
+        QVector<bool> senders;
+    };
+
+    int contactIndex(const QString &contact);
+    int senderIndex(const QString &sender);
+    void addDocument(const QString &contact, const QString &sender, bool fromMe, const QString &messageId,
+                     qint64 time, int length, const QVector<QPair<QString, int>> &terms, const QString &text);
+    void removeDocument(int doc);
+    void compact();
+
+    Filter makeFilter(const SearchQuery &query) const;
+    bool admits(int doc, const Filter &filter) const;
+    Hit makeHit(int doc, double score) const;
+    // Adds the BM25 contribution of one term to the scores of `matched`
+    void addTermScores(const QVector<Posting> &list, const QVector<int> &matched, QVector<double> &scores) const;
+
+    // Live documents the filter admits that match every exact term and, if
+    // set, any term starting with `prefix`; with neither, every admitted document
+    QVector<int> matchingDocuments(const QStringList &terms, const QString &prefix, const Filter &filter) const;
+
+    QMap<QString, QVector<Posting>> postings; // Ordered, so a prefix is a key range
+    QVector<Document> docs;
+    QHash<QString, int> docByMessageId;
+    QVector<QString> contactNames;
+    QHash<QString, int> contactByName;
+    QVector<QString> senderNames;
+    QHash<QString, int> senderByName;
+    int deadDocs;        // Deleted documents, compacted or not
+    int tombstones;      // Deleted documents whose postings are still present
+    qint64 postingTotal;
+    qint64 lengthTotal;  // Words in live documents, for the average length
+
+    bool journaling;
+    QVector<Change> journal;
+};
+
+#endif // MESSAGESEARCHINDEX_H
@@ -0,0 +1,485 @@
+#include "messageservice.h"
+#include "perfmonitor.h"
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QDebug>
+
+MessageService::MessageService(ConversationStore *store, QObject *parent)
+    : QObject(parent), conversations(store), chatClient(nullptr), autoReply(true), autoMessageTimer(nullptr),
+    contactsLoaded(false), historyLoaded(false), saveAfterLoad(false), closed(false),
+    saving(false), saveAgain(false), saveWritten(false)
+{
+    saveTimer = new QTimer(this);
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(500);
+    connect(saveTimer, &QTimer::timeout, this, &MessageService::saveChats);
+
+    pipeline = new IngestPipeline(this);
+    connect(pipeline, &IngestPipeline::batchReady, this, &MessageService::applyBatch);
+    pipeline->start();
+}
+
+MessageService::~MessageService()
+{
+    close();
+}
+
+void MessageService::close()
+{
+    if (closed) return;
+    closed = true;
+
+    stopAutoMessages();
+    if (chatClient) {
+        chatClient->disconnectFromServer();
+    }
+    pipeline->stop();
+
+    // The write finished before the core thread did, but its result is still queued
+    saveAgain = false;
+    if (saving) {
+        finishSave(saveWritten);
+    }
+
+    // Nobody is left to show these, so they are only stored
+    QVector<IngestPipeline::Item> remaining = pipeline->takeRemaining();
+    for (const IngestPipeline::Item &item : remaining) {
+        conversations->appendPrepared(item.contact, item.message, item.indexChange);
+    }
+    saveChats();
+}
+
+Message MessageService::sendMessage(const QString &contact, const QString &content)
+{
+    Message msg(conversations->user(), content, QDateTime::currentDateTime(), true);
+    conversations->appendMessage(contact, msg);
+    emit messageAdded(contact, msg);
+    scheduleSave();
+
+    if (chatClient) {
+        chatClient->sendMessage(contact, msg);
+    } else if (autoReply) {
+        // Simulate response after a short delay
+        QTimer::singleShot(1000 + QRandomGenerator::global()->bounded(2000), this, [this, contact]() {
+            // The contact may have been deleted in the meantime
+            if (conversations->contactIndex(contact) < 0) return;
+
+            static const QStringList responses = {
+                "That's interesting! Tell me more. 🤔",
+                "I see what you mean. 👀",
+                "Thanks for sharing that! 🙏",
+                "How do you feel about that? 🧠",
+                "That sounds great! 😄",
+                "I understand your point. 👍",
+                "What do you think we should do next? 🤷",
+                "That's a good question. 🤨",
+                "Wow, really? 😲",
+                "Haha, that's funny! 😂",
+                "Can you explain that a bit more? 🧐",
+                "Hmm, let me think about that. 🤔",
+                "I'm here for you. 💬",
+                "Interesting perspective. 🧩",
+                "That makes sense. ✅",
+                "I'm not sure I follow. Could you elaborate? 🤯",
+                "Exactly! I was thinking the same. 💡",
+                "That's one way to look at it. 👓",
+                "Good point! 📌",
+                "I hadn’t thought of it that way. 🔄",
+                "You might be onto something. 🕵️",
+                "I'm curious—what made you think of that? 🧐",
+                "Could you give me an example? 📘",
+                "I appreciate your insight. 🌟",
+                "Let’s look at it from another angle. 🔍",
+                "Fascinating idea. Tell me more. 🧠",
+                "You’re making me think! 🧠💭",
+                "Let's explore that further. 🚀",
+                "That caught my attention. 👂",
+                "I like where this is going. 😎",
+                "You're absolutely right! ✅",
+                "This is getting interesting. 👀",
+                "Hmm, that's debatable. 🤨",
+                "Now that's something to consider. 🧐",
+                "Intriguing thought. 🧠✨",
+                "Can you clarify that a little? 🤓",
+                "Let me make sure I got that right. 📝",
+                "Totally! Couldn't agree more. 🙌",
+                "That's a bold statement! 🔥",
+                "Tell me why you think that. 🗣️",
+                "I hear you loud and clear. 🔊",
+                "That's deep. 💭",
+                "You're raising some great points. 👏",
+                "Let's dive deeper into that. 🌊",
+                "Well said! 🎯",
+                "That perspective is refreshing. 🌿",
+                "You’ve clearly thought about this. 🤓",
+                "I like how you put that. ✍️",
+                "That reminds me of something... 💭",
+                "Go on, I'm listening. 🎧"
+            };
+            ingestMessage(contact, responses[QRandomGenerator::global()->bounded(responses.size())]);
+        });
+    }
+    return msg;
+}
+
+Message MessageService::receiveMessage(const QString &contact, const QString &content)
+{
+    Message incoming(contact, content, QDateTime::currentDateTime(), false);
+    conversations->appendMessage(contact, incoming);
+    emit messageAdded(contact, incoming);
+    scheduleSave();
+    return incoming;
+}
+
+void MessageService::ingestMessage(const QString &contact, const QString &content)
+{
+    pipeline->push(contact, content);
+}
+
+void MessageService::applyBatch(const QVector<IngestPipeline::Item> &batch)
+{
+    MessageBatch added;
+    added.reserve(batch.size());
+    {
+        PerfScope scope(QStringLiteral("ingest.batch"));
+        for (const IngestPipeline::Item &item : batch) {
+            conversations->appendPrepared(item.contact, item.message, item.indexChange);
+            added.append(qMakePair(item.contact, item.message));
+        }
+        emit messagesReceived(added);
+    }
+
+    // From push() on the producer's thread to the batch being shown
+    qint64 now = IngestPipeline::nowNs();
+    PerfMonitor &monitor = PerfMonitor::instance();
+    for (const IngestPipeline::Item &item : batch) {
+        monitor.record(QStringLiteral("ingest.latency"), now - item.queuedNs);
+    }
+    scheduleSave();
+}
+
+bool MessageService::editMessage(const QString &contact, const QString &messageId, const QString &content)
+{
+    const Message *edited = conversations->editMessage(contact, messageId, content);
+    if (!edited) return false;
+
+    emit messageEdited(contact, *edited);
+    saveChats();
+    if (chatClient) {
+        chatClient->editMessage(contact, messageId, content);
+    }
+    return true;
+}
+
+bool MessageService::deleteMessage(const QString &contact, const QString &messageId)
+{
+    if (!conversations->removeMessage(contact, messageId)) return false;
+
+    emit messageRemoved(contact, messageId);
+    saveChats();
+    if (chatClient) {
+        chatClient->deleteMessage(contact, messageId);
+    }
+    return true;
+}
+
+void MessageService::connectToServer(const QString &address)
+{
+    if (!chatClient) {
+        chatClient = new ChatClient(conversations->user(), this);
+        connect(chatClient, &ChatClient::messageDelivered, this, &MessageService::onDelivered);
+        connect(chatClient, &ChatClient::messageEdited, this, &MessageService::onRemoteEdit);
+        connect(chatClient, &ChatClient::messageDeleted, this, &MessageService::onRemoteDelete);
+        connect(chatClient, &ChatClient::conversationReset, this, &MessageService::onConversationReset);
+        // Saved with the chats, so it matches the history being loaded
+        chatClient->setSyncState(ChatClient::readSyncState(conversations->syncFilePath()));
+    }
+    stopAutoMessages();
+    autoReply = false;
+    chatClient->connectToServer(address);
+}
+
+bool MessageService::createGroup(const QString &group, const QStringList &members)
+{
+    if (!chatClient || !ChatProtocol::isGroup(group)) return false;
+
+    if (conversations->contactIndex(group) < 0) {
+        addContact(Contact(group, QString()));
+    }
+    chatClient->createGroup(group, members);
+    return true;
+}
+
+void MessageService::onDelivered(const QString &contact, const Message &msg)
+{
+    // The user's own message comes back when a sync crosses its lost Ack
+    if (msg.isCurrentUser && conversations->findMessage(contact, msg.id)) return;
+
+    // Someone not in the list yet is added, as a phone would
+    if (conversations->contactIndex(contact) < 0) {
+        addContact(Contact(contact, QString()));
+    }
+    conversations->appendMessage(contact, msg);
+    emit messageAdded(contact, msg);
+    scheduleSave();
+}
+
+void MessageService::onRemoteEdit(const QString &contact, const QString &messageId, const QString &content)
+{
+    const Message *edited = conversations->editMessage(contact, messageId, content);
+    if (!edited) return;
+
+    emit messageEdited(contact, *edited);
+    scheduleSave();
+}
+
+void MessageService::onRemoteDelete(const QString &contact, const QString &messageId)
+{
+    if (!conversations->removeMessage(contact, messageId)) return;
+
+    emit messageRemoved(contact, messageId);
+    scheduleSave();
+}
+
+void MessageService::onConversationReset(const QString &contact, const QList<Message> &messages)
+{
+    // Merged now, the loaded history would go in front of messages it has too
+    if (!historyLoaded) {
+        pendingResets.append(qMakePair(contact, messages));
+        return;
+    }
+
+    if (conversations->contactIndex(contact) < 0) {
+        addContact(Contact(contact, QString()));
+    }
+    conversations->mergeConversation(contact, messages);
+    emit conversationReset(contact);
+    scheduleSave();
+}
+
+bool MessageService::addContact(const Contact &contact)
+{
+    if (conversations->isNameTaken(contact.name)) return false;
+
+    conversations->addContact(contact);
+    emit contactAdded(contact);
+    saveContacts();
+    return true;
+}
+
+int MessageService::addContacts(const QList<Contact> &contacts)
+{
+    // One pass over the existing names rather than one per new contact
+    QSet<QString> taken;
+    for (const Contact &contact : conversations->contacts()) {
+        taken.insert(contact.name.toLower());
+    }
+
+    int added = 0;
+    for (const Contact &contact : contacts) {
+        QString folded = contact.name.toLower();
+        if (taken.contains(folded)) continue;
+        taken.insert(folded);
+        conversations->addContact(contact);
+        emit contactAdded(contact);
+        ++added;
+    }
+    if (added > 0) {
+        saveContacts();
+    }
+    return added;
+}
+
+bool MessageService::updateContact(const QString &oldName, const Contact &contact)
+{
+    int index = conversations->contactIndex(oldName);
+    if (index < 0 || conversations->isNameTaken(contact.name, index)) return false;
+
+    conversations->updateContact(oldName, contact);
+    saveContacts();
+    saveChats();
+    return true;
+}
+
+void MessageService::removeContact(const QString &name)
+{
+    conversations->removeContact(name);
+    saveContacts();
+    saveChats();
+}
+
+void MessageService::startAutoMessages()
+{
+    // The server's other users write the messages instead
+    if (autoMessageTimer || chatClient) return;
+
+    autoMessageTimer = new QTimer(this);
+    autoMessageTimer->setSingleShot(false);
+
+    // Set interval between 15-30 seconds (15000-30000 milliseconds)
+    int interval = 15000 + QRandomGenerator::global()->bounded(15000);
+    autoMessageTimer->setInterval(interval);
+
+    connect(autoMessageTimer, &QTimer::timeout, this, &MessageService::sendAutoMessage);
+
+    // Start the timer after a short delay
+    QTimer::singleShot(3000, autoMessageTimer, [this]() {
+        if (!conversations->contacts().isEmpty()) {
+            autoMessageTimer->start();
+        }
+    });
+}
+
+void MessageService::stopAutoMessages()
+{
+    delete autoMessageTimer;
+    autoMessageTimer = nullptr;
+}
+
+void MessageService::sendAutoMessage()
+{
+    const QList<Contact> &contacts = conversations->contacts();
+    if (contacts.isEmpty()) {
+        return;
+    }
+
+    // Pick a random contact
+    QString contactName = contacts[QRandomGenerator::global()->bounded(contacts.size())].name;
+
+    // Array of automatic messages
+    static const QStringList autoMessages = {
+        "Hey! How's your day going? 😊",
+        "Just wanted to say hi! 👋",
+        "Hope you're doing well! 💙",
+        "What's up? Haven't heard from you in a while 🤔",
+        "Good morning! ☀️",
+        "Good evening! 🌙",
+        "How are things on your end? 🤗",
+        "Just checking in! 📱",
+        "Hope you're having a great day! ✨",
+        "Missing our chats! 💭",
+        "Any exciting plans today? 🎉",
+        "Hope work is going well! 💼",
+        "Thinking about you! 💝",
+        "How's the weather there? 🌤️",
+        "Just wanted to catch up! ☕",
+        "Hope you're staying safe! 🛡️",
+        "Any good news to share? 📰",
+        "What's keeping you busy these days? ⏰",
+        "Hope you're getting enough rest! 😴",
+        "Sending good vibes your way! ✨"
+    };
+
+    QString randomMessage = autoMessages[QRandomGenerator::global()->bounded(autoMessages.size())];
+
+    qDebug() << "=== sendAutoMessage() ===";
+    qDebug() << "Auto message from:" << contactName;
+
+    ingestMessage(contactName, randomMessage);
+
+    // Set next random interval
+    int nextInterval = 60000 + QRandomGenerator::global()->bounded(7000);
+    autoMessageTimer->setInterval(nextInterval);
+}
+
+void MessageService::setContactsLoaded()
+{
+    contactsLoaded = true;
+}
+
+void MessageService::setHistoryLoaded()
+{
+    historyLoaded = true;
+
+    QList<QPair<QString, QList<Message>>> resets;
+    resets.swap(pendingResets);
+    for (const auto &reset : std::as_const(resets)) {
+        onConversationReset(reset.first, reset.second);
+    }
+
+    if (saveAfterLoad || !resets.isEmpty()) {
+        saveAfterLoad = false;
+        scheduleSave();
+    } else if (!conversations->isSearchIndexFromDisk()) {
+        // The chats file is unchanged, so the rebuilt index can be stamped with it
+        conversations->commitSearchIndex();
+    }
+}
+
+void MessageService::saveContacts()
+{
+    // Writing before the file was read would replace it with placeholders
+    if (!contactsLoaded) return;
+
+    if (!conversations->saveContacts()) {
+        qDebug() << "Could not write" << conversations->contactsFilePath();
+    }
+}
+
+void MessageService::saveChats()
+{
+    saveTimer->stop();
+    if (!historyLoaded) {
+        saveAfterLoad = true;
+        return;
+    }
+
+    if (!pipeline->isRunning()) {
+        if (!conversations->saveChats()) {
+            qDebug() << "Could not write" << conversations->chatsFilePath();
+        } else if (chatClient && !ChatClient::writeSyncState(conversations->syncFilePath(), chatClient->syncState())) {
+            qDebug() << "Could not write" << conversations->syncFilePath();
+        }
+        return;
+    }
+
+    // One save in flight; changes made meanwhile go into the next one
+    if (saving) {
+        saveAgain = true;
+        return;
+    }
+    saving = true;
+    pendingSave = conversations->snapshotChats();
+
+    // The chats file, index delta and manifest are all written there; this
+    // thread only records the result. pendingSave is the core thread's until
+    // the result is posted back. What the server connection has seen goes
+    // after the chats it was added to, never ahead of them.
+    QString filePath = conversations->chatsFilePath();
+    QString syncPath = chatClient ? conversations->syncFilePath() : QString();
+    ChatClient::SyncState syncState = chatClient ? chatClient->syncState() : ChatClient::SyncState();
+    pipeline->runOnCoreThread([this, filePath, syncPath, syncState]() {
+        saveWritten = ConversationStore::writeSnapshot(filePath, &pendingSave);
+        if (saveWritten && !syncPath.isEmpty() && !ChatClient::writeSyncState(syncPath, syncState)) {
+            qDebug() << "Could not write" << syncPath;
+        }
+        QMetaObject::invokeMethod(this, [this]() { finishSave(saveWritten); }, Qt::QueuedConnection);
+    });
+}
+
+void MessageService::finishSave(bool written)
+{
+    // close() may have finished it already
+    if (!saving) return;
+    saving = false;
+
+    if (!written) {
+        qDebug() << "Could not write" << conversations->chatsFilePath();
+    }
+    conversations->finishSave(pendingSave, written);
+    pendingSave = ConversationStore::ChatsSnapshot();
+
+    if (saveAgain) {
+        saveAgain = false;
+        saveChats();
+    }
+}
+
+void MessageService::scheduleSave()
+{
+    // A burst of messages results in one write of the chats file
+    if (!saveTimer->isActive()) {
+        saveTimer->start();
+    }
+}
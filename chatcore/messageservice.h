@@ -0,0 +1,128 @@
+#ifndef MESSAGESERVICE_H
+#define MESSAGESERVICE_H
+
+#include "message.h"
+#include "contact.h"
+#include "conversationstore.h"
+#include "ingestpipeline.h"
+#include "chatclient.h"
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+class QTimer;
+
+// What a client does with a user's chats: send, receive, edit and delete
+// messages and manage contacts. Each operation updates the ConversationStore,
+// announces the change with a signal and gets the change saved; a burst of
+// messages is written once. Nothing is written until the matching data has
+// loaded, since an earlier write would replace it.
+//
+// Incoming messages from other threads go through an IngestPipeline: they
+// are prepared on its core thread and applied here in batches, announced
+// with one messagesReceived per batch. The chats file is written on the same
+// core thread from a snapshot, so a save doesn't hold up this thread either.
+//
+// Also plays the other side of every conversation: a canned reply to each
+// sent message and now and then a message from a random contact. Connected
+// to chatsimserver instead, the other side is whoever is logged in as that
+// contact: sends, edits and deletes go to the server and what it delivers
+// is added here as if it came from the contact. After a dropped connection
+// the client catches up on what it missed, and after a restart on what came
+// while the app was closed, since what it has seen is saved with the chats.
+// A conversation the server sends whole is merged with the one here once the
+// history has loaded.
+class MessageService : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MessageService(ConversationStore *store, QObject *parent = nullptr);
+    ~MessageService();
+
+    ConversationStore *store() const { return conversations; }
+
+    // Sends as the current user; the contact answers a moment later if auto replies are on
+    Message sendMessage(const QString &contact, const QString &content);
+    // Delivers a message from a contact as if it arrived over the network
+    Message receiveMessage(const QString &contact, const QString &content);
+    // As receiveMessage(), but safe on any thread and never waits: the
+    // message is added with a later batch
+    void ingestMessage(const QString &contact, const QString &content);
+    bool editMessage(const QString &contact, const QString &messageId, const QString &content);
+    bool deleteMessage(const QString &contact, const QString &messageId);
+
+    // False, with nothing changed, if another contact has the name
+    bool addContact(const Contact &contact);
+    // Skips names already taken and saves once; returns how many were added
+    int addContacts(const QList<Contact> &contacts);
+    bool updateContact(const QString &oldName, const Contact &contact);
+    void removeContact(const QString &name);
+
+    void setAutoReply(bool enabled) { autoReply = enabled; }
+
+    // Routes messages through chatsimserver at `address` (see ChatClient);
+    // turns off the simulated replies and auto messages
+    void connectToServer(const QString &address);
+    ChatClient *client() const { return chatClient; }
+    // A conversation with several users through the server; `group` starts
+    // with '#'. False when not connected or the name is not a group name.
+    bool createGroup(const QString &group, const QStringList &members);
+    // Starts the occasional messages from random contacts
+    void startAutoMessages();
+    void stopAutoMessages();
+
+    // Writes are held back until these are called
+    void setContactsLoaded();
+    void setHistoryLoaded();
+    bool isHistoryLoaded() const { return historyLoaded; }
+
+    void saveContacts();
+    void saveChats();
+    // Saves requested during a burst go out together
+    void scheduleSave();
+
+    // Stops the core thread, adds the messages still queued without
+    // announcing them and saves everything before returning. Called by the
+    // destructor if not before; nothing should be ingested afterwards.
+    void close();
+
+signals:
+    void contactAdded(const Contact &contact);
+    void messageAdded(const QString &contact, const Message &msg);
+    // Ingested messages, once they are in the store
+    void messagesReceived(const MessageBatch &messages);
+    void messageEdited(const QString &contact, const Message &msg);
+    void messageRemoved(const QString &contact, const QString &messageId);
+    // The conversation was merged with one the server sent whole
+    void conversationReset(const QString &contact);
+
+private:
+    void sendAutoMessage();
+    void applyBatch(const QVector<IngestPipeline::Item> &batch);
+    void onDelivered(const QString &contact, const Message &msg);
+    void onRemoteEdit(const QString &contact, const QString &messageId, const QString &content);
+    void onRemoteDelete(const QString &contact, const QString &messageId);
+    void onConversationReset(const QString &contact, const QList<Message> &messages);
+    void finishSave(bool written);
+
+    ConversationStore *conversations;
+    IngestPipeline *pipeline;
+    ChatClient *chatClient;
+    bool autoReply;
+    QTimer *autoMessageTimer;
+    QTimer *saveTimer;
+    bool contactsLoaded;
+    bool historyLoaded;
+    bool saveAfterLoad;     // Chats changed while history was still loading
+    // Sent whole while history was still loading
+    QList<QPair<QString, QList<Message>>> pendingResets;
+    bool closed;
+
+    // The save being written on the core thread, if any
+    bool saving;
+    bool saveAgain;         // Chats changed again while it was written
+    ConversationStore::ChatsSnapshot pendingSave;
+    std::atomic<bool> saveWritten;
+};
+
+#endif // MESSAGESERVICE_H
@@ -0,0 +1,93 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Unbounded queue for any number of producer threads and one consumer,
+// after Dmitry Vyukov's intrusive MPSC design. A push is one atomic
+// exchange and one store, and never waits for the consumer or for other
+// producers. The consumer owns the tail and pops without atomics beyond
+// one acquire load.
+//
+// A pop can report empty while a push is halfway done (the exchange has
+// happened, the link not yet); the producer's wakeup after push() covers
+// that, so a consumer that sleeps when empty must be woken after each push.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : head(&stub), tail(&stub)
+    {
+        stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(&value)) {
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // Any thread
+    void push(T value)
+    {
+        Node *node = new Node(std::move(value));
+        pushNode(node);
+    }
+
+    // Consumer thread only; false when empty
+    bool pop(T *value)
+    {
+        Node *first = tail;
+        Node *next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            if (!next) return false;
+            // Step over the stub
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail = next;
+            *value = std::move(first->value);
+            delete first;
+            return true;
+        }
+
+        // `first` is the last node; it can only be taken once the stub is
+        // queued behind it, unless a producer is still linking a new node
+        if (first != head.load(std::memory_order_acquire)) return false;
+        pushNode(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        tail = next;
+        *value = std::move(first->value);
+        delete first;
+        return true;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T &&v) : value(std::move(v)) {}
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    void pushNode(Node *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    Node stub;
+    std::atomic<Node*> head;  // Most recently pushed; producers swap themselves in
+    Node *tail;               // Oldest, owned by the consumer
+};
+
+#endif // MPSCQUEUE_H
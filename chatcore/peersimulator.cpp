@@ -0,0 +1,256 @@
+#include "peersimulator.h"
+#include "messageservice.h"
+#include "contact.h"
+#include <QTimer>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+PeerSimulator::PeerSimulator(MessageService *service, const Config &config, QObject *parent)
+    : QObject(parent), service(service), config(config), random(config.seed), running(false),
+    awaitingCount(0)
+{
+    // Contact i sends with weight 1 / (i + 1)^skew
+    contactWeights.reserve(qMax(0, config.contacts));
+    double total = 0.0;
+    for (int i = 0; i < config.contacts; ++i) {
+        total += 1.0 / std::pow(i + 1.0, config.contactSkew);
+        contactWeights.push_back(total);
+    }
+
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &PeerSimulator::deliverDue);
+    if (config.queued) {
+        connect(service, &MessageService::messagesReceived, this, &PeerSimulator::onMessagesReceived);
+    }
+}
+
+QString PeerSimulator::contactName(int index)
+{
+    return QString("Peer %1").arg(index, 5, 10, QChar('0'));
+}
+
+PeerSimulator::Arrival PeerSimulator::arrivalFromName(const QString &name, bool *ok)
+{
+    if (ok) *ok = true;
+    if (name.compare("bursty", Qt::CaseInsensitive) == 0) return Arrival::Bursty;
+    if (ok) *ok = name.compare("poisson", Qt::CaseInsensitive) == 0;
+    return Arrival::Poisson;
+}
+
+void PeerSimulator::addContacts()
+{
+    QList<Contact> contacts;
+    contacts.reserve(config.contacts);
+    for (int i = 0; i < config.contacts; ++i) {
+        contacts.append(Contact(contactName(i), QString::number(9000000000LL + i)));
+    }
+    int added = service->addContacts(contacts);
+    qDebug() << "Simulator added" << added << "contacts";
+}
+
+void PeerSimulator::start()
+{
+    if (running) return;
+    if (config.contacts < 1 || config.messagesPerSecond <= 0.0) {
+        qDebug() << "Simulator needs at least one contact and a positive rate";
+        QTimer::singleShot(0, this, &PeerSimulator::finished);
+        return;
+    }
+
+    result = Report();
+    result.targetRate = config.messagesPerSecond;
+    pending = decltype(pending)();
+    awaiting.clear();
+    awaitingCount = 0;
+    running = true;
+    clock.start();
+
+    const double meanGapMs = 1000.0 / config.messagesPerSecond;
+    if (config.arrival == Arrival::Poisson) {
+        pending.push(Event{exponentialNs(meanGapMs), pickContact(), 1});
+    } else {
+        pending.push(Event{exponentialNs(meanGapMs * qMax(1.0, config.meanBurstSize)), -1, 0});
+    }
+    rearm();
+}
+
+void PeerSimulator::stop()
+{
+    if (!running) return;
+
+    running = false;
+    timer->stop();
+    result.elapsedSeconds = clock.nsecsElapsed() / 1e9;
+    result.achievedRate = result.elapsedSeconds > 0.0 ? result.messages / result.elapsedSeconds : 0.0;
+    // Queued messages still on the core thread finish the run when applied
+    if (awaitingCount == 0) {
+        emit finished();
+    }
+}
+
+void PeerSimulator::onMessagesReceived(const MessageBatch &batch)
+{
+    if (awaitingCount == 0) return;
+
+    qint64 now = clock.nsecsElapsed();
+    PerfMonitor &monitor = PerfMonitor::instance();
+    for (const auto &item : batch) {
+        auto it = awaiting.find(item.first);
+        if (it == awaiting.end() || it.value().isEmpty()) continue;
+        // The core thread keeps one producer's messages in order
+        qint64 dueNs = it.value().dequeue();
+        --awaitingCount;
+        result.ingest.add(now - dueNs);
+        monitor.record(QStringLiteral("sim.ingest"), now - dueNs);
+    }
+    if (awaitingCount == 0 && !running) {
+        emit finished();
+    }
+}
+
+void PeerSimulator::deliverDue()
+{
+    if (!running) return;
+
+    const qint64 limitNs = config.durationMs > 0 ? config.durationMs * 1000000 : std::numeric_limits<qint64>::max();
+    const double meanGapMs = 1000.0 / config.messagesPerSecond;
+    qint64 now = clock.nsecsElapsed();
+    int delivered = 0;
+
+    while (!pending.empty() && pending.top().dueNs <= now && pending.top().dueNs < limitNs
+           && delivered < MaxPerTick) {
+        Event event = pending.top();
+        pending.pop();
+
+        // Next arrivals follow from the schedule, not from when this one went
+        // out, so a slow receiver can't lower the offered rate
+        if (event.remaining == 0) {
+            pending.push(Event{event.dueNs + exponentialNs(meanGapMs * qMax(1.0, config.meanBurstSize)), -1, 0});
+            pending.push(Event{event.dueNs, pickContact(), burstLength()});
+            continue;
+        }
+        if (config.arrival == Arrival::Poisson) {
+            pending.push(Event{event.dueNs + exponentialNs(meanGapMs), pickContact(), 1});
+        } else if (event.remaining > 1) {
+            pending.push(Event{event.dueNs + exponentialNs(config.burstGapMs), event.contact, event.remaining - 1});
+        }
+
+        QString text = makeText();
+        QString contact = contactName(event.contact);
+        qint64 startNs = clock.nsecsElapsed();
+        if (config.queued) {
+            // Timed when its batch is applied, from when it was due
+            awaiting[contact].enqueue(event.dueNs);
+            ++awaitingCount;
+            service->ingestMessage(contact, text);
+        } else {
+            service->receiveMessage(contact, text);
+        }
+        qint64 endNs = clock.nsecsElapsed();
+
+        result.lag.add(startNs - event.dueNs);
+        if (!config.queued) {
+            result.ingest.add(endNs - startNs);
+            PerfMonitor::instance().record(QStringLiteral("sim.ingest"), endNs - startNs);
+        }
+        ++result.messages;
+        result.characters += text.size();
+        ++delivered;
+        now = endNs;
+    }
+
+    bool exhausted = pending.empty() || pending.top().dueNs >= limitNs;
+    if (exhausted && now >= limitNs) {
+        stop();
+        return;
+    }
+    rearm();
+}
+
+void PeerSimulator::rearm()
+{
+    const qint64 limitNs = config.durationMs > 0 ? config.durationMs * 1000000 : std::numeric_limits<qint64>::max();
+    qint64 dueNs = pending.empty() ? limitNs : qMin(pending.top().dueNs, limitNs);
+    qint64 waitNs = dueNs - clock.nsecsElapsed();
+    timer->start(waitNs > 0 ? int(qMin<qint64>(waitNs / 1000000, 1000)) : 0);
+}
+
+qint64 PeerSimulator::exponentialNs(double meanMs)
+{
+    return qint64(-std::log(1.0 - random.generateDouble()) * meanMs * 1e6);
+}
+
+int PeerSimulator::pickContact()
+{
+    double target = random.generateDouble() * contactWeights.back();
+    auto it = std::upper_bound(contactWeights.begin(), contactWeights.end(), target);
+    return qMin(int(it - contactWeights.begin()), config.contacts - 1);
+}
+
+int PeerSimulator::burstLength()
+{
+    // Geometric with the configured mean
+    if (config.meanBurstSize <= 1.0) return 1;
+    double u = 1.0 - random.generateDouble();
+    return 1 + int(std::log(u) / std::log(1.0 - 1.0 / config.meanBurstSize));
+}
+
+QString PeerSimulator::makeText()
+{
+    static const QStringList words = {
+        "hey", "how", "are", "you", "doing", "today", "just", "wanted", "to", "say",
+        "hi", "good", "morning", "evening", "what", "plans", "for", "weekend", "meeting",
+        "tomorrow", "lunch", "dinner", "coffee", "movie", "project", "deadline", "report",
+        "call", "me", "later", "thanks", "sure", "maybe", "tonight", "weather", "rain",
+        "train", "flight", "hotel", "birthday", "party", "gift", "cricket", "match",
+        "score", "exam", "results", "office", "holiday", "trip", "goa", "mumbai", "delhi",
+        "bangalore", "photos", "video", "music", "concert", "tickets", "budget", "invoice"
+    };
+
+    // Log-normal length: median * e^(sigma * z), z standard normal by Box-Muller
+    double u1 = 1.0 - random.generateDouble();
+    double u2 = random.generateDouble();
+    double z = std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+    int length = qBound(1, int(std::lround(config.medianChars * std::exp(config.charsSigma * z))), config.maxChars);
+
+    QString text;
+    text.reserve(length + 16);
+    while (text.size() < length) {
+        if (!text.isEmpty()) text.append(' ');
+        // Squaring the uniform draw favours the front of the list
+        double r = random.generateDouble();
+        text.append(words[int(r * r * words.size())]);
+    }
+    text.truncate(length);
+    return text;
+}
+
+QStringList PeerSimulator::Report::summary() const
+{
+    QStringList lines;
+    lines << QString("%1 messages in %2 s: %3 msg/s achieved, %4 msg/s offered (%5%)")
+                 .arg(messages)
+                 .arg(elapsedSeconds, 0, 'f', 2)
+                 .arg(achievedRate, 0, 'f', 1)
+                 .arg(targetRate, 0, 'f', 1)
+                 .arg(targetRate > 0.0 ? 100.0 * achievedRate / targetRate : 0.0, 0, 'f', 1);
+    lines << QString("Text: %1 characters, %2 per message")
+                 .arg(characters)
+                 .arg(messages ? double(characters) / messages : 0.0, 0, 'f', 1);
+    lines << QString("Arrival lag: p50 %1 ms, p95 %2 ms, p99 %3 ms, max %4 ms")
+                 .arg(lag.percentileMs(0.50), 0, 'f', 3)
+                 .arg(lag.percentileMs(0.95), 0, 'f', 3)
+                 .arg(lag.percentileMs(0.99), 0, 'f', 3)
+                 .arg(lag.maxNs / 1e6, 0, 'f', 3);
+    lines << QString("Ingest: mean %1 ms, p50 %2 ms, p95 %3 ms, p99 %4 ms, max %5 ms")
+                 .arg(ingest.meanMs(), 0, 'f', 3)
+                 .arg(ingest.percentileMs(0.50), 0, 'f', 3)
+                 .arg(ingest.percentileMs(0.95), 0, 'f', 3)
+                 .arg(ingest.percentileMs(0.99), 0, 'f', 3)
+                 .arg(ingest.maxNs / 1e6, 0, 'f', 3);
+    return lines;
+}
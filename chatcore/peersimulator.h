@@ -0,0 +1,120 @@
+#ifndef PEERSIMULATOR_H
+#define PEERSIMULATOR_H
+
+#include "perfmonitor.h"
+#include "message.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QHash>
+#include <QQueue>
+#include <queue>
+#include <vector>
+
+class MessageService;
+class QTimer;
+
+// Plays many contacts sending messages at a target rate. Every message goes
+// through MessageService::receiveMessage, the same path as any other
+// incoming message, so whatever is connected to the service is loaded too.
+// With `queued` set they go through ingestMessage and the service's core
+// thread instead, and arrive in batches.
+//
+// Arrivals are Poisson (independent, exponentially spaced) or bursty: bursts
+// start as a Poisson process and each is a run of messages from one contact
+// a few milliseconds apart, averaging the same rate. Which contact sends is
+// Zipf-distributed, so a few are busy and most are quiet. Message lengths
+// are log-normal around a median.
+//
+// Runs on the service's thread from a timer re-armed for the next arrival.
+// Arrivals that come due while delivery is behind go out together, and how
+// late they were is reported alongside the time spent ingesting each one.
+// Queued, a message is ingested once the service has applied its batch, so
+// its time runs from the scheduled arrival to messagesReceived, and
+// finished() waits for the last one.
+class PeerSimulator : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Arrival { Poisson, Bursty };
+
+    struct Config {
+        int contacts = 1000;
+        double messagesPerSecond = 200.0;
+        Arrival arrival = Arrival::Poisson;
+        double meanBurstSize = 20.0;   // Bursty: messages per burst
+        double burstGapMs = 20.0;      // Bursty: mean gap within a burst
+        double contactSkew = 1.0;      // Zipf exponent; 0 spreads messages evenly
+        int medianChars = 40;
+        double charsSigma = 0.8;       // Standard deviation of the log of the length
+        int maxChars = 4000;
+        qint64 durationMs = 10000;     // 0 runs until stop()
+        quint32 seed = 1;
+        bool queued = false;           // ingestMessage rather than receiveMessage
+    };
+
+    struct Report {
+        qint64 messages = 0;
+        qint64 characters = 0;
+        double elapsedSeconds = 0.0;
+        double targetRate = 0.0;
+        double achievedRate = 0.0;
+        PerfMonitor::Histogram lag;     // From the scheduled arrival to delivery
+        PerfMonitor::Histogram ingest;  // Inside receiveMessage, or from the scheduled arrival to being applied when queued
+
+        QStringList summary() const;
+    };
+
+    PeerSimulator(MessageService *service, const Config &config, QObject *parent = nullptr);
+
+    static QString contactName(int index);
+    static Arrival arrivalFromName(const QString &name, bool *ok = nullptr);
+
+    // Adds the simulated contacts the store does not have yet, with one save
+    void addContacts();
+
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+    const Report &report() const { return result; }
+
+    // Deliveries per timer callback while catching up, so the event loop keeps turning
+    static const int MaxPerTick = 2000;
+
+signals:
+    void finished();
+
+private:
+    struct Event {
+        qint64 dueNs;
+        int contact;
+        int remaining;   // Messages left in the burst; 0 marks a burst start
+        bool operator>(const Event &other) const { return dueNs > other.dueNs; }
+    };
+
+    void deliverDue();
+    void rearm();
+    void onMessagesReceived(const MessageBatch &batch);
+    qint64 exponentialNs(double meanMs);
+    int pickContact();
+    int burstLength();
+    QString makeText();
+
+    MessageService *service;
+    Config config;
+    QRandomGenerator random;
+    std::vector<double> contactWeights;  // Cumulative Zipf weights
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> pending;
+
+    QTimer *timer;
+    QElapsedTimer clock;
+    bool running;
+    // Queued: scheduled arrivals per contact of what the service hasn't applied yet
+    QHash<QString, QQueue<qint64>> awaiting;
+    qint64 awaitingCount;
+    Report result;
+};
+
+#endif // PEERSIMULATOR_H
@@ -0,0 +1,92 @@
+#include "perfmonitor.h"
+#include <QFile>
+#include <QTextStream>
+#include <QDateTime>
+#include <cmath>
+
+void PerfMonitor::Histogram::add(qint64 ns)
+{
+    double us = ns / 1000.0;
+    int index = qBound(0, int(std::log2(us + 1.0) * 4.0), BucketCount - 1);
+    ++buckets[index];
+    ++count;
+    totalNs += ns;
+    maxNs = qMax(maxNs, ns);
+}
+
+double PerfMonitor::Histogram::percentileMs(double percentile) const
+{
+    if (count == 0) return 0.0;
+
+    quint64 target = quint64(std::ceil(percentile * count));
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= qMax<quint64>(1, target)) {
+            // Never report more than the largest sample actually seen
+            double upperUs = std::pow(2.0, (i + 1) / 4.0) - 1.0;
+            return qMin(upperUs / 1000.0, maxNs / 1e6);
+        }
+    }
+    return maxNs / 1e6;
+}
+
+PerfMonitor& PerfMonitor::instance()
+{
+    static PerfMonitor monitor;
+    return monitor;
+}
+
+void PerfMonitor::record(const QString &name, qint64 ns)
+{
+    data[name].add(ns);
+}
+
+void PerfMonitor::reset()
+{
+    data.clear();
+}
+
+QStringList PerfMonitor::summary() const
+{
+    QStringList lines;
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        const Histogram &h = it.value();
+        lines.append(QString("%1: n=%2 mean %3 p50 %4 p95 %5 p99 %6 max %7 ms")
+                         .arg(it.key())
+                         .arg(h.count)
+                         .arg(h.meanMs(), 0, 'f', 2)
+                         .arg(h.percentileMs(0.50), 0, 'f', 2)
+                         .arg(h.percentileMs(0.95), 0, 'f', 2)
+                         .arg(h.percentileMs(0.99), 0, 'f', 2)
+                         .arg(h.maxNs / 1e6, 0, 'f', 2));
+    }
+    return lines;
+}
+
+bool PerfMonitor::dumpToFile(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# chatsimproj timings, " << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+    for (const QString &line : summary()) {
+        out << line << "\n";
+    }
+
+    // Raw buckets so runs can be compared or re-plotted later
+    out << "\n# operation, bucket upper bound (us), count\n";
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        const Histogram &h = it.value();
+        for (int i = 0; i < Histogram::BucketCount; ++i) {
+            if (h.buckets[i] == 0) continue;
+            out << it.key() << ", "
+                << QString::number(std::pow(2.0, (i + 1) / 4.0) - 1.0, 'f', 1) << ", "
+                << h.buckets[i] << "\n";
+        }
+    }
+    return true;
+}
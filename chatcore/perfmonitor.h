@@ -0,0 +1,58 @@
+#ifndef PERFMONITOR_H
+#define PERFMONITOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QElapsedTimer>
+#include <array>
+
+// Records how long GUI-thread operations take, per operation name, in
+// log-scaled histograms. Cheap enough to leave on in normal builds.
+class PerfMonitor
+{
+public:
+    struct Histogram {
+        // Four buckets per power of two of microseconds
+        static const int BucketCount = 128;
+
+        std::array<quint32, BucketCount> buckets{};
+        quint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+
+        void add(qint64 ns);
+        // Upper bound of the bucket holding the given percentile, in ms
+        double percentileMs(double percentile) const;
+        double meanMs() const { return count ? totalNs / 1e6 / count : 0.0; }
+    };
+
+    static PerfMonitor& instance();
+
+    void record(const QString &name, qint64 ns);
+    const QMap<QString, Histogram> &histograms() const { return data; }
+    void reset();
+
+    // One line per operation: count, mean, p50, p95, p99, max
+    QStringList summary() const;
+    bool dumpToFile(const QString &filePath) const;
+
+private:
+    PerfMonitor() = default;
+
+    QMap<QString, Histogram> data;
+};
+
+// Times the enclosing scope and records it under `name`
+class PerfScope
+{
+public:
+    explicit PerfScope(const QString &name) : name(name) { timer.start(); }
+    ~PerfScope() { PerfMonitor::instance().record(name, timer.nsecsElapsed()); }
+
+private:
+    QString name;
+    QElapsedTimer timer;
+};
+
+#endif // PERFMONITOR_H
@@ -0,0 +1,399 @@
+#include "searchindexstore.h"
+#include "messagesearchindex.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QDebug>
+#include <QElapsedTimer>
+
+namespace
+{
+const quint32 SegmentMagic = 0x43534958; // "CSIX"
+const quint16 FormatVersion = 2;
+const int ManifestVersion = 2;
+
+QString manifestPath(const QString &dirPath)
+{
+    return QDir(dirPath).filePath("manifest.json");
+}
+
+// Header, then either a snapshot or a list of changes
+QByteArray encodeSegment(bool base, qint64 generation, const MessageSearchIndex *snapshot,
+                         const QVector<MessageSearchIndex::Change> &changes)
+{
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << SegmentMagic << FormatVersion << quint8(base ? 1 : 0) << generation;
+    if (base) {
+        snapshot->writeSnapshot(out);
+    } else {
+        MessageSearchIndex::writeChanges(out, changes);
+    }
+    return bytes;
+}
+
+void writeManifestFile(const QString &dirPath, qint64 generation, qint64 storeSize, const QByteArray &storeDigest,
+                       const QVector<SearchIndexStore::Segment> &segments)
+{
+    QJsonArray segmentsArray;
+    for (const SearchIndexStore::Segment &segment : segments) {
+        QJsonObject obj;
+        obj["file"] = segment.file;
+        obj["sha1"] = QString::fromLatin1(segment.checksum);
+        obj["generation"] = segment.generation;
+        obj["base"] = segment.base;
+        segmentsArray.append(obj);
+    }
+
+    QJsonObject store;
+    store["size"] = storeSize;
+    store["sha1"] = QString::fromLatin1(storeDigest);
+
+    QJsonObject manifest;
+    manifest["version"] = ManifestVersion;
+    manifest["generation"] = generation;
+    manifest["store"] = store;
+    manifest["segments"] = segmentsArray;
+
+    QDir().mkpath(dirPath);
+    QSaveFile file(manifestPath(dirPath));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(manifest).toJson());
+        file.commit();
+    }
+}
+
+bool writeSegment(const QString &path, const QByteArray &bytes, QByteArray *checksum)
+{
+    // QSaveFile only replaces the target once everything is on disk
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    file.write(bytes);
+    if (!file.commit()) return false;
+
+    *checksum = QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex();
+    return true;
+}
+
+// Applies one segment to `index` after checking it is the file the manifest names
+bool readSegment(const QString &dirPath, const SearchIndexStore::Segment &segment, MessageSearchIndex *index)
+{
+    QFile file(QDir(dirPath).filePath(segment.file));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QByteArray bytes = file.readAll();
+    if (QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex() != segment.checksum) {
+        return false;
+    }
+
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint8 base = 0;
+    qint64 generation = 0;
+    in >> magic >> version >> base >> generation;
+    if (magic != SegmentMagic || version != FormatVersion || bool(base) != segment.base
+        || generation != segment.generation) {
+        return false;
+    }
+
+    if (segment.base) {
+        return index->readSnapshot(in);
+    }
+    QVector<MessageSearchIndex::Change> changes;
+    if (!MessageSearchIndex::readChanges(in, &changes)) return false;
+    index->applyChanges(changes);
+    return true;
+}
+
+bool readSegments(const QString &dirPath, const QVector<SearchIndexStore::Segment> &segments, MessageSearchIndex *index)
+{
+    if (segments.isEmpty() || !segments.first().base) return false;
+    for (const SearchIndexStore::Segment &segment : segments) {
+        if (!readSegment(dirPath, segment, index)) return false;
+    }
+    return true;
+}
+}
+
+SearchIndexStore::SearchIndexStore(const QString &username, QObject *parent)
+    : QObject(parent), dirPath(indexDirPath(username)), storeSize(-1),
+    writing(false), discardWrite(false), closing(false), committing(false), baseLanded(false), writeOk(false)
+{
+    pool.setMaxThreadCount(1);
+}
+
+SearchIndexStore::~SearchIndexStore()
+{
+    // Let a base being written land in the manifest, without starting a merge
+    closing = true;
+    committing = false;
+    pool.waitForDone();
+    finishBaseWrite();
+}
+
+QString SearchIndexStore::indexDirPath(const QString &username)
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    return QDir(dataDir).filePath(QString("searchindex_%1").arg(username));
+}
+
+QByteArray SearchIndexStore::chatsDigest(const QByteArray &chats)
+{
+    return QCryptographicHash::hash(chats, QCryptographicHash::Sha1).toHex();
+}
+
+MessageSearchIndex *SearchIndexStore::load(const QString &username, qint64 chatsSize, const QByteArray &chatsDigest,
+                                           State *state)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QString dirPath = indexDirPath(username);
+    QFile manifestFile(manifestPath(dirPath));
+    if (!manifestFile.open(QIODevice::ReadOnly)) return nullptr;
+    QJsonObject manifest = QJsonDocument::fromJson(manifestFile.readAll()).object();
+    if (manifest["version"].toInt() != ManifestVersion) return nullptr;
+
+    // The chats file must be exactly the one the index was committed with
+    QJsonObject store = manifest["store"].toObject();
+    if (store["size"].toVariant().toLongLong() != chatsSize
+        || store["sha1"].toString().toLatin1() != chatsDigest) {
+        qDebug() << "Search index does not match the chats file; rebuilding";
+        return nullptr;
+    }
+
+    State loaded;
+    loaded.generation = manifest["generation"].toVariant().toLongLong();
+    for (const QJsonValue &value : manifest["segments"].toArray()) {
+        QJsonObject obj = value.toObject();
+        Segment segment;
+        segment.file = obj["file"].toString();
+        segment.checksum = obj["sha1"].toString().toLatin1();
+        segment.generation = obj["generation"].toVariant().toLongLong();
+        segment.base = obj["base"].toBool();
+        loaded.segments.append(segment);
+    }
+
+    MessageSearchIndex *index = new MessageSearchIndex();
+    if (!readSegments(dirPath, loaded.segments, index)) {
+        qDebug() << "Search index failed verification; rebuilding";
+        delete index;
+        return nullptr;
+    }
+
+    *state = loaded;
+    qDebug() << "Search index loaded in" << timer.elapsed() << "ms:" << index->documentCount()
+             << "messages," << loaded.segments.size() << "segments";
+    return index;
+}
+
+void SearchIndexStore::adopt(const State &loaded)
+{
+    state = loaded;
+}
+
+bool SearchIndexStore::hasBase() const
+{
+    return !state.segments.isEmpty() && state.segments.first().base;
+}
+
+void SearchIndexStore::commit(MessageSearchIndex *index, const QString &chatsPath)
+{
+    if (!QFileInfo::exists(chatsPath)) return;
+
+    QFile chats(chatsPath);
+    if (!chats.open(QIODevice::ReadOnly)) return;
+
+    PendingCommit pending = prepareCommit(index);
+    writeCommit(&pending, chatsPath, chatsDigest(chats.readAll()));
+    finishCommit(pending, index);
+}
+
+SearchIndexStore::PendingCommit SearchIndexStore::prepareCommit(MessageSearchIndex *index)
+{
+    PendingCommit pending;
+    if (!hasBase() && !writing) {
+        // Everything in memory goes into the base, so nothing is journaled before it
+        index->setJournaling(true);
+        index->takeChanges();
+        pending.base = true;
+        // Implicitly shared; later changes detach the live index instead
+        pending.snapshot = *index;
+    } else {
+        pending.changes = index->takeChanges();
+    }
+
+    pending.dirPath = dirPath;
+    pending.generation = state.generation + 1;
+    pending.segments = state.segments;
+    committing = true;
+    return pending;
+}
+
+void SearchIndexStore::writeCommit(PendingCommit *pending, const QString &chatsPath, const QByteArray &digest)
+{
+    QFileInfo chats(chatsPath);
+    // Without the chats file the pending changes have nowhere to go
+    if (!chats.exists()) return;
+
+    if (!pending->base && !pending->changes.isEmpty()) {
+        Segment segment;
+        segment.file = QString("delta_%1.idx").arg(pending->generation);
+        segment.generation = pending->generation;
+        segment.base = false;
+
+        QDir().mkpath(pending->dirPath);
+        if (!writeSegment(QDir(pending->dirPath).filePath(segment.file),
+                          encodeSegment(false, pending->generation, nullptr, pending->changes), &segment.checksum)) {
+            qDebug() << "Could not write search index delta; the next session rebuilds it";
+            return;
+        }
+        pending->segments.append(segment);
+    }
+
+    // A base is written later by the pool; until then the manifest lists what is on disk
+    pending->storeSize = chats.size();
+    pending->storeDigest = digest;
+    writeManifestFile(pending->dirPath, pending->generation, pending->storeSize, pending->storeDigest,
+                      pending->segments);
+    pending->written = true;
+}
+
+void SearchIndexStore::abandon(MessageSearchIndex *index)
+{
+    committing = false;
+    // Without the lost changes the segments no longer describe the chats
+    state.segments.clear();
+    discardWrite = writing;
+    index->setJournaling(false);
+    writeManifest();
+    landBase();
+}
+
+void SearchIndexStore::finishCommit(const PendingCommit &pending, MessageSearchIndex *index)
+{
+    // The changes were taken from the journal; unwritten, the segments no longer match
+    if (!pending.written) {
+        abandon(index);
+        return;
+    }
+    committing = false;
+
+    // Only bookkeeping here: the delta and manifest are on disk already
+    state.generation = pending.generation;
+    state.segments = pending.segments;
+    storeSize = pending.storeSize;
+    storeDigest = pending.storeDigest;
+    if (pending.base) {
+        startBaseWrite(pending.snapshot, {}, state.generation);
+    }
+    landBase();
+    mergeIfNeeded();
+}
+
+void SearchIndexStore::landBase()
+{
+    if (!baseLanded) return;
+    baseLanded = false;
+    finishBaseWrite();
+}
+
+void SearchIndexStore::startBaseWrite(const MessageSearchIndex &snapshot, const QVector<Segment> &inputs, qint64 generation)
+{
+    writing = true;
+    QString dir = dirPath;
+
+    // The snapshot is an implicitly shared copy: the worker reads it while
+    // the GUI thread's next change detaches its own containers
+    pool.start([this, snapshot, inputs, generation, dir]() {
+        Segment segment;
+        segment.file = QString("base_%1.idx").arg(generation);
+        segment.generation = generation;
+        segment.base = true;
+
+        bool ok = true;
+        MessageSearchIndex merged;
+        const MessageSearchIndex *source = &snapshot;
+        if (!inputs.isEmpty()) {
+            ok = readSegments(dir, inputs, &merged);
+            source = &merged;
+        }
+        if (ok) {
+            QDir().mkpath(dir);
+            ok = writeSegment(QDir(dir).filePath(segment.file),
+                              encodeSegment(true, generation, source, {}), &segment.checksum);
+        }
+
+        writtenBase = segment;
+        writeOk = ok;
+        QMetaObject::invokeMethod(this, [this]() { finishBaseWrite(); }, Qt::QueuedConnection);
+    });
+}
+
+void SearchIndexStore::finishBaseWrite()
+{
+    if (!writing) return;
+    if (committing) {
+        baseLanded = true;
+        return;
+    }
+    writing = false;
+
+    if (discardWrite) {
+        discardWrite = false;
+        return;
+    }
+    if (!writeOk) {
+        qDebug() << "Could not write search index base" << writtenBase.file;
+        return;
+    }
+
+    // The new base replaces everything up to its generation
+    QVector<Segment> segments{writtenBase};
+    for (const Segment &segment : std::as_const(state.segments)) {
+        if (!segment.base && segment.generation > writtenBase.generation) {
+            segments.append(segment);
+        }
+    }
+    state.segments = segments;
+
+    writeManifest();
+    removeUnusedFiles();
+    mergeIfNeeded();
+}
+
+void SearchIndexStore::mergeIfNeeded()
+{
+    if (closing || writing || !hasBase() || state.segments.size() - 1 < MaxDeltaSegments) return;
+
+    qDebug() << "Merging" << state.segments.size() << "search index segments";
+    startBaseWrite(MessageSearchIndex(), state.segments, state.segments.last().generation);
+}
+
+void SearchIndexStore::writeManifest()
+{
+    writeManifestFile(dirPath, state.generation, storeSize, storeDigest, state.segments);
+}
+
+void SearchIndexStore::removeUnusedFiles()
+{
+    QDir dir(dirPath);
+    for (const QString &name : dir.entryList({"*.idx"}, QDir::Files)) {
+        bool used = false;
+        for (const Segment &segment : std::as_const(state.segments)) {
+            used = used || segment.file == name;
+        }
+        if (!used) {
+            dir.remove(name);
+        }
+    }
+}
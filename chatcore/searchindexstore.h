@@ -0,0 +1,114 @@
+#ifndef SEARCHINDEXSTORE_H
+#define SEARCHINDEXSTORE_H
+
+#include "messagesearchindex.h"
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QThreadPool>
+
+// Keeps a user's MessageSearchIndex on disk next to the chat store, so a new
+// session can search without re-tokenizing its history. The index is one base
+// segment plus a delta segment per chats-file save. A manifest lists the
+// segments with their checksums, and records the generation, size and SHA-1
+// of the chats file they describe. Loading checks all of that and gives up
+// rather than return an index that disagrees with the chats.
+// Once enough deltas pile up they are merged into a new base in the background.
+class SearchIndexStore : public QObject
+{
+    Q_OBJECT
+public:
+    struct Segment {
+        QString file;        // Name within the index directory
+        QByteArray checksum; // Hex SHA-1 of the file
+        qint64 generation;   // Last chats-file generation the segment covers
+        bool base;
+    };
+
+    struct State {
+        qint64 generation = 0;
+        QVector<Segment> segments; // Base first, then deltas in order
+    };
+
+    // A commit in three steps, so the files are written on another thread:
+    // the index as of the chats snapshot, its delta and manifest written
+    // after that snapshot, then recorded here
+    struct PendingCommit {
+        bool base = false;
+        MessageSearchIndex snapshot;   // The whole index when `base` is set
+        QVector<MessageSearchIndex::Change> changes;
+
+        QString dirPath;
+        qint64 generation = 0;
+        QVector<Segment> segments;     // As they are once committed
+        qint64 storeSize = -1;
+        QByteArray storeDigest;
+        bool written = false;          // By writeCommit(): the delta and manifest are on disk
+    };
+
+    explicit SearchIndexStore(const QString &username, QObject *parent = nullptr);
+    ~SearchIndexStore();
+
+    static QString indexDirPath(const QString &username);
+
+    // Reads and verifies the index for the chats file of that size and
+    // chatsDigest(). Safe on any thread; returns nullptr if the index is
+    // missing, stale or corrupt.
+    static MessageSearchIndex *load(const QString &username, qint64 chatsSize, const QByteArray &chatsDigest,
+                                    State *state);
+    // Hex SHA-1 of a chats file's content, as the manifest records it
+    static QByteArray chatsDigest(const QByteArray &chats);
+
+    // Continues from a state returned by load()
+    void adopt(const State &loaded);
+
+    // Call right after the chats file is written. Persists the index changes
+    // since the last commit as a delta, or the whole index as a new base if
+    // there is none, and turns journaling on for `index`.
+    void commit(MessageSearchIndex *index, const QString &chatsPath);
+
+    // commit() split in three. Take the pending commit together with the
+    // chats snapshot; once that snapshot is written to `chatsPath`, write the
+    // commit on the same thread, then finish it here with no other commit in
+    // between. If the chats write failed, abandon() instead of the last two.
+    PendingCommit prepareCommit(MessageSearchIndex *index);
+    // Safe on any thread; touches only `pending` and the files. `digest` is
+    // the chatsDigest() of what was written.
+    static void writeCommit(PendingCommit *pending, const QString &chatsPath, const QByteArray &digest);
+    void finishCommit(const PendingCommit &pending, MessageSearchIndex *index);
+    // Drops the persisted index; the next commit writes a new base
+    void abandon(MessageSearchIndex *index);
+
+    // Deltas kept before they are merged into the base
+    static const int MaxDeltaSegments = 8;
+
+private:
+    bool hasBase() const;
+    void startBaseWrite(const MessageSearchIndex &snapshot, const QVector<Segment> &inputs, qint64 generation);
+    void finishBaseWrite();
+    // Finishes a base that landed during a commit
+    void landBase();
+    void mergeIfNeeded();
+    void writeManifest();
+    void removeUnusedFiles();
+
+    QString dirPath;
+    State state;
+    qint64 storeSize;
+    QByteArray storeDigest;
+
+    // Only one base is written at a time
+    QThreadPool pool;
+    bool writing;
+    bool discardWrite;   // A delta was lost, so the base being written is incomplete
+    bool closing;
+    // Between prepareCommit() and finishCommit(): a base that lands then
+    // waits, so the manifest written with the commit stays the latest
+    bool committing;
+    bool baseLanded;
+    Segment writtenBase; // Set by the worker, read once it has finished
+    bool writeOk;
+};
+
+#endif // SEARCHINDEXSTORE_H
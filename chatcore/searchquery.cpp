@@ -0,0 +1,223 @@
+#include "searchquery.h"
+#include "message.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+// Start of the named day in local time, or -1
+qint64 dayStartMs(const QString &value)
+{
+    QDate date;
+    if (value.compare("today", Qt::CaseInsensitive) == 0) {
+        date = QDate::currentDate();
+    } else if (value.compare("yesterday", Qt::CaseInsensitive) == 0) {
+        date = QDate::currentDate().addDays(-1);
+    } else {
+        date = QDate::fromString(value, Qt::ISODate);
+    }
+    return date.isValid() ? date.startOfDay().toMSecsSinceEpoch() : -1;
+}
+
+// Reads a quoted string starting after the opening quote; an unclosed quote runs to the end
+QString readQuoted(const QString &text, int *pos)
+{
+    int end = text.indexOf('"', *pos);
+    if (end < 0) end = text.size();
+    QString value = text.mid(*pos, end - *pos);
+    *pos = qMin(end + 1, int(text.size()));
+    return value.trimmed();
+}
+}
+
+SearchQuery::SearchQuery()
+    : senderIsMe(false), afterMs(std::numeric_limits<qint64>::min()),
+    untilMs(std::numeric_limits<qint64>::max()), trailingWord(false)
+{
+}
+
+SearchQuery SearchQuery::parse(const QString &text)
+{
+    SearchQuery query;
+    const int n = text.size();
+    int i = 0;
+
+    while (i < n) {
+        if (text[i].isSpace()) {
+            ++i;
+            continue;
+        }
+
+        if (text[i] == '"') {
+            ++i;
+            QString phrase = readQuoted(text, &i);
+            if (!phrase.isEmpty()) query.phraseList.append(phrase);
+            query.trailingWord = false;
+            continue;
+        }
+
+        int start = i;
+        int colon = -1;
+        while (i < n && !text[i].isSpace()) {
+            if (text[i] == ':' && colon < 0) {
+                colon = i;
+                if (i + 1 < n && text[i + 1] == '"' && isFilterKey(text.mid(start, colon - start).toLower())) break;
+            }
+            ++i;
+        }
+
+        QString key = colon > start ? text.mid(start, colon - start).toLower() : QString();
+        if (isFilterKey(key)) {
+            QString value;
+            if (i < n && text[i] == ':') {
+                // key:"quoted value"
+                i += 2;
+                value = readQuoted(text, &i);
+            } else {
+                value = text.mid(colon + 1, i - colon - 1);
+            }
+            query.applyFilter(key, value);
+            query.trailingWord = false;
+            continue;
+        }
+
+        query.wordList.append(text.mid(start, i - start));
+        query.trailingWord = i == n && text[n - 1].isLetterOrNumber();
+    }
+    return query;
+}
+
+bool SearchQuery::isFilterKey(const QString &key)
+{
+    return key == "from" || key == "in" || key == "after" || key == "before";
+}
+
+void SearchQuery::applyFilter(const QString &key, const QString &value)
+{
+    if (key == "from") {
+        if (value.compare("me", Qt::CaseInsensitive) == 0) {
+            senderIsMe = true;
+        } else if (!value.isEmpty()) {
+            senderPrefix = value;
+        }
+    } else if (key == "in") {
+        if (!value.isEmpty()) contactPrefix = value;
+    } else {
+        qint64 day = dayStartMs(value);
+        if (day >= 0 && key == "after") {
+            afterMs = qMax(afterMs, day);
+        } else if (day >= 0) {
+            untilMs = qMin(untilMs, day);
+        }
+    }
+}
+
+bool SearchQuery::isEmpty() const
+{
+    return !hasText() && !senderIsMe && senderPrefix.isEmpty() && contactPrefix.isEmpty() && !hasTimeRange();
+}
+
+QStringList SearchQuery::textTerms() const
+{
+    QStringList terms = wordList + phraseList;
+    std::stable_sort(terms.begin(), terms.end(), [](const QString &a, const QString &b) {
+        return a.size() > b.size();
+    });
+    return terms;
+}
+
+bool SearchQuery::hasTimeRange() const
+{
+    return afterMs != std::numeric_limits<qint64>::min() || untilMs != std::numeric_limits<qint64>::max();
+}
+
+bool SearchQuery::matchesSender(const QString &sender, bool isCurrentUser) const
+{
+    if (senderIsMe && !isCurrentUser) return false;
+    return senderPrefix.isEmpty() || sender.startsWith(senderPrefix, Qt::CaseInsensitive);
+}
+
+bool SearchQuery::matchesSender(const Message &msg) const
+{
+    return matchesSender(msg.sender, msg.isCurrentUser);
+}
+
+bool SearchQuery::matchesContact(const QString &contact) const
+{
+    return contactPrefix.isEmpty() || contact.startsWith(contactPrefix, Qt::CaseInsensitive);
+}
+
+bool SearchQuery::matchesText(const QString &text) const
+{
+    for (const QString &word : wordList) {
+        if (!text.contains(word, Qt::CaseInsensitive)) return false;
+    }
+    for (const QString &phrase : phraseList) {
+        if (!text.contains(phrase, Qt::CaseInsensitive)) return false;
+    }
+    return true;
+}
+
+QPair<int, int> SearchQuery::timeRange(const QList<Message> &messages) const
+{
+    if (!hasTimeRange()) {
+        return qMakePair(0, int(messages.size()));
+    }
+
+    auto first = std::lower_bound(messages.constBegin(), messages.constEnd(), afterMs,
+                                  [](const Message &msg, qint64 ms) {
+                                      return msg.timestamp.toMSecsSinceEpoch() < ms;
+                                  });
+    auto last = std::lower_bound(first, messages.constEnd(), untilMs,
+                                 [](const Message &msg, qint64 ms) {
+                                     return msg.timestamp.toMSecsSinceEpoch() < ms;
+                                 });
+    return qMakePair(int(first - messages.constBegin()), int(last - messages.constBegin()));
+}
+
+QString SearchQuery::snippet(const QString &text, int maxChars, QVector<QPair<int, int>> *highlights) const
+{
+    // Same length as the text, so match offsets carry over
+    QString line = text;
+    for (QChar &ch : line) {
+        if (ch.isSpace()) ch = QLatin1Char(' ');
+    }
+
+    QVector<QPair<int, int>> matches;
+    for (const QString &term : textTerms()) {
+        for (int at = line.indexOf(term, 0, Qt::CaseInsensitive); at >= 0;
+             at = line.indexOf(term, at + term.size(), Qt::CaseInsensitive)) {
+            matches.append(qMakePair(at, int(term.size())));
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+
+    // Start a little before the first match so it has some context
+    int start = 0;
+    if (line.size() > maxChars && !matches.isEmpty()) {
+        start = qBound(0, matches.first().first - maxChars / 4, int(line.size()) - maxChars);
+    }
+    int end = qMin(int(line.size()), start + maxChars);
+
+    QString result = line.mid(start, end - start);
+    int shift = -start;
+    if (start > 0) {
+        result.prepend(QChar(0x2026));
+        shift += 1;
+    }
+    if (end < line.size()) {
+        result.append(QChar(0x2026));
+    }
+
+    highlights->clear();
+    int covered = start;
+    for (const auto &match : std::as_const(matches)) {
+        // Overlapping matches of different terms are drawn once
+        int from = qMax(match.first, covered);
+        int to = qMin(match.first + match.second, end);
+        if (from >= to) continue;
+        highlights->append(qMakePair(from + shift, to - from));
+        covered = to;
+    }
+    return result;
+}
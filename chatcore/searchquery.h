@@ -0,0 +1,76 @@
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+struct Message;
+
+// A search typed into the search bar. Free words and "quoted phrases" must
+// all appear in a message (case-insensitively). Filters narrow the search
+// before any text is compared:
+//   from:name    sender starts with name; from:me is the current user
+//   in:name      conversation with a contact whose name starts with name
+//   after:date   on or after that day (yyyy-MM-dd, today, yesterday)
+//   before:date  before that day
+// Quoted values work too: from:"Krishna S". A filter with a missing or
+// unparsable value is ignored, so half-typed filters don't empty the results.
+class SearchQuery
+{
+public:
+    SearchQuery();
+
+    static SearchQuery parse(const QString &text);
+
+    // Nothing to match and nothing to filter by
+    bool isEmpty() const;
+    bool hasText() const { return !wordList.isEmpty() || !phraseList.isEmpty(); }
+
+    const QStringList &words() const { return wordList; }
+    const QStringList &phrases() const { return phraseList; }
+    // Words and phrases, longest first: a longer pattern rejects more messages
+    QStringList textTerms() const;
+    // True when the query ends inside a free word, which may still be growing
+    bool endsInWord() const { return trailingWord; }
+
+    bool hasTimeRange() const;
+    qint64 notBeforeMs() const { return afterMs; }
+    qint64 beforeMs() const { return untilMs; }
+    bool matchesTime(qint64 timeMs) const { return timeMs >= afterMs && timeMs < untilMs; }
+
+    bool fromMe() const { return senderIsMe; }
+    bool filtersSenderName() const { return !senderPrefix.isEmpty(); }
+    bool filtersContact() const { return !contactPrefix.isEmpty(); }
+    bool matchesSender(const QString &sender, bool isCurrentUser) const;
+    bool matchesSender(const Message &msg) const;
+    bool matchesContact(const QString &contact) const;
+    // Every word and phrase occurs in `text`
+    bool matchesText(const QString &text) const;
+
+    // At most `maxChars` of `text` on one line, around the first match, with
+    // "…" where it was cut. `highlights` receives (start, length) of every
+    // word and phrase occurrence within the snippet.
+    QString snippet(const QString &text, int maxChars, QVector<QPair<int, int>> *highlights) const;
+
+    // Index range [first, last) of the messages inside the time bounds.
+    // Histories are in timestamp order, so this is two binary searches.
+    QPair<int, int> timeRange(const QList<Message> &messages) const;
+
+private:
+    static bool isFilterKey(const QString &key);
+    void applyFilter(const QString &key, const QString &value);
+
+    QStringList wordList;
+    QStringList phraseList;
+    QString senderPrefix;
+    bool senderIsMe;
+    QString contactPrefix;
+    qint64 afterMs;
+    qint64 untilMs;
+    bool trailingWord;
+};
+
+#endif // SEARCHQUERY_H
@@ -0,0 +1,393 @@
+#include "trigramindex.h"
+#include "searchquery.h"
+#include "foldedstringmatcher.h"
+#include <algorithm>
+#include <vector>
+
+TrigramIndex::TrigramIndex()
+    : deadDocs(0), tombstones(0), postingTotal(0)
+{
+}
+
+bool TrigramIndex::isEnabled()
+{
+    static const bool enabled = qEnvironmentVariableIntValue("CHATSIM_TRIGRAM_INDEX") != 0;
+    return enabled;
+}
+
+QVector<quint64> TrigramIndex::trigrams(const QString &folded)
+{
+    // Three UTF-16 units packed into one key; sorted and distinct
+    QVector<quint64> keys;
+    const ushort *units = folded.utf16();
+    for (int i = 0; i + 2 < folded.size(); ++i) {
+        keys.append((quint64(units[i]) << 32) | (quint64(units[i + 1]) << 16) | units[i + 2]);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+int TrigramIndex::maxEdits(const QString &term)
+{
+    // Each edit can break three trigrams and at least one must survive
+    int count = trigrams(term.toCaseFolded()).size();
+    return qBound(0, (count - 1) / 3, 2);
+}
+
+void TrigramIndex::clear()
+{
+    postings.clear();
+    docs.clear();
+    docByMessageId.clear();
+    contactNames.clear();
+    contactByName.clear();
+    deadDocs = 0;
+    tombstones = 0;
+    postingTotal = 0;
+}
+
+int TrigramIndex::contactIndex(const QString &contact)
+{
+    auto it = contactByName.constFind(contact);
+    if (it != contactByName.constEnd()) {
+        return it.value();
+    }
+    int index = contactNames.size();
+    contactNames.append(contact);
+    contactByName.insert(contact, index);
+    return index;
+}
+
+void TrigramIndex::addConversation(const QString &contact, const QList<Message> &messages)
+{
+    docs.reserve(docs.size() + messages.size());
+    for (const Message &msg : messages) {
+        addMessage(contact, msg);
+    }
+}
+
+void TrigramIndex::addMessage(const QString &contact, const Message &msg)
+{
+    if (docByMessageId.contains(msg.id)) {
+        updateMessage(contact, msg);
+        return;
+    }
+
+    int doc = docs.size();
+    Document document;
+    document.messageId = msg.id;
+    document.text = msg.content;
+    document.contact = contactIndex(contact);
+    document.sender = msg.sender;
+    document.fromMe = msg.isCurrentUser;
+    document.time = msg.timestamp.toMSecsSinceEpoch();
+    docs.append(document);
+    docByMessageId.insert(msg.id, doc);
+
+    const QVector<quint64> keys = trigrams(msg.content.toCaseFolded());
+    for (quint64 key : keys) {
+        // New documents have the highest ID, so appending keeps lists sorted
+        postings[key].append(doc);
+    }
+    postingTotal += keys.size();
+}
+
+void TrigramIndex::updateMessage(const QString &contact, const Message &msg)
+{
+    auto it = docByMessageId.constFind(msg.id);
+    if (it != docByMessageId.constEnd()) {
+        removeDocument(it.value());
+    }
+    addMessage(contact, msg);
+}
+
+void TrigramIndex::removeMessage(const QString &messageId)
+{
+    auto it = docByMessageId.constFind(messageId);
+    if (it == docByMessageId.constEnd()) return;
+    removeDocument(it.value());
+}
+
+void TrigramIndex::removeDocument(int doc)
+{
+    Document &document = docs[doc];
+    if (document.messageId.isEmpty()) return;
+
+    docByMessageId.remove(document.messageId);
+    document.messageId.clear();
+    document.text.clear();
+    ++deadDocs;
+    ++tombstones;
+
+    if (tombstones > 1024 && tombstones * 4 > documentCount() + tombstones) {
+        compact();
+    }
+}
+
+void TrigramIndex::removeContact(const QString &contact)
+{
+    int index = contactByName.value(contact, -1);
+    if (index < 0) return;
+
+    for (int doc = 0; doc < docs.size(); ++doc) {
+        if (docs[doc].contact == index && !docs[doc].messageId.isEmpty()) {
+            removeDocument(doc);
+        }
+    }
+}
+
+void TrigramIndex::renameContact(const QString &oldName, const QString &newName)
+{
+    int index = contactByName.value(oldName, -1);
+    if (index < 0 || oldName == newName) return;
+
+    contactByName.remove(oldName);
+    contactByName.insert(newName, index);
+    contactNames[index] = newName;
+}
+
+void TrigramIndex::compact()
+{
+    postingTotal = 0;
+    for (auto it = postings.begin(); it != postings.end();) {
+        QVector<int> &list = it.value();
+        list.erase(std::remove_if(list.begin(), list.end(), [this](int doc) {
+                       return docs[doc].messageId.isEmpty();
+                   }), list.end());
+        if (list.isEmpty()) {
+            it = postings.erase(it);
+        } else {
+            list.squeeze();
+            postingTotal += list.size();
+            ++it;
+        }
+    }
+    tombstones = 0;
+    if (deadDocs == docs.size()) {
+        clear();
+    }
+}
+
+bool TrigramIndex::admits(const Document &document, const SearchQuery &query) const
+{
+    return !document.messageId.isEmpty()
+           && query.matchesTime(document.time)
+           && query.matchesSender(document.sender, document.fromMe)
+           && query.matchesContact(contactNames[document.contact]);
+}
+
+QVector<int> TrigramIndex::intersect(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    std::set_intersection(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), std::back_inserter(result));
+    return result;
+}
+
+QVector<int> TrigramIndex::fragmentCandidates(const QString &term) const
+{
+    const QVector<quint64> keys = trigrams(term.toCaseFolded());
+    QVector<const QVector<int>*> lists;
+    for (quint64 key : keys) {
+        auto it = postings.constFind(key);
+        if (it == postings.constEnd()) return {};
+        lists.append(&it.value());
+    }
+    if (lists.isEmpty()) return {};
+
+    // Rarest first, so each later list is only probed for the survivors
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> candidates;
+    for (int doc : *lists.first()) {
+        if (!docs[doc].messageId.isEmpty()) candidates.append(doc);
+    }
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        const QVector<int> &list = *lists[i];
+        QVector<int> kept;
+        auto from = list.constBegin();
+        for (int doc : std::as_const(candidates)) {
+            from = std::lower_bound(from, list.constEnd(), doc);
+            if (from == list.constEnd()) break;
+            if (*from == doc) kept.append(doc);
+        }
+        candidates.swap(kept);
+    }
+    return candidates;
+}
+
+QVector<int> TrigramIndex::pieceCandidates(const QString &term, int k) const
+{
+    // k edits touch at most k of the k + 1 pieces, so one is found exactly
+    QVector<int> candidates;
+    const int pieces = k + 1;
+    for (int i = 0; i < pieces; ++i) {
+        int from = term.size() * i / pieces;
+        int to = term.size() * (i + 1) / pieces;
+        QVector<int> pieceDocs = fragmentCandidates(term.mid(from, to - from));
+        QVector<int> merged;
+        std::set_union(candidates.constBegin(), candidates.constEnd(), pieceDocs.constBegin(), pieceDocs.constEnd(),
+                       std::back_inserter(merged));
+        candidates.swap(merged);
+    }
+    return candidates;
+}
+
+int TrigramIndex::substringDistance(const QString &pattern, const QString &text, int maxEdits)
+{
+    // Edit distance where the match may start and end anywhere in the text:
+    // row 0 stays zero instead of counting skipped text
+    const int m = pattern.size();
+    QVector<int> previous(m + 1);
+    QVector<int> current(m + 1);
+    for (int i = 0; i <= m; ++i) previous[i] = i;
+
+    int best = previous[m];
+    for (QChar ch : text) {
+        current[0] = 0;
+        for (int i = 1; i <= m; ++i) {
+            int substitute = previous[i - 1] + (pattern[i - 1] == ch ? 0 : 1);
+            current[i] = qMin(substitute, qMin(previous[i], current[i - 1]) + 1);
+        }
+        best = qMin(best, current[m]);
+        if (best == 0) break;
+        previous.swap(current);
+    }
+    return qMin(best, maxEdits + 1);
+}
+
+QVector<TrigramIndex::Hit> TrigramIndex::searchFragments(const SearchQuery &query, int limit, int *total) const
+{
+    if (total) *total = 0;
+    const QStringList terms = query.textTerms();
+
+    QVector<int> candidates;
+    bool haveCandidates = false;
+    for (const QString &term : terms) {
+        if (term.size() < 3) continue;
+        QVector<int> termCandidates = fragmentCandidates(term);
+        candidates = haveCandidates ? intersect(candidates, termCandidates) : termCandidates;
+        haveCandidates = true;
+        if (candidates.isEmpty()) break;
+    }
+    if (!haveCandidates) return {};
+
+    // Sharing every trigram doesn't make a term a substring, so check the text
+    std::vector<FoldedStringMatcher> matchers;
+    for (const QString &term : terms) {
+        matchers.emplace_back(term);
+    }
+    QVector<int> matched;
+    for (int doc : std::as_const(candidates)) {
+        const Document &document = docs[doc];
+        if (!admits(document, query)) continue;
+        bool all = std::all_of(matchers.begin(), matchers.end(), [&document](const FoldedStringMatcher &matcher) {
+            return matcher.matches(document.text);
+        });
+        if (all) matched.append(doc);
+    }
+    if (total) *total = matched.size();
+
+    int count = qMin(limit, int(matched.size()));
+    std::partial_sort(matched.begin(), matched.begin() + count, matched.end(), [this](int a, int b) {
+        return docs[a].time > docs[b].time;
+    });
+
+    QVector<Hit> hits;
+    hits.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const Document &document = docs[matched[i]];
+        hits.append(Hit{contactNames[document.contact], document.messageId,
+                        QDateTime::fromMSecsSinceEpoch(document.time), 0, document.text});
+    }
+    return hits;
+}
+
+QVector<TrigramIndex::Hit> TrigramIndex::searchApproximate(const SearchQuery &query, int limit, int *total) const
+{
+    if (total) *total = 0;
+    const QStringList terms = query.textTerms();
+
+    QVector<int> candidates;
+    bool haveCandidates = false;
+    QVector<int> edits;
+    QStringList foldedTerms;
+    for (const QString &term : terms) {
+        QString folded = term.toCaseFolded();
+        int k = maxEdits(term);
+        edits.append(k);
+        foldedTerms.append(folded);
+
+        QVector<int> termCandidates;
+        if (k > 0) {
+            termCandidates = pieceCandidates(folded, k);
+        } else if (term.size() >= 3) {
+            termCandidates = fragmentCandidates(term);
+        } else {
+            continue;
+        }
+        candidates = haveCandidates ? intersect(candidates, termCandidates) : termCandidates;
+        haveCandidates = true;
+        if (candidates.isEmpty()) break;
+    }
+    if (!haveCandidates) return {};
+
+    // A common piece can still pull in much of the history; documents are
+    // numbered in arrival order, so keep the newest
+    if (candidates.size() > MaxApproximateCandidates) {
+        candidates.remove(0, candidates.size() - MaxApproximateCandidates);
+    }
+
+    struct Scored {
+        int doc;
+        int distance;
+    };
+    QVector<Scored> matched;
+    for (int doc : std::as_const(candidates)) {
+        const Document &document = docs[doc];
+        if (!admits(document, query)) continue;
+
+        QString text = document.text.toCaseFolded();
+        int distance = 0;
+        for (int i = 0; i < foldedTerms.size() && distance >= 0; ++i) {
+            int termDistance = substringDistance(foldedTerms[i], text, edits[i]);
+            distance = termDistance > edits[i] ? -1 : distance + termDistance;
+        }
+        if (distance >= 0) matched.append(Scored{doc, distance});
+    }
+    if (total) *total = matched.size();
+
+    int count = qMin(limit, int(matched.size()));
+    std::partial_sort(matched.begin(), matched.begin() + count, matched.end(), [this](const Scored &a, const Scored &b) {
+        return a.distance < b.distance || (a.distance == b.distance && docs[a.doc].time > docs[b.doc].time);
+    });
+
+    QVector<Hit> hits;
+    hits.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const Document &document = docs[matched[i].doc];
+        hits.append(Hit{contactNames[document.contact], document.messageId,
+                        QDateTime::fromMSecsSinceEpoch(document.time), matched[i].distance, document.text});
+    }
+    return hits;
+}
+
+qint64 TrigramIndex::memoryBytes() const
+{
+    // Rough figures for Qt's containers: array headers, hash nodes and buckets
+    const qint64 arrayHeader = 24;
+    const qint64 hashNode = 32;
+
+    qint64 bytes = 0;
+    for (auto it = postings.constBegin(); it != postings.constEnd(); ++it) {
+        bytes += hashNode + arrayHeader + qint64(it.value().capacity()) * sizeof(int);
+    }
+    bytes += qint64(docs.capacity()) * sizeof(Document);
+    for (const Document &document : docs) {
+        bytes += arrayHeader + qint64(document.messageId.capacity()) * 2;
+    }
+    bytes += qint64(docByMessageId.size()) * (hashNode + sizeof(QString) + sizeof(int));
+    return bytes;
+}
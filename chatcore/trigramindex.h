@@ -0,0 +1,106 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include "message.h"
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+class SearchQuery;
+
+// Index of every three-character sequence of every message, for searches
+// the word index can't answer: fragments inside words ("thday") and
+// misspellings ("birthdya"). Each case-folded trigram maps to the sorted
+// list of documents containing it. A fragment's documents are the
+// intersection of its trigrams' lists, verified against the text. A term
+// within k edits of some substring, cut into k + 1 pieces, has at least one
+// piece that survives untouched, so approximate candidates are the union of
+// the pieces' fragment candidates, capped to the newest documents.
+// Message text is held as an implicitly shared copy of Message::content,
+// so it costs nothing until the message is edited.
+//
+// Off by default; set CHATSIM_TRIGRAM_INDEX=1 to build it.
+class TrigramIndex
+{
+public:
+    struct Hit {
+        QString contact;
+        QString messageId;
+        QDateTime timestamp;
+        int distance;        // Edits needed; 0 for exact fragment matches
+        QString text;        // Shared with the message
+    };
+
+    // Most documents searchApproximate verifies for one query
+    static const int MaxApproximateCandidates = 20000;
+
+    TrigramIndex();
+
+    static bool isEnabled();
+
+    void clear();
+    void addConversation(const QString &contact, const QList<Message> &messages);
+    void addMessage(const QString &contact, const Message &msg);
+    void updateMessage(const QString &contact, const Message &msg);
+    void removeMessage(const QString &messageId);
+    void removeContact(const QString &contact);
+    void renameContact(const QString &oldName, const QString &newName);
+
+    // Messages containing every word and phrase of the query anywhere,
+    // newest first. Terms under three characters are only checked against
+    // the candidates of longer ones; with no longer term nothing is returned.
+    QVector<Hit> searchFragments(const SearchQuery &query, int limit, int *total = nullptr) const;
+
+    // Messages where every term of six or more characters is within one edit
+    // of a substring (two edits from nine characters), fewest edits first.
+    // Shorter terms must match exactly.
+    QVector<Hit> searchApproximate(const SearchQuery &query, int limit, int *total = nullptr) const;
+
+    // Edits allowed for a term of this length by searchApproximate
+    static int maxEdits(const QString &term);
+
+    int documentCount() const { return docs.size() - deadDocs; }
+    int trigramCount() const { return postings.size(); }
+    qint64 postingCount() const { return postingTotal; }
+    // Approximate heap use of the lists, tables and hash, not counting the shared text
+    qint64 memoryBytes() const;
+
+private:
+    struct Document {
+        QString messageId;   // Empty once deleted
+        QString text;        // Shared with the message
+        int contact;         // Index into contactNames
+        QString sender;
+        bool fromMe;
+        qint64 time;
+    };
+
+    static QVector<quint64> trigrams(const QString &folded);
+
+    int contactIndex(const QString &contact);
+    void removeDocument(int doc);
+    void compact();
+    bool admits(const Document &document, const SearchQuery &query) const;
+
+    // Live documents containing every trigram of `term`; none if it is shorter than three
+    QVector<int> fragmentCandidates(const QString &term) const;
+    // Live documents containing one of the k + 1 pieces of `term`, each at
+    // least three characters; `term` is at least 3 * (k + 1) long
+    QVector<int> pieceCandidates(const QString &term, int k) const;
+    static QVector<int> intersect(const QVector<int> &a, const QVector<int> &b);
+
+    // Fewest edits turning `pattern` into some substring of `text`, or
+    // maxEdits + 1 if more are needed; both already case-folded
+    static int substringDistance(const QString &pattern, const QString &text, int maxEdits);
+
+    QHash<quint64, QVector<int>> postings;
+    QVector<Document> docs;
+    QHash<QString, int> docByMessageId;
+    QVector<QString> contactNames;
+    QHash<QString, int> contactByName;
+    int deadDocs;
+    int tombstones;
+    qint64 postingTotal;
+};
+
+#endif // TRIGRAMINDEX_H
@@ -0,0 +1,137 @@
+#include "workstealingpool.h"
+#include <QThread>
+#include <QMutexLocker>
+
+WorkStealingPool::WorkStealingPool(int threads)
+    : queued(0), sleepers(0), stopping(false)
+{
+    threads = qMax(0, threads);
+    for (int i = 0; i <= threads; ++i) {
+        deques.append(new Deque);
+    }
+    for (int i = 0; i < threads; ++i) {
+        QThread *thread = QThread::create([this, i]() { workerLoop(i); });
+        thread->setObjectName(QString("WorkStealingPool %1").arg(i));
+        workers.append(thread);
+        thread->start();
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        QMutexLocker locker(&sleepLock);
+        stopping = true;
+        wakeup.wakeAll();
+    }
+    for (QThread *thread : workers) {
+        thread->wait();
+        delete thread;
+    }
+    qDeleteAll(deques);
+}
+
+void WorkStealingPool::parallelFor(int count, int grain, const std::function<void(int, int)> &body)
+{
+    if (count <= 0) return;
+    grain = qMax(1, grain);
+
+    // Nothing to share out
+    if (workers.isEmpty() || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    QMutexLocker locker(&callerLock);
+    const int self = workers.size();
+    Job job;
+    job.body = &body;
+    job.grain = grain;
+    job.remaining = count;
+
+    run(self, Range{0, count, &job});
+    // Help until the last range is done, wherever it runs
+    while (job.remaining.load(std::memory_order_acquire) > 0) {
+        Range range;
+        if (popNewest(self, &range) || stealOldest(self, &range)) {
+            run(self, range);
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+void WorkStealingPool::run(int self, Range range)
+{
+    // Lazy binary splitting: the back half is left for whoever is idle
+    while (range.end - range.begin > range.job->grain) {
+        int middle = range.begin + (range.end - range.begin) / 2;
+        push(self, Range{middle, range.end, range.job});
+        range.end = middle;
+    }
+    (*range.job->body)(range.begin, range.end);
+    // Releases the body's writes to the caller waiting on `remaining`
+    range.job->remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+}
+
+void WorkStealingPool::push(int self, const Range &range)
+{
+    {
+        QMutexLocker locker(&deques[self]->lock);
+        deques[self]->ranges.push_back(range);
+    }
+    queued.fetch_add(1);
+
+    // Paired with the sleeper's check in workerLoop(): either it sees the
+    // range or this sees it sleeping
+    if (sleepers.load() > 0) {
+        QMutexLocker locker(&sleepLock);
+        wakeup.wakeOne();
+    }
+}
+
+bool WorkStealingPool::popNewest(int self, Range *range)
+{
+    Deque *deque = deques[self];
+    QMutexLocker locker(&deque->lock);
+    if (deque->ranges.empty()) return false;
+    *range = deque->ranges.back();
+    deque->ranges.pop_back();
+    queued.fetch_sub(1);
+    return true;
+}
+
+bool WorkStealingPool::stealOldest(int self, Range *range)
+{
+    // Start after our own deque so thieves spread over their victims
+    const int count = deques.size();
+    for (int i = 1; i < count; ++i) {
+        Deque *deque = deques[(self + i) % count];
+        QMutexLocker locker(&deque->lock);
+        if (deque->ranges.empty()) continue;
+        *range = deque->ranges.front();
+        deque->ranges.pop_front();
+        queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int self)
+{
+    for (;;) {
+        Range range;
+        if (popNewest(self, &range) || stealOldest(self, &range)) {
+            run(self, range);
+            continue;
+        }
+
+        QMutexLocker locker(&sleepLock);
+        sleepers.fetch_add(1);
+        if (!stopping && queued.load() == 0) {
+            wakeup.wait(&sleepLock);
+        }
+        sleepers.fetch_sub(1);
+        if (stopping) return;
+    }
+}
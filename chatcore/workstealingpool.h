@@ -0,0 +1,71 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <atomic>
+#include <deque>
+#include <functional>
+
+class QThread;
+
+// Fork-join loops over a fixed set of threads, each with its own deque of
+// ranges. A thread splits the range it holds in half, keeps the front half
+// and pushes the back half onto its deque, until the range is no larger
+// than the grain. It then runs the range and takes the newest range from
+// its own deque. An idle thread steals the oldest, and so largest, range
+// from another deque. Uneven work, such as fan-out to members whose
+// histories differ in size, spreads without a central queue.
+//
+// parallelFor() runs on the calling thread as well and returns when the
+// whole range is done. One parallelFor() at a time; further callers wait.
+class WorkStealingPool
+{
+public:
+    // Worker threads besides the caller; 0 runs everything on the caller
+    explicit WorkStealingPool(int threads);
+    ~WorkStealingPool();
+
+    int threadCount() const { return workers.size(); }
+
+    // Calls body(begin, end) over [0, count) in ranges of at most `grain`
+    void parallelFor(int count, int grain, const std::function<void(int, int)> &body);
+
+private:
+    struct Job {
+        const std::function<void(int, int)> *body;
+        int grain;
+        std::atomic<int> remaining;   // Indexes not yet run
+    };
+
+    struct Range {
+        int begin;
+        int end;
+        Job *job;
+    };
+
+    struct Deque {
+        QMutex lock;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(int self);
+    void run(int self, Range range);
+    void push(int self, const Range &range);
+    bool popNewest(int self, Range *range);
+    bool stealOldest(int self, Range *range);
+
+    QVector<QThread*> workers;
+    // One per worker, then the caller's
+    QVector<Deque*> deques;
+
+    QMutex callerLock;
+    std::atomic<int> queued;     // Ranges sitting in deques
+    std::atomic<int> sleepers;
+    std::atomic<bool> stopping;
+    QMutex sleepLock;
+    QWaitCondition wakeup;
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -0,0 +1,60 @@
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17
+TARGET = chatsimproj
+
+include(chatcore/chatcore.pri)
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    addcontactdialog.cpp \
+    benchmarks.cpp \
+    chatwindow.cpp \
+    contactitemdelegate.cpp \
+    contactlistmodel.cpp \
+    conversationview.cpp \
+    loginwindow.cpp \
+    main.cpp \
+    mainwindow.cpp \
+    notificationcenter.cpp \
+    perfoverlay.cpp \
+    registerwindow.cpp \
+    searchhitnavigator.cpp \
+    searchresultdelegate.cpp \
+    textlayoutcache.cpp \
+    usermanager.cpp
+
+HEADERS += \
+    addcontactdialog.h \
+    benchmarks.h \
+    chatwindow.h \
+    contactitemdelegate.h \
+    contactlistmodel.h \
+    conversationview.h \
+    loginwindow.h \
+    mainwindow.h \
+    notificationcenter.h \
+    perfoverlay.h \
+    registerwindow.h \
+    searchhitnavigator.h \
+    searchresultdelegate.h \
+    textlayoutcache.h \
+    usermanager.h
+
+FORMS += \
+    mainwindow.ui
+
+TRANSLATIONS += \
+    chatsimproj_en_IL.ts
+CONFIG += lrelease
+CONFIG += embed_translations
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -1,39 +1,12 @@
-QT       += core gui
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++17
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    addcontactdialog.cpp \
-    chatwindow.cpp \
-    loginwindow.cpp \
-    main.cpp \
-    mainwindow.cpp \
-    registerwindow.cpp \
-    usermanager.cpp
-
-HEADERS += \
-    addcontactdialog.h \
-    chatwindow.h \
-    loginwindow.h \
-    mainwindow.h \
-    registerwindow.h \
-    usermanager.h
-
-FORMS += \
-    mainwindow.ui
-
-TRANSLATIONS += \
-    chatsimproj_en_IL.ts
-CONFIG += lrelease
-CONFIG += embed_translations
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
+TEMPLATE = subdirs
+
+# chatcore holds the chat data and logic with no widgets; the app is the
+# Qt Widgets client built on it, and server the chatsimserver it can connect to
+SUBDIRS += \
+    chatcore \
+    app \
+    server
+
+app.file = chatsimapp.pro
+app.depends = chatcore
+server.depends = chatcore
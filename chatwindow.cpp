@@ -1,12 +1,28 @@
 #include "ChatWindow.h"
 #include "AddContactDialog.h"
+#include "conversationview.h"
+#include "contactlistmodel.h"
+#include "contactitemdelegate.h"
+#include "contactsearchindex.h"
+#include "notificationcenter.h"
+#include "perfmonitor.h"
+#include "perfoverlay.h"
+#include "chatdataloader.h"
+#include "conversationstore.h"
+#include "messageservice.h"
+#include "chatclient.h"
+#include "messagesearchindex.h"
+#include "foldedstringmatcher.h"
+#include "searchquery.h"
+#include "searchresultdelegate.h"
+#include "trigramindex.h"
+#include "textlayoutcache.h"
 #include <QApplication>
 #include <QScreen>
 #include <QMessageBox>
 #include <QDateTime>
 #include <QScrollBar>
 #include <QGraphicsDropShadowEffect>
-#include <QListWidgetItem>
 #include <QTimer>
 #include <QRandomGenerator>
 #include <QJsonDocument>
@@ -18,6 +34,61 @@
 #include <QMenu>
 #include <QInputDialog>
 #include <QClipboard>
+#include <QResizeEvent>
+#include <QElapsedTimer>
+#include <QShortcut>
+#include <QListWidget>
+#include <algorithm>
+#include <vector>
+
+// BubbleTextLabel Implementation
+BubbleTextLabel::BubbleTextLabel(const QString &messageId, const QString &text, QWidget *parent)
+    : QLabel(parent), messageId(messageId), deferredWrap(false), fontId(-1) {
+    // Plain text keeps the cached metrics in line with what gets painted
+    setTextFormat(Qt::PlainText);
+    setWordWrap(true);
+    QLabel::setText(text);
+}
+
+void BubbleTextLabel::setText(const QString &text) {
+    TextLayoutCache::instance().invalidate(messageId);
+    QLabel::setText(text);
+    updateGeometry();
+}
+
+void BubbleTextLabel::setDeferredWrap(bool deferred) {
+    if (deferredWrap == deferred) return;
+    deferredWrap = deferred;
+    if (!deferred) {
+        updateGeometry();
+    }
+}
+
+void BubbleTextLabel::changeEvent(QEvent *event) {
+    // Style sheets set the font after construction; look it up again
+    if (event->type() == QEvent::FontChange || event->type() == QEvent::StyleChange) {
+        fontId = -1;
+    }
+    QLabel::changeEvent(event);
+}
+
+int BubbleTextLabel::heightForWidth(int width) const {
+    QMargins margins = contentsMargins();
+    int textWidth = width - margins.left() - margins.right() - 2 * margin();
+    int extra = margins.top() + margins.bottom() + 2 * margin();
+
+    TextLayoutCache &cache = TextLayoutCache::instance();
+    if (fontId < 0) {
+        fontId = cache.fontId(font());
+    }
+    if (deferredWrap) {
+        int cached = cache.nearestHeight(messageId, fontId, textWidth);
+        if (cached >= 0) {
+            return cached + extra;
+        }
+    }
+    return cache.height(messageId, text(), font(), fontId, textWidth) + extra;
+}
 
 // MessageWidget Implementation
 MessageWidget::MessageWidget(const Message &msg, QWidget *parent)
@@ -53,8 +124,7 @@ MessageWidget::MessageWidget(const Message &msg, QWidget *parent)
     layout->setContentsMargins(0, 0, 0, 0);
     layout->setSpacing(2);
 
-    messageLabel = new QLabel(msg.content);
-    messageLabel->setWordWrap(true);
+    messageLabel = new BubbleTextLabel(msg.id, msg.content);
     messageLabel->setStyleSheet(
         QString("QLabel { color: %1; font-size: 14px; background: transparent; }")
             .arg(msg.isCurrentUser ? "white" : "#495057")
@@ -143,7 +213,13 @@ MessageWidget::MessageWidget(const Message &msg, QWidget *parent)
     }
 }
 
+void MessageWidget::setDeferredWrap(bool deferred) {
+    messageLabel->setDeferredWrap(deferred);
+}
+
 void MessageWidget::setHighlighted(bool highlighted) {
+    // Restyling is the expensive part, so skip it when nothing changes
+    if (isHighlighted == highlighted) return;
     isHighlighted = highlighted;
 
     if (highlighted) {
@@ -231,9 +307,25 @@ void MessageWidget::setHighlighted(bool highlighted) {
 }
 
 // ChatWindow Implementation
-ChatWindow::ChatWindow(const QString &currentUser, QWidget *parent)
-    : QWidget(parent), currentUser(currentUser), selectedContact("")
+ChatWindow::ChatWindow(const QString &currentUser, QWidget *parent, ChatDataLoader *prefetched)
+    : QWidget(parent), contactSearchIndex(new ContactSearchIndex()), currentView(nullptr),
+    currentUser(currentUser), selectedContact("")
 {
+    startupTimer.start();
+    store = new ConversationStore(currentUser);
+    messageService = new MessageService(store);
+    connect(messageService, &MessageService::contactAdded, this, &ChatWindow::onContactAdded);
+    connect(messageService, &MessageService::messageAdded, this, &ChatWindow::onMessageAdded);
+    connect(messageService, &MessageService::messagesReceived, this, &ChatWindow::onMessagesReceived);
+    connect(messageService, &MessageService::messageEdited, this, &ChatWindow::onMessageEdited);
+    connect(messageService, &MessageService::messageRemoved, this, &ChatWindow::onMessageRemoved);
+    connect(messageService, &MessageService::conversationReset, this, &ChatWindow::onConversationReset);
+    searchGeneration = 0;
+    globalSearchGeneration = 0;
+    searchPool.setMaxThreadCount(1);
+    dataLoader = nullptr;
+    firstPaintLogged = false;
+
     setWindowTitle(QString("Chat - %1").arg(currentUser));
     setMinimumSize(1200, 800);
 
@@ -252,9 +344,6 @@ ChatWindow::ChatWindow(const QString &currentUser, QWidget *parent)
     move(x, y);
 
     setupUI();
-    loadContacts();
-    loadChats();
-    setupAutoMessages();
     if (QSystemTrayIcon::isSystemTrayAvailable()) {
         trayIcon = new QSystemTrayIcon(this);
         trayIcon->setIcon(QIcon(":/icons/chat.png")); // You can use any icon
@@ -262,20 +351,39 @@ ChatWindow::ChatWindow(const QString &currentUser, QWidget *parent)
     } else {
         trayIcon = nullptr;
     }
+    notificationCenter = new NotificationCenter(trayIcon, this);
+
+    // The window shows with placeholders; data streams in afterwards
+    startDataLoad(prefetched);
 
-    qDebug() << "ChatWindow constructor completed";
+    qDebug() << "ChatWindow constructor completed in" << startupTimer.elapsed() << "ms";
 }
 
 ChatWindow::~ChatWindow()
 {
-    if (autoMessageTimer) {
-        autoMessageTimer->stop();
+    // Stop any running search before the window's state goes away
+    ++searchGeneration;
+    ++globalSearchGeneration;
+    searchPool.waitForDone();
+
+    // Nothing more is delivered here; the loader stops parsing and deletes
+    // itself once its worker exits, so closing mid-load doesn't wait for it
+    if (dataLoader) {
+        disconnect(dataLoader, nullptr, this, nullptr);
+        dataLoader->discard();
+        dataLoader = nullptr;
     }
+
     if (trayIcon) {
         trayIcon->hide();
     }
-    saveContacts();
-    saveChats();
+    messageService->saveContacts();
+    // Stops auto messages and the core thread, then saves what is still queued
+    messageService->close();
+    delete messageService;
+    // Waits for a segment still being written
+    delete store;
+    delete contactSearchIndex;
 }
 
 void ChatWindow::setupUI()
@@ -298,6 +406,12 @@ void ChatWindow::setupUI()
 
     mainLayout->addWidget(splitter);
 
+    perfOverlay = new PerfOverlay(this);
+    QShortcut *overlayShortcut = new QShortcut(QKeySequence("Ctrl+Shift+P"), this);
+    connect(overlayShortcut, &QShortcut::activated, perfOverlay, &PerfOverlay::toggle);
+    QShortcut *dumpShortcut = new QShortcut(QKeySequence("Ctrl+Shift+D"), this);
+    connect(dumpShortcut, &QShortcut::activated, this, &ChatWindow::dumpPerfData);
+
     setStyleSheet(
         "QWidget {"
         "    background-color: #f8f9fa;"
@@ -442,28 +556,45 @@ void ChatWindow::setupContactsList()
     titleLayout->addStretch();
     titleLayout->addWidget(addContactButton);
 
-    // Contacts list
-    contactsList = new QListWidget();
+    // Quick-filter over names and phone numbers
+    QFrame *filterFrame = new QFrame();
+    filterFrame->setStyleSheet("background: transparent;");
+    QHBoxLayout *filterLayout = new QHBoxLayout(filterFrame);
+    filterLayout->setContentsMargins(20, 0, 20, 10);
+
+    contactFilterInput = new QLineEdit();
+    contactFilterInput->setPlaceholderText("🔍 Search contacts...");
+    contactFilterInput->setClearButtonEnabled(true);
+    contactFilterInput->setStyleSheet(
+        "QLineEdit {"
+        "    border: 2px solid #e9ecef;"
+        "    border-radius: 16px;"
+        "    padding: 6px 12px;"
+        "    font-size: 13px;"
+        "    background: #f8f9fa;"
+        "}"
+        "QLineEdit:focus {"
+        "    border-color: #667eea;"
+        "    background: #ffffff;"
+        "}"
+        );
+    filterLayout->addWidget(contactFilterInput);
+
+    // Contacts list: rows are drawn by the delegate from model roles
+    contactsModel = new ContactListModel(this);
+    contactsList = new QListView();
+    contactsList->setModel(contactsModel);
+    contactsList->setItemDelegate(new ContactItemDelegate(contactsList));
+    contactsList->setUniformItemSizes(true);
+    contactsList->setMouseTracking(true);
+    contactsList->setSelectionMode(QAbstractItemView::SingleSelection);
+    contactsList->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     contactsList->setStyleSheet(
-        "QListWidget {"
+        "QListView {"
         "    background: transparent;"
         "    border: none;"
         "    outline: none;"
         "}"
-        "QListWidget::item {"
-        "    padding: 15px 20px;"
-        "    border-bottom: 1px solid #f1f3f4;"
-        "    color: #495057;"
-        "    font-size: 14px;"
-        "}"
-        "QListWidget::item:hover {"
-        "    background-color: rgba(102, 126, 234, 0.08);"
-        "}"
-        "QListWidget::item:selected {"
-        "    background-color: rgba(102, 126, 234, 0.15);"
-        "    color: #667eea;"
-        "    font-weight: bold;"
-        "}"
         );
 
     // ENABLE CONTEXT MENU FOR CONTACTS LIST
@@ -492,16 +623,31 @@ void ChatWindow::setupContactsList()
 
     contactsLayout->addWidget(headerFrame);
     contactsLayout->addWidget(titleFrame);
+    // Shown until chat history has finished loading
+    loadingLabel = new QLabel("⏳ Loading contacts...");
+    loadingLabel->setAlignment(Qt::AlignCenter);
+    loadingLabel->setStyleSheet(
+        "QLabel {"
+        "    color: #6c757d;"
+        "    font-size: 12px;"
+        "    background: transparent;"
+        "    padding: 0 20px 8px 20px;"
+        "}"
+        );
+
+    contactsLayout->addWidget(filterFrame);
+    contactsLayout->addWidget(loadingLabel);
     contactsLayout->addWidget(contactsList);
 
     // CONNECT ALL SIGNALS
-    connect(contactsList, &QListWidget::itemClicked, this, &ChatWindow::onContactSelected);
+    connect(contactsList, &QListView::clicked, this, &ChatWindow::onContactSelected);
     connect(logoutButton, &QPushButton::clicked, this, &ChatWindow::onLogout);
     connect(addContactButton, &QPushButton::clicked, this, &ChatWindow::onAddContact);
     connect(profileButton, &QPushButton::clicked, this, &ChatWindow::onProfileClicked);
+    connect(contactFilterInput, &QLineEdit::textChanged, this, &ChatWindow::onContactFilterChanged);
 
     // NEW CONNECTIONS FOR EDIT/DELETE FUNCTIONALITY
-    connect(contactsList, &QListWidget::customContextMenuRequested,
+    connect(contactsList, &QListView::customContextMenuRequested,
             this, &ChatWindow::onContactRightClicked);
     connect(editAction, &QAction::triggered, this, &ChatWindow::onEditContact);
     connect(deleteAction, &QAction::triggered, this, &ChatWindow::onDeleteContact);
@@ -538,39 +684,16 @@ void ChatWindow::setupChatArea()
 
     setupSearchBar();
 
-    // Messages area
-    messagesScrollArea = new QScrollArea();
-    messagesScrollArea->setWidgetResizable(true);
-    messagesScrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    messagesScrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    messagesScrollArea->setStyleSheet(
-        "QScrollArea {"
-        "    border: none;"
-        "    background: #f8f9fa;"
-        "}"
-        "QScrollBar:vertical {"
-        "    background: #f1f3f4;"
-        "    width: 8px;"
-        "    border-radius: 4px;"
-        "}"
-        "QScrollBar::handle:vertical {"
-        "    background: #ced4da;"
-        "    border-radius: 4px;"
-        "    min-height: 20px;"
-        "}"
-        "QScrollBar::handle:vertical:hover {"
-        "    background: #adb5bd;"
-        "}"
-        );
-
-    messagesWidget = new QWidget();
-    messagesWidget->setStyleSheet("background: transparent;");
-    messagesLayout = new QVBoxLayout(messagesWidget);
-    messagesLayout->setContentsMargins(20, 20, 20, 20);
-    messagesLayout->setSpacing(15);
-    messagesLayout->addStretch();
+    // Messages area: the empty page shows until a contact is selected
+    messagesStack = new QStackedWidget();
+    emptyChatPage = new QWidget();
+    emptyChatPage->setStyleSheet("background: #f8f9fa;");
+    messagesStack->addWidget(emptyChatPage);
 
-    messagesScrollArea->setWidget(messagesWidget);
+    warmTrimTimer = new QTimer(this);
+    warmTrimTimer->setSingleShot(true);
+    warmTrimTimer->setInterval(1000);
+    connect(warmTrimTimer, &QTimer::timeout, this, &ChatWindow::trimWarmViews);
 
     // Input area
     inputFrame = new QFrame();
@@ -637,7 +760,8 @@ void ChatWindow::setupChatArea()
 
     chatLayout->addWidget(chatHeader);
     chatLayout->addWidget(searchFrame);
-    chatLayout->addWidget(messagesScrollArea);
+    chatLayout->addWidget(globalResultsList);
+    chatLayout->addWidget(messagesStack);
     chatLayout->addWidget(inputFrame);
 
     connect(messageInput, &QLineEdit::returnPressed, this, &ChatWindow::onSendMessage);
@@ -699,37 +823,96 @@ void ChatWindow::setupSearchBar()
         "}"
         );
 
+    // "3 of 120" with older/newer buttons; Enter steps to the older match
+    hitCountLabel = new QLabel();
+    hitCountLabel->setMinimumWidth(80);
+    hitCountLabel->setAlignment(Qt::AlignCenter);
+    hitCountLabel->setStyleSheet("QLabel { color: #6c757d; font-size: 12px; background: transparent; }");
+
+    const char *hitButtonStyle =
+        "QPushButton {"
+        "    background: #f8f9fa;"
+        "    border: 1px solid #e9ecef;"
+        "    border-radius: 15px;"
+        "    color: #495057;"
+        "    font-size: 12px;"
+        "}"
+        "QPushButton:hover {"
+        "    background: #e9ecef;"
+        "}"
+        "QPushButton:disabled {"
+        "    color: #ced4da;"
+        "}";
+
+    previousHitButton = new QPushButton("▲");
+    previousHitButton->setFixedSize(30, 30);
+    previousHitButton->setToolTip("Older match (Enter)");
+    previousHitButton->setStyleSheet(hitButtonStyle);
+
+    nextHitButton = new QPushButton("▼");
+    nextHitButton->setFixedSize(30, 30);
+    nextHitButton->setToolTip("Newer match (Shift+Enter)");
+    nextHitButton->setStyleSheet(hitButtonStyle);
+
     searchLayout->addWidget(searchLabel);
     searchLayout->addWidget(searchInput);
+    searchLayout->addWidget(hitCountLabel);
+    searchLayout->addWidget(previousHitButton);
+    searchLayout->addWidget(nextHitButton);
     searchLayout->addWidget(clearSearchButton);
 
+    connect(previousHitButton, &QPushButton::clicked, this, &ChatWindow::onPreviousHit);
+    connect(nextHitButton, &QPushButton::clicked, this, &ChatWindow::onNextHit);
+    updateHitControls();
+
+    // Searching waits for a pause in typing
+    searchDebounceTimer = new QTimer(this);
+    searchDebounceTimer->setSingleShot(true);
+    searchDebounceTimer->setInterval(150);
+    connect(searchDebounceTimer, &QTimer::timeout, this, &ChatWindow::onSearchDebounced);
+
     connect(searchInput, &QLineEdit::textChanged, this, &ChatWindow::onSearchTextChanged);
     connect(clearSearchButton, &QPushButton::clicked, this, &ChatWindow::onClearSearch);
     connect(searchInput, &QLineEdit::returnPressed, this, &ChatWindow::onSearchEnterPressed);
+
+    // Results from all chats, best first; activating one opens that chat at the message
+    globalResultsList = new QListWidget();
+    globalResultsList->setMaximumHeight(4 * SearchResultDelegate::RowHeight + 2);
+    globalResultsList->setItemDelegate(new SearchResultDelegate(globalResultsList));
+    globalResultsList->setUniformItemSizes(true);
+    globalResultsList->setMouseTracking(true);
+    globalResultsList->setStyleSheet(
+        "QListWidget {"
+        "    background: #ffffff;"
+        "    border: none;"
+        "    border-bottom: 1px solid #e9ecef;"
+        "    font-size: 13px;"
+        "    color: #495057;"
+        "    outline: none;"
+        "}"
+        );
+    globalResultsList->hide();
+
+    connect(globalResultsList, &QListWidget::itemClicked, this, &ChatWindow::onGlobalResultActivated);
+    connect(globalResultsList, &QListWidget::itemActivated, this, &ChatWindow::onGlobalResultActivated);
 }
 
 void ChatWindow::onContactSelected()
 {
-    QListWidgetItem *item = contactsList->currentItem();
-    if (!item) return;
+    QModelIndex index = contactsList->currentIndex();
+    if (!index.isValid()) return;
 
-    // Extract contact name from display text (remove unread count if present)
-    QString contactName = item->text().split('\n')[0];
-    if (contactName.contains(" (") && contactName.endsWith(")")) {
-        contactName = contactName.split(" (")[0];
-    }
-
-    selectedContact = contactName;
+    selectedContact = index.data(ContactListModel::NameRole).toString();
 
     qDebug() << "=== onContactSelected() called for:" << selectedContact << "===";
-    qDebug() << "Chat history exists:" << chatHistory.contains(selectedContact);
-    qDebug() << "Chat history size:" << chatHistory[selectedContact].size();
+    qDebug() << "Chat history exists:" << store->hasConversation(selectedContact);
+    qDebug() << "Chat history size:" << store->messages(selectedContact).size();
 
     // Clear unread count when selecting contact
-    if (unreadCounts.value(selectedContact, 0) > 0) {
-        unreadCounts[selectedContact] = 0;
+    if (contactsModel->unreadCount(selectedContact) > 0) {
         updateContactUnreadCount(selectedContact, 0);
     }
+    notificationCenter->clearContact(selectedContact);
 
     // Update chat header
     chatHeader->setText(QString("💬 Chat with %1").arg(selectedContact));
@@ -754,6 +937,12 @@ void ChatWindow::onContactSelected()
 
     // Load and display chat history
     loadChatHistory(selectedContact);
+
+    // Re-apply an active search to the page just shown
+    QString searchText = searchInput->text().trimmed();
+    if (!searchText.isEmpty()) {
+        searchMessages(searchText);
+    }
 }
 
 
@@ -762,66 +951,8 @@ void ChatWindow::onSendMessage()
     QString message = messageInput->text().trimmed();
     if (message.isEmpty() || selectedContact.isEmpty()) return;
 
-    addMessage(currentUser, message, true);
+    messageService->sendMessage(selectedContact, message);
     messageInput->clear();
-
-    // Simulate response after a short delay
-    QTimer::singleShot(1000 + QRandomGenerator::global()->bounded(2000), [this]() {
-        QStringList responses = {
-            "That's interesting! Tell me more. 🤔",
-            "I see what you mean. 👀",
-            "Thanks for sharing that! 🙏",
-            "How do you feel about that? 🧠",
-            "That sounds great! 😄",
-            "I understand your point. 👍",
-            "What do you think we should do next? 🤷",
-            "That's a good question. 🤨",
-            "Wow, really? 😲",
-            "Haha, that's funny! 😂",
-            "Can you explain that a bit more? 🧐",
-            "Hmm, let me think about that. 🤔",
-            "I'm here for you. 💬",
-            "Interesting perspective. 🧩",
-            "That makes sense. ✅",
-            "I'm not sure I follow. Could you elaborate? 🤯",
-            "Exactly! I was thinking the same. 💡",
-            "That's one way to look at it. 👓",
-            "Good point! 📌",
-            "I hadn’t thought of it that way. 🔄",
-            "You might be onto something. 🕵️",
-            "I'm curious—what made you think of that? 🧐",
-            "Could you give me an example? 📘",
-            "I appreciate your insight. 🌟",
-            "Let’s look at it from another angle. 🔍",
-            "Fascinating idea. Tell me more. 🧠",
-            "You’re making me think! 🧠💭",
-            "Let's explore that further. 🚀",
-            "That caught my attention. 👂",
-            "I like where this is going. 😎",
-            "You're absolutely right! ✅",
-            "This is getting interesting. 👀",
-            "Hmm, that's debatable. 🤨",
-            "Now that's something to consider. 🧐",
-            "Intriguing thought. 🧠✨",
-            "Can you clarify that a little? 🤓",
-            "Let me make sure I got that right. 📝",
-            "Totally! Couldn't agree more. 🙌",
-            "That's a bold statement! 🔥",
-            "Tell me why you think that. 🗣️",
-            "I hear you loud and clear. 🔊",
-            "That's deep. 💭",
-            "You're raising some great points. 👏",
-            "Let's dive deeper into that. 🌊",
-            "Well said! 🎯",
-            "That perspective is refreshing. 🌿",
-            "You’ve clearly thought about this. 🤓",
-            "I like how you put that. ✍️",
-            "That reminds me of something... 💭",
-            "Go on, I'm listening. 🎧"
-        };
-        QString response = responses[QRandomGenerator::global()->bounded(responses.size())];
-        addMessage(selectedContact, response, false);
-    });
 }
 
 void ChatWindow::onProfileClicked()
@@ -918,18 +1049,12 @@ void ChatWindow::onAddContact()
     if (dialog.exec() == QDialog::Accepted) {
         Contact newContact = dialog.getContact();
 
-        // Check if contact already exists
-        for (const Contact &contact : contactsList_data) {
-            if (contact.name.toLower() == newContact.name.toLower()) {
-                QMessageBox::warning(this, "Duplicate Contact",
-                                     "A contact with this name already exists!");
-                return;
-            }
+        // Refused if a contact with the name already exists
+        if (!messageService->addContact(newContact)) {
+            QMessageBox::warning(this, "Duplicate Contact",
+                                 "A contact with this name already exists!");
+            return;
         }
-
-        contactsList_data.append(newContact);
-        addContactToList(newContact);
-        saveContacts();
     }
 }
 
@@ -937,246 +1062,595 @@ void ChatWindow::onSearchTextChanged()
 {
     QString searchText = searchInput->text().trimmed();
     if (searchText.isEmpty()) {
+        // Clearing is cheap and should feel immediate
+        searchDebounceTimer->stop();
+        ++searchGeneration;
         clearHighlights();
-    } else {
-        searchMessages(searchText);
+        updateGlobalResults(QString());
+        return;
     }
+
+    // Whatever is running is already stale
+    ++searchGeneration;
+    ++globalSearchGeneration;
+    searchDebounceTimer->start();
+}
+
+void ChatWindow::onSearchDebounced()
+{
+    QString searchText = searchInput->text().trimmed();
+    searchMessages(searchText);
+    updateGlobalResults(searchText);
 }
 
 void ChatWindow::onClearSearch()
 {
     searchInput->clear();
-    clearHighlights();
 }
 
-void ChatWindow::addMessage(const QString &sender, const QString &content, bool isCurrentUser)
+ChatWindow::GlobalResult ChatWindow::makeGlobalResult(const SearchQuery &query, const QString &contact,
+                                                      const QString &messageId, const QString &text,
+                                                      const QString &title)
 {
-    if (selectedContact.isEmpty()) return;
+    GlobalResult result{contact, messageId, title, QString(), QVariantList()};
+    QVector<QPair<int, int>> ranges;
+    result.snippet = query.snippet(text, 120, &ranges);
+    for (const auto &range : std::as_const(ranges)) {
+        result.highlights.append(QPoint(range.first, range.second));
+    }
+    return result;
+}
 
-    Message msg(sender, content, QDateTime::currentDateTime(), isCurrentUser);
+void ChatWindow::addGlobalResult(const GlobalResult &result)
+{
+    QListWidgetItem *item = new QListWidgetItem(result.snippet);
+    item->setData(SearchResultDelegate::ContactRole, result.contact);
+    item->setData(SearchResultDelegate::MessageIdRole, result.messageId);
+    item->setData(SearchResultDelegate::TitleRole, result.title);
+    item->setData(SearchResultDelegate::SnippetRole, result.snippet);
+    item->setData(SearchResultDelegate::HighlightsRole, result.highlights);
+    globalResultsList->addItem(item);
+}
 
-    // Add to chat history
-    chatHistory[selectedContact].append(msg);
+void ChatWindow::updateGlobalResults(const QString &searchText)
+{
+    int generation = ++globalSearchGeneration;
+    if (searchText.isEmpty()) {
+        globalResultsList->clear();
+        globalResultsList->hide();
+        return;
+    }
 
-    // Add to UI immediately since this is for the selected contact
-    addMessageWidget(msg);
+    // Implicitly shared: the worker searches this copy while messages keep
+    // arriving, which detach the live index instead
+    MessageSearchIndex index = *store->searchIndex();
+    bool haveTrigrams = store->fragmentIndex() != nullptr;
+    TrigramIndex trigrams = haveTrigrams ? *store->fragmentIndex() : TrigramIndex();
+
+    searchPool.start([this, generation, index, haveTrigrams, trigrams, searchText]() {
+        if (globalSearchGeneration.load() != generation) return;
+
+        QElapsedTimer timer;
+        timer.start();
+        int total = 0;
+        SearchQuery query = SearchQuery::parse(searchText);
+        std::function<bool(const MessageSearchIndex::Hit &)> checkPhrases;
+        if (!query.phrases().isEmpty()) {
+            // The index knows words, not their order; each hit carries its text
+            checkPhrases = [&query](const MessageSearchIndex::Hit &hit) {
+                return query.matchesText(hit.text);
+            };
+        }
+        QVector<MessageSearchIndex::Hit> hits = index.search(query, GlobalResultsShown, &total, checkPhrases);
+        qint64 searchNs = timer.nsecsElapsed();
+
+        // Snippets only for the page shown, however many messages matched
+        timer.restart();
+        QVector<GlobalResult> results;
+        results.reserve(hits.size());
+        for (const MessageSearchIndex::Hit &hit : std::as_const(hits)) {
+            // A loaded index has no text until the history is in
+            if (hit.text.isEmpty()) continue;
+            results.append(makeGlobalResult(query, hit.contact, hit.messageId, hit.text,
+                                            QString("%1 · %2").arg(hit.contact, hit.timestamp.toString("dd MMM yyyy hh:mm"))));
+        }
+        qint64 snippetNs = timer.nsecsElapsed();
 
-    // Save to file
-    saveChats();
+        // Word fragments and misspellings fill whatever the word index left
+        if (haveTrigrams && query.hasText() && results.size() < GlobalResultsShown
+            && globalSearchGeneration.load() == generation) {
+            addTrigramResults(trigrams, query, &results);
+        }
 
-    qDebug() << "Message added and displayed for selected contact:" << selectedContact;
-}
+        QMetaObject::invokeMethod(this, [this, generation, searchText, results, total, searchNs, snippetNs]() {
+            if (generation != globalSearchGeneration.load()) return;
+            PerfMonitor &monitor = PerfMonitor::instance();
+            monitor.record(QStringLiteral("search.global"), searchNs);
+            monitor.record(QStringLiteral("search.snippets"), snippetNs);
 
+            globalResultsList->setUpdatesEnabled(false);
+            globalResultsList->clear();
+            for (const GlobalResult &result : results) {
+                addGlobalResult(result);
+            }
+            globalResultsList->setUpdatesEnabled(true);
+            globalResultsList->setVisible(globalResultsList->count() > 0);
 
-void ChatWindow::addMessageWidget(const Message &msg)
+            qDebug() << "Global search" << searchText << "matched" << total << "messages in" << searchNs / 1000000.0 << "ms";
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ChatWindow::addTrigramResults(const TrigramIndex &index, const SearchQuery &query, QVector<GlobalResult> *results)
 {
-    qDebug() << "=== addMessageWidget() called ===";
-    qDebug() << "Creating widget for message:" << msg.content.left(30) << "...";
-    qDebug() << "Message ID:" << msg.id;
-    qDebug() << "Current widget count:" << messageWidgets.size();
+    QSet<QString> listed;
+    for (const GlobalResult &result : std::as_const(*results)) {
+        listed.insert(result.messageId);
+    }
 
-    MessageWidget *messageWidget = new MessageWidget(msg, messagesWidget);
+    QVector<TrigramIndex::Hit> extra = index.searchFragments(query, GlobalResultsShown);
+    if (extra.size() + listed.size() < GlobalResultsShown) {
+        extra += index.searchApproximate(query, GlobalResultsShown);
+    }
 
-    // Store reference for later updates
-    messageWidgets[msg.id] = messageWidget;
+    for (const TrigramIndex::Hit &hit : std::as_const(extra)) {
+        if (results->size() >= GlobalResultsShown) break;
+        if (listed.contains(hit.messageId)) continue;
+        listed.insert(hit.messageId);
 
-    // Connect to edit/delete signals
-    connect(messageWidget, &MessageWidget::editRequested, this, &ChatWindow::onEditMessage);
-    connect(messageWidget, &MessageWidget::deleteRequested, this, &ChatWindow::onDeleteMessage);
+        results->append(makeGlobalResult(query, hit.contact, hit.messageId, hit.text,
+                                         QString("%1 · %2 · %3").arg(hit.contact, hit.timestamp.toString("dd MMM yyyy hh:mm"),
+                                                                     hit.distance > 0 ? QString("similar") : QString("partial word"))));
+    }
+}
 
-    // Insert before the stretch (should be last item)
-    int insertIndex = messagesLayout->count() - 1;
-    if (insertIndex < 0) insertIndex = 0;
+void ChatWindow::onGlobalResultActivated(QListWidgetItem *item)
+{
+    QString contact = item->data(SearchResultDelegate::ContactRole).toString();
+    QString messageId = item->data(SearchResultDelegate::MessageIdRole).toString();
 
-    messagesLayout->insertWidget(insertIndex, messageWidget);
+    // The contact may be hidden by the quick-filter
+    if (contactsModel->rowForName(contact) < 0) {
+        contactFilterInput->clear();
+    }
+    if (contact != selectedContact) {
+        selectContact(contact);
+    }
+    if (currentView && selectedContact == contact) {
+        currentView->revealMessage(messageId);
+    }
+}
 
-    qDebug() << "Widget inserted at index:" << insertIndex;
-    qDebug() << "New widget count:" << messageWidgets.size();
-    qDebug() << "Layout count:" << messagesLayout->count();
+void ChatWindow::onContactAdded(const Contact &contact)
+{
+    addContactToList(contact);
+    applyContactFilter();
+}
 
-    // Force widget to show
-    messageWidget->show();
-    messageWidget->update();
+void ChatWindow::onMessageAdded(const QString &contact, const Message &msg)
+{
+    contactsModel->setLastMessage(contact, msg.content);
+    contactsModel->touchContact(contact, msg.timestamp);
 
-    // Force layout update
-    messagesWidget->updateGeometry();
-    messagesScrollArea->updateGeometry();
+    // Check if this contact is currently selected
+    if (selectedContact == contact) {
+        // Contact is currently selected - queue the widget for the next batch
+        addMessageWidget(msg);
+        return;
+    }
 
-    // Auto-scroll to bottom with delay
-    QTimer::singleShot(50, [this]() {
-        QScrollBar *scrollBar = messagesScrollArea->verticalScrollBar();
-        scrollBar->setValue(scrollBar->maximum());
-        qDebug() << "Auto-scrolled to bottom";
-    });
+    // A warm page for another chat is kept current so switching back stays a swap
+    if (ConversationView *view = conversationView(contact)) {
+        view->appendMessage(msg);
+        scheduleWarmTrim();
+    }
+    if (!msg.isCurrentUser) {
+        // Contact is not selected - increment unread count and show notification
+        updateContactUnreadCount(contact, contactsModel->unreadCount(contact) + 1);
+        showNotificationPopup(contact, msg.content);
+    }
 }
 
-void ChatWindow::loadChatHistory(const QString &contact)
+void ChatWindow::onMessagesReceived(const MessageBatch &messages)
 {
-    qDebug() << "=== loadChatHistory() called for:" << contact << "===";
+    PerfScope scope(QStringLiteral("message.batch"));
 
-    // Clear existing message widgets first
-    clearMessagesDisplay();
+    // The contact list only needs each contact's last message, touched in
+    // batch order so the list ends up sorted as if they came one by one
+    QHash<QString, int> last;
+    for (int i = 0; i < messages.size(); ++i) {
+        last[messages[i].first] = i;
+    }
 
-    qDebug() << "Cleared existing widgets. Widget count now:" << messageWidgets.size();
+    QHash<QString, int> unread;
+    for (int i = 0; i < messages.size(); ++i) {
+        const QString &contact = messages[i].first;
+        const Message &msg = messages[i].second;
 
-    // Check if we have chat history for this contact
-    if (chatHistory.contains(contact)) {
-        const QList<Message> &messages = chatHistory[contact];
-        qDebug() << "Found" << messages.size() << "messages in history";
+        if (last.value(contact) == i) {
+            contactsModel->setLastMessage(contact, msg.content);
+            contactsModel->touchContact(contact, msg.timestamp);
+        }
 
-        // Add each message widget
-        for (int i = 0; i < messages.size(); ++i) {
-            const Message &msg = messages[i];
-            qDebug() << "Adding message" << i << ":" << msg.content.left(20) << "...";
+        if (selectedContact == contact) {
+            addMessageWidget(msg);
+            continue;
+        }
+        if (ConversationView *view = conversationView(contact)) {
+            view->appendMessage(msg);
+            scheduleWarmTrim();
+        }
+        if (!msg.isCurrentUser) {
+            ++unread[contact];
+            showNotificationPopup(contact, msg.content);
+        }
+    }
 
-            MessageWidget *messageWidget = new MessageWidget(msg, messagesWidget);
+    // One model update per contact rather than per message
+    for (auto it = unread.constBegin(); it != unread.constEnd(); ++it) {
+        updateContactUnreadCount(it.key(), contactsModel->unreadCount(it.key()) + it.value());
+    }
+}
 
-            // Store reference for later updates
-            messageWidgets[msg.id] = messageWidget;
+void ChatWindow::onMessageEdited(const QString &contact, const Message &msg)
+{
+    // Offsets of an active search are stale now
+    if (contact == selectedContact && !searchInput->text().trimmed().isEmpty()) {
+        searchMessages(searchInput->text().trimmed());
+    }
 
-            // Connect to edit/delete signals
-            connect(messageWidget, &MessageWidget::editRequested, this, &ChatWindow::onEditMessage);
-            connect(messageWidget, &MessageWidget::deleteRequested, this, &ChatWindow::onDeleteMessage);
+    // Update widget (setText drops the cached layout)
+    ConversationView *view = conversationView(contact);
+    MessageWidget *widget = view ? view->messageWidget(msg.id) : nullptr;
+    if (widget) {
+        widget->messageLabel->setText(msg.content);
+    }
+}
 
-            // Insert before the stretch (which should be the last item)
-            messagesLayout->insertWidget(messagesLayout->count() - 1, messageWidget);
+void ChatWindow::onMessageRemoved(const QString &contact, const QString &messageId)
+{
+    // Hits after the deleted message have moved up by one
+    if (contact == selectedContact && !searchInput->text().trimmed().isEmpty()) {
+        searchMessages(searchInput->text().trimmed());
+    }
 
-            qDebug() << "Widget added. Layout count now:" << messagesLayout->count();
+    // Remove widget from UI
+    if (ConversationView *view = conversationView(contact)) {
+        view->removeMessage(messageId);
+    }
+}
+
+void ChatWindow::onConversationReset(const QString &contact)
+{
+    // The page shows the history from before the merge, so it is built again
+    dropConversationView(contact);
+
+    QList<Message> history = store->messages(contact);
+    if (!history.isEmpty()) {
+        contactsModel->setLastMessage(contact, history.last().content);
+        contactsModel->touchContact(contact, history.last().timestamp);
+    }
+    if (contact == selectedContact) {
+        loadChatHistory(contact);
+        if (!searchInput->text().trimmed().isEmpty()) {
+            searchMessages(searchInput->text().trimmed());
         }
+    }
+}
+
+
+void ChatWindow::addMessageWidget(const Message &msg)
+{
+    PerfScope scope(QStringLiteral("message.queue"));
+
+    // Messages arriving within the same frame are inserted together with
+    // one layout pass and one scroll
+    if (currentView) {
+        currentView->appendMessage(msg);
+    }
+}
+
+void ChatWindow::loadChatHistory(const QString &contact)
+{
+    qDebug() << "=== loadChatHistory() called for:" << contact << "===";
+    PerfScope scope(QStringLiteral("chat.switch"));
+
+    // Highlights belong to the search of the page being left
+    clearHighlights();
+
+    recentConversations.removeAll(contact);
+    recentConversations.prepend(contact);
 
-        qDebug() << "Total message widgets created:" << messageWidgets.size();
+    // A warm page keeps its widgets and scroll offset, so switching back is a page swap
+    ConversationView *view = conversationViews.value(contact);
+    if (view) {
+        qDebug() << "Reusing warm view with" << view->messageCount() << "messages";
     } else {
-        qDebug() << "No chat history found for contact:" << contact;
+        view = new ConversationView(contact);
+        connect(view, &ConversationView::editRequested, this, &ChatWindow::onEditMessage);
+        connect(view, &ConversationView::deleteRequested, this, &ChatWindow::onDeleteMessage);
+        messagesStack->addWidget(view);
+        conversationViews.insert(contact, view);
+
+        // Check if we have chat history for this contact
+        if (store->hasConversation(contact)) {
+            QList<Message> history = store->messages(contact);
+            qDebug() << "Found" << history.size() << "messages in history";
+            view->setMessages(history);
+        } else {
+            qDebug() << "No chat history found for contact:" << contact;
+        }
     }
 
-    // Force update and scroll to bottom
-    messagesWidget->updateGeometry();
-    messagesScrollArea->updateGeometry();
+    currentView = view;
+    messagesStack->setCurrentWidget(view);
 
-    // Scroll to bottom with delay to ensure widgets are rendered
-    QTimer::singleShot(100, [this]() {
-        QScrollBar *scrollBar = messagesScrollArea->verticalScrollBar();
-        scrollBar->setValue(scrollBar->maximum());
-        qDebug() << "Scrolled to bottom. Max:" << scrollBar->maximum() << "Current:" << scrollBar->value();
-    });
+    trimWarmViews();
 }
 
+void ChatWindow::trimWarmViews()
+{
+    // How many conversations stay warm follows from the memory budget;
+    // the visible one is always kept
+    qint64 total = 0;
+    for (ConversationView *view : std::as_const(conversationViews)) {
+        total += view->estimatedMemory();
+    }
+
+    while (total > WarmViewBudgetBytes && recentConversations.size() > 1) {
+        QString coldest = recentConversations.last();
+        ConversationView *view = conversationViews.value(coldest);
+        total -= view ? view->estimatedMemory() : 0;
+        dropConversationView(coldest);
+    }
 
+    qDebug() << "Warm conversation views:" << conversationViews.size()
+             << "estimated bytes:" << total;
+}
 
-void ChatWindow::addContactToList(const Contact &contact)
+void ChatWindow::scheduleWarmTrim()
 {
-    QString displayText = QString("%1\n📞 %2").arg(contact.name, contact.phone);
-    contactsList->addItem(displayText);
-    contactPhones[contact.name] = contact.phone;
+    // Once per burst, after the pages have inserted what they were given
+    if (!warmTrimTimer->isActive()) {
+        warmTrimTimer->start();
+    }
 }
 
-void ChatWindow::clearMessagesDisplay()
+void ChatWindow::dropConversationView(const QString &contact)
 {
-    qDebug() << "=== clearMessagesDisplay() called ===";
-    qDebug() << "Current widget count:" << messageWidgets.size();
+    recentConversations.removeAll(contact);
 
-    // Remove all message widgets from layout and delete them
-    QList<QString> keysToRemove;
-    for (auto it = messageWidgets.begin(); it != messageWidgets.end(); ++it) {
-        MessageWidget *widget = it.value();
-        messagesLayout->removeWidget(widget);
-        widget->deleteLater();
-        keysToRemove.append(it.key());
+    ConversationView *view = conversationViews.take(contact);
+    if (!view) return;
+
+    if (view == currentView) {
+        clearMessagesDisplay();
     }
+    messagesStack->removeWidget(view);
+    view->deleteLater();
+}
 
-    // Clear the map
-    for (const QString &key : keysToRemove) {
-        messageWidgets.remove(key);
+void ChatWindow::addContactToList(const Contact &contact)
+{
+    contactsModel->addContact(contact);
+    contactSearchIndex->addContact(contact);
+}
+
+void ChatWindow::onContactFilterChanged()
+{
+    applyContactFilter();
+}
+
+void ChatWindow::applyContactFilter()
+{
+    QString filterText = contactFilterInput->text().trimmed();
+    if (filterText.isEmpty()) {
+        contactsModel->clearFilter();
+        return;
     }
 
-    qDebug() << "Cleared all widgets. New count:" << messageWidgets.size();
-    qDebug() << "Layout count after clear:" << messagesLayout->count();
+    QElapsedTimer timer;
+    timer.start();
+
+    bool fuzzy = false;
+    QVector<QString> matches = contactSearchIndex->search(filterText, &fuzzy);
+    contactsModel->setFilter(matches);
+
+    if (timer.elapsed() > 16) {
+        qDebug() << "Contact filter" << filterText << "took" << timer.elapsed() << "ms for"
+                 << matches.size() << "matches" << (fuzzy ? "(fuzzy)" : "");
+    }
 }
 
-void ChatWindow::searchMessages(const QString &searchText)
+void ChatWindow::clearMessagesDisplay()
 {
+    // Leaves the page alive in the warm set; dropConversationView() frees it
     clearHighlights();
+    currentView = nullptr;
+    messagesStack->setCurrentWidget(emptyChatPage);
+}
 
-    if (searchText.isEmpty() || selectedContact.isEmpty()) return;
+void ChatWindow::searchMessages(const QString &searchText)
+{
+    if (searchText.isEmpty() || selectedContact.isEmpty()) {
+        ++searchGeneration;
+        clearHighlights();
+        return;
+    }
 
-    highlightSearchResults(searchText);
+    startSearch(searchText);
 }
 
-void ChatWindow::highlightSearchResults(const QString &searchText)
+void ChatWindow::startSearch(const QString &searchText)
 {
-    if (searchText.isEmpty()) return;
+    int generation = ++searchGeneration;
+    QString contact = selectedContact;
+    // Implicitly shared: the worker reads a snapshot while the GUI keeps appending
+    QList<Message> messages = store->messages(contact);
+
+    searchPool.start([this, generation, contact, messages, searchText]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        // Plan: the date bounds pick a slice of the history by binary search,
+        // the sender is compared next, and text only for what is left
+        SearchQuery query = SearchQuery::parse(searchText);
+        QPair<int, int> range(0, 0);
+        if (query.matchesContact(contact)) {
+            range = query.timeRange(messages);
+        }
+
+        // Same matches as QString::contains(..., Qt::CaseInsensitive), vectorized.
+        // Simple case folding keeps lengths, so a match spans the pattern's length.
+        std::vector<FoldedStringMatcher> matchers;
+        for (const QString &term : query.textTerms()) {
+            matchers.emplace_back(term);
+        }
 
-    for (auto it = messageWidgets.begin(); it != messageWidgets.end(); ++it) {
-        MessageWidget *widget = it.value();
-        const Message &msg = widget->getMessage();
+        QVector<SearchHitNavigator::Hit> hits;
+        QVector<SearchHitNavigator::Hit> messageHits;
+        QSet<QString> matches;
+        for (int i = range.first; i < range.second; ++i) {
+            // Give up as soon as a newer search has started
+            if (((i - range.first) & 255) == 0 && searchGeneration.load() != generation) return;
+            const Message &msg = messages[i];
+            if (!query.matchesSender(msg)) continue;
+
+            messageHits.clear();
+            bool matched = true;
+            for (const FoldedStringMatcher &matcher : matchers) {
+                const int matchLength = matcher.pattern().size();
+                int at = matcher.indexIn(msg.content);
+                if (at < 0) {
+                    matched = false;
+                    break;
+                }
+                for (; at >= 0; at = matcher.indexIn(msg.content, at + matchLength)) {
+                    messageHits.append(SearchHitNavigator::Hit{i, msg.id, at, matchLength});
+                }
+            }
+            if (!matched) continue;
 
-        if (msg.content.contains(searchText, Qt::CaseInsensitive)) {
+            if (messageHits.isEmpty()) {
+                // Filters only: the whole message is the hit
+                messageHits.append(SearchHitNavigator::Hit{i, msg.id, 0, 0});
+            }
+            std::sort(messageHits.begin(), messageHits.end(),
+                      [](const SearchHitNavigator::Hit &a, const SearchHitNavigator::Hit &b) {
+                          return a.start < b.start;
+                      });
+            hits += messageHits;
+            matches.insert(msg.id);
+        }
+        qint64 scanNs = timer.nsecsElapsed();
+
+        QMetaObject::invokeMethod(this, [this, generation, contact, hits, matches, scanNs]() {
+            if (generation != searchGeneration.load() || contact != selectedContact) return;
+            PerfMonitor::instance().record(QStringLiteral("search.scan"), scanNs);
+            highlightSearchResults(matches);
+            // The newest match is nearest the bottom, where the chat is shown;
+            // it is revealed now so Enter moves on to the one before it
+            searchHits.setHits(hits, int(hits.size()) - 1);
+            showSearchHit(searchHits.current());
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ChatWindow::highlightSearchResults(const QSet<QString> &messageIds)
+{
+    if (!currentView) return;
+    PerfScope scope(QStringLiteral("search.highlight"));
+
+    // Only bubbles whose state changes are restyled, all in one repaint
+    currentView->setUpdatesEnabled(false);
+    for (const QString &id : std::as_const(highlightedIds)) {
+        if (!messageIds.contains(id)) {
+            if (MessageWidget *widget = currentView->messageWidget(id)) {
+                widget->setHighlighted(false);
+            }
+        }
+    }
+    for (const QString &id : messageIds) {
+        if (MessageWidget *widget = currentView->messageWidget(id)) {
             widget->setHighlighted(true);
         }
     }
+    currentView->setUpdatesEnabled(true);
+
+    highlightedIds = messageIds;
 }
 
 void ChatWindow::clearHighlights()
 {
-    for (auto it = messageWidgets.begin(); it != messageWidgets.end(); ++it) {
-        MessageWidget *widget = it.value();
-        widget->setHighlighted(false);
+    if (currentView) {
+        for (const QString &id : std::as_const(highlightedIds)) {
+            if (MessageWidget *widget = currentView->messageWidget(id)) {
+                widget->setHighlighted(false);
+            }
+        }
     }
+    highlightedIds.clear();
+    searchHits.clear();
+    updateHitControls();
 }
 
-void ChatWindow::saveContacts()
+void ChatWindow::updateHitControls()
 {
-    QString filePath = getContactsFilePath();
-    QJsonArray contactsArray;
+    bool searching = !searchInput->text().trimmed().isEmpty();
+    hitCountLabel->setVisible(searching);
+    hitCountLabel->setText(searchHits.positionText());
+    previousHitButton->setEnabled(searchHits.count() > 1);
+    nextHitButton->setEnabled(searchHits.count() > 1);
+}
 
-    for (const Contact &contact : contactsList_data) {
-        contactsArray.append(contact.toJson());
+void ChatWindow::showSearchHit(const SearchHitNavigator::Hit *hit)
+{
+    updateHitControls();
+    if (hit && currentView) {
+        currentView->revealMessage(hit->messageId);
     }
+}
 
-    QJsonDocument doc(contactsArray);
+void ChatWindow::onPreviousHit()
+{
+    showSearchHit(searchHits.previous());
+}
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(doc.toJson());
-    }
+void ChatWindow::onNextHit()
+{
+    showSearchHit(searchHits.next());
 }
 
 void ChatWindow::onEditMessage(const QString &messageId)
 {
     if (selectedContact.isEmpty()) return;
 
-    // Find the message in chat history
-    QList<Message> &messages = chatHistory[selectedContact];
-    for (int i = 0; i < messages.size(); ++i) {
-        if (messages[i].id == messageId) {
-            // Get new text from user
-            bool ok;
-            QString newText = QInputDialog::getText(this, "Edit Message",
-                                                    "Edit your message:",
-                                                    QLineEdit::Normal,
-                                                    messages[i].content, &ok);
-            if (ok && !newText.trimmed().isEmpty()) {
-                // Update message
-                messages[i].content = newText.trimmed();
-
-                // Update widget
-                MessageWidget *widget = messageWidgets[messageId];
-                widget->messageLabel->setText(newText.trimmed());
-
-                // Save changes
-                saveChats();
-            }
-            break;
-        }
+    const Message *msg = store->findMessage(selectedContact, messageId);
+    if (!msg) return;
+    // Messages keep arriving while the dialog is open
+    QString contact = selectedContact;
+    QString currentText = msg->content;
+
+    // Get new text from user
+    bool ok;
+    QString newText = QInputDialog::getText(this, "Edit Message",
+                                            "Edit your message:",
+                                            QLineEdit::Normal,
+                                            currentText, &ok);
+    if (ok && !newText.trimmed().isEmpty()) {
+        messageService->editMessage(contact, messageId, newText.trimmed());
     }
 }
+
 void ChatWindow::onContactRightClicked(const QPoint &position)
 {
-    QListWidgetItem *item = contactsList->itemAt(position);
-    if (!item) return;
+    QModelIndex index = contactsList->indexAt(position);
+    if (!index.isValid()) return;
 
-    // Extract contact name from the display text
-    rightClickedContact = item->text().split('\n')[0];
+    // Renames and deletes re-key chat history, so they wait for it to load
+    if (!messageService->isHistoryLoaded()) return;
+
+    rightClickedContact = index.data(ContactListModel::NameRole).toString();
 
     // Show context menu at cursor position
     contactContextMenu->exec(contactsList->mapToGlobal(position));
@@ -1187,46 +1661,37 @@ void ChatWindow::onEditContact()
     if (rightClickedContact.isEmpty()) return;
 
     // Find the contact in our data
-    Contact *contactToEdit = nullptr;
-    int contactIndex = -1;
-
-    for (int i = 0; i < contactsList_data.size(); ++i) {
-        if (contactsList_data[i].name == rightClickedContact) {
-            contactToEdit = &contactsList_data[i];
-            contactIndex = i;
-            break;
-        }
-    }
-
-    if (!contactToEdit) return;
+    int contactIndex = store->contactIndex(rightClickedContact);
+    if (contactIndex < 0) return;
+    const Contact contactToEdit = store->contacts().at(contactIndex);
 
     // Create edit dialog
     AddContactDialog dialog(this);
     dialog.setWindowTitle("Edit Contact");
-    dialog.setContactData(contactToEdit->name, contactToEdit->phone);
+    dialog.setContactData(contactToEdit.name, contactToEdit.phone);
 
     if (dialog.exec() == QDialog::Accepted) {
         Contact updatedContact = dialog.getContact();
-
-        // Check if new name conflicts with existing contacts (except current one)
-        for (int i = 0; i < contactsList_data.size(); ++i) {
-            if (i != contactIndex &&
-                contactsList_data[i].name.toLower() == updatedContact.name.toLower()) {
-                QMessageBox::warning(this, "Duplicate Contact",
-                                     "A contact with this name already exists!");
-                return;
-            }
+        updatedContact.id = contactToEdit.id;
+        QString oldName = contactToEdit.name;
+
+        // Refused if the new name conflicts with another contact; the
+        // history and search indexes follow a rename
+        if (!messageService->updateContact(oldName, updatedContact)) {
+            QMessageBox::warning(this, "Duplicate Contact",
+                                 "A contact with this name already exists!");
+            return;
         }
 
-        QString oldName = contactToEdit->name;
-
-        // Update contact data
-        *contactToEdit = updatedContact;
-
-        // Update chat history if contact name changed
-        if (oldName != updatedContact.name && chatHistory.contains(oldName)) {
-            chatHistory[updatedContact.name] = chatHistory[oldName];
-            chatHistory.remove(oldName);
+        // Keep a warm page under the new name
+        if (oldName != updatedContact.name && conversationViews.contains(oldName)) {
+            ConversationView *view = conversationViews.take(oldName);
+            view->setContactName(updatedContact.name);
+            conversationViews.insert(updatedContact.name, view);
+            int recentIndex = recentConversations.indexOf(oldName);
+            if (recentIndex >= 0) {
+                recentConversations[recentIndex] = updatedContact.name;
+            }
         }
 
         // Update selected contact if it's the one being edited
@@ -1235,10 +1700,10 @@ void ChatWindow::onEditContact()
             chatHeader->setText(QString("💬 Chat with %1").arg(selectedContact));
         }
 
-        // Refresh contacts list
-        refreshContactsList();
-        saveContacts();
-        saveChats();
+        // Update the contact's row in place
+        contactsModel->updateContact(oldName, updatedContact);
+        contactSearchIndex->addContact(updatedContact);
+        applyContactFilter();
 
         QMessageBox::information(this, "Success", "Contact updated successfully!");
     }
@@ -1255,19 +1720,14 @@ void ChatWindow::onDeleteContact()
         QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
-        // Remove from contacts list data
-        for (int i = 0; i < contactsList_data.size(); ++i) {
-            if (contactsList_data[i].name == rightClickedContact) {
-                contactsList_data.removeAt(i);
-                break;
-            }
+        int contactIndex = store->contactIndex(rightClickedContact);
+        if (contactIndex >= 0) {
+            contactSearchIndex->removeContact(store->contacts().at(contactIndex).id);
         }
 
-        // Remove from phone mapping
-        contactPhones.remove(rightClickedContact);
-
-        // Remove chat history
-        chatHistory.remove(rightClickedContact);
+        // Remove the contact with its chat history, then its page
+        messageService->removeContact(rightClickedContact);
+        dropConversationView(rightClickedContact);
 
         // Clear chat if this contact was selected
         if (selectedContact == rightClickedContact) {
@@ -1285,15 +1745,14 @@ void ChatWindow::onDeleteContact()
                 "}"
                 );
             searchFrame->hide();
+            globalResultsList->hide();
             messageInput->setEnabled(false);
             sendButton->setEnabled(false);
-            clearMessagesDisplay();
         }
 
-        // Refresh contacts list
-        refreshContactsList();
-        saveContacts();
-        saveChats();
+        // Remove the contact's row
+        contactsModel->removeContact(rightClickedContact);
+        applyContactFilter();
 
         QMessageBox::information(this, "Success", "Contact deleted successfully!");
     }
@@ -1302,93 +1761,21 @@ void ChatWindow::onDeleteContact()
 // 3. ADD THIS NEW HELPER METHOD:
 void ChatWindow::refreshContactsList()
 {
-    contactsList->clear();
-    contactPhones.clear();
-
-    for (const Contact &contact : contactsList_data) {
-        addContactToList(contact);
-    }
+    contactsModel->setContacts(store->contacts());
+    contactSearchIndex->setContacts(store->contacts());
+    applyContactFilter();
 }
 
 void ChatWindow::showNotificationPopup(const QString &contactName, const QString &message)
 {
-    QString title = QString("%1 sent a message").arg(contactName);
-    QString body = message.length() > 50 ? message.left(47) + "..." : message;
-
-    // System tray notification
-    if (trayIcon && trayIcon->isVisible()) {
-        trayIcon->showMessage(title, body, QSystemTrayIcon::Information, 3000);
-    }
-
-    // Alternative: Custom popup dialog
-    QDialog *popup = new QDialog(this);
-    popup->setWindowTitle("New Message");
-    popup->setWindowFlags(Qt::Tool | Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint);
-    popup->setAttribute(Qt::WA_DeleteOnClose);
-    popup->setFixedSize(300, 100);
-
-    // Position at bottom-right corner
-    QScreen *screen = QApplication::primaryScreen();
-    QRect screenGeometry = screen->availableGeometry();
-    popup->move(screenGeometry.width() - 320, screenGeometry.height() - 120);
-
-    QVBoxLayout *layout = new QVBoxLayout(popup);
-    layout->setContentsMargins(15, 10, 15, 10);
-
-    QLabel *titleLabel = new QLabel(title);
-    titleLabel->setStyleSheet("font-weight: bold; color: #667eea; font-size: 14px;");
-
-    QLabel *messageLabel = new QLabel(body);
-    messageLabel->setWordWrap(true);
-    messageLabel->setStyleSheet("color: #495057; font-size: 12px;");
-
-    layout->addWidget(titleLabel);
-    layout->addWidget(messageLabel);
-
-    popup->setStyleSheet(
-        "QDialog {"
-        "    background: white;"
-        "    border: 2px solid #667eea;"
-        "    border-radius: 10px;"
-        "}"
-        );
-
-    popup->show();
-
-    // Auto-close after 3 seconds
-    QTimer::singleShot(3000, popup, &QDialog::close);
+    // Bursts are aggregated into one reused popup and rate-limited tray balloons
+    notificationCenter->notify(contactName, message);
 }
 
 void ChatWindow::updateContactUnreadCount(const QString &contactName, int count)
 {
-    unreadCounts[contactName] = count;
-
-    // Update contact list display
-    for (int i = 0; i < contactsList->count(); ++i) {
-        QListWidgetItem *item = contactsList->item(i);
-        QString itemText = item->text();
-        QString itemContactName = itemText.split('\n')[0];
-        // Remove existing unread count from display name if present
-        if (itemContactName.contains(" (") && itemContactName.endsWith(")")) {
-            itemContactName = itemContactName.split(" (")[0];
-        }
-
-        if (itemContactName == contactName) {
-            QString phone = contactPhones[contactName];
-            QString displayText;
-
-            if (count > 0) {
-                displayText = QString("%1 (%2)\n📞 %3").arg(contactName).arg(count).arg(phone);
-                item->setBackground(QBrush(QColor(255, 240, 240))); // Light red background
-            } else {
-                displayText = QString("%1\n📞 %2").arg(contactName, phone);
-                item->setBackground(QBrush()); // Clear background
-            }
-
-            item->setText(displayText);
-            break;
-        }
-    }
+    // Single-row update through the model's name-to-row hash
+    contactsModel->setUnreadCount(contactName, count);
 }
 
 void ChatWindow::onSearchEnterPressed()
@@ -1396,14 +1783,19 @@ void ChatWindow::onSearchEnterPressed()
     QString searchText = searchInput->text().trimmed();
     if (searchText.isEmpty() || selectedContact.isEmpty()) return;
 
-    // Find the first highlighted message widget
-    for (auto it = messageWidgets.begin(); it != messageWidgets.end(); ++it) {
-        MessageWidget *widget = it.value();
-        if (widget->getHighlighted()) {
-            // Scroll to make this widget visible
-            messagesScrollArea->ensureWidgetVisible(widget);
-            break;
-        }
+    // Typing hasn't paused yet: search now rather than stepping stale hits;
+    // the results reveal the newest match
+    if (searchDebounceTimer->isActive()) {
+        searchDebounceTimer->stop();
+        onSearchDebounced();
+        return;
+    }
+
+    // Enter walks back through older matches, Shift+Enter forward
+    if (QApplication::keyboardModifiers() & Qt::ShiftModifier) {
+        onNextHit();
+    } else {
+        onPreviousHit();
     }
 }
 
@@ -1416,230 +1808,191 @@ void ChatWindow::onDeleteMessage(const QString &messageId)
         QMessageBox::Yes | QMessageBox::No);
 
     if (reply == QMessageBox::Yes) {
-        // Remove from chat history
-        QList<Message> &messages = chatHistory[selectedContact];
-        for (int i = 0; i < messages.size(); ++i) {
-            if (messages[i].id == messageId) {
-                messages.removeAt(i);
-                break;
-            }
-        }
-
-        // Remove widget from UI
-        MessageWidget *widget = messageWidgets[messageId];
-        messagesLayout->removeWidget(widget);
-        messageWidgets.remove(messageId);
-        widget->deleteLater();
-
-        // Save changes
-        saveChats();
+        messageService->deleteMessage(selectedContact, messageId);
     }
 }
 
-void ChatWindow::setupAutoMessages()
+void ChatWindow::receiveMessage(const QString &contactName, const QString &content)
 {
-    autoMessageTimer = new QTimer(this);
-    autoMessageTimer->setSingleShot(false);
-
-    // Set interval between 15-30 seconds (15000-30000 milliseconds)
-    int interval = 15000 + QRandomGenerator::global()->bounded(15000);
-    autoMessageTimer->setInterval(interval);
-
-    connect(autoMessageTimer, &QTimer::timeout, this, &ChatWindow::sendAutoMessage);
-
-    // Start the timer after a short delay
-    QTimer::singleShot(3000, [this]() {
-        if (!contactsList_data.isEmpty()) {
-            autoMessageTimer->start();
-        }
-    });
+    messageService->receiveMessage(contactName, content);
 }
 
-void ChatWindow::sendAutoMessage()
+QStringList ChatWindow::contactNames() const
 {
-    if (contactsList_data.isEmpty()) {
-        return;
-    }
-
-    // Pick a random contact
-    int randomIndex = QRandomGenerator::global()->bounded(contactsList_data.size());
-    QString contactName = contactsList_data[randomIndex].name;
-
-    // Array of automatic messages
-    QStringList autoMessages = {
-        "Hey! How's your day going? 😊",
-        "Just wanted to say hi! 👋",
-        "Hope you're doing well! 💙",
-        "What's up? Haven't heard from you in a while 🤔",
-        "Good morning! ☀️",
-        "Good evening! 🌙",
-        "How are things on your end? 🤗",
-        "Just checking in! 📱",
-        "Hope you're having a great day! ✨",
-        "Missing our chats! 💭",
-        "Any exciting plans today? 🎉",
-        "Hope work is going well! 💼",
-        "Thinking about you! 💝",
-        "How's the weather there? 🌤️",
-        "Just wanted to catch up! ☕",
-        "Hope you're staying safe! 🛡️",
-        "Any good news to share? 📰",
-        "What's keeping you busy these days? ⏰",
-        "Hope you're getting enough rest! 😴",
-        "Sending good vibes your way! ✨"
-    };
-
-    QString randomMessage = autoMessages[QRandomGenerator::global()->bounded(autoMessages.size())];
-
-    // Create the auto message
-    Message autoMsg(contactName, randomMessage, QDateTime::currentDateTime(), false);
-
-    qDebug() << "=== sendAutoMessage() ===";
-    qDebug() << "Auto message from:" << contactName;
-    qDebug() << "Message:" << randomMessage;
-    qDebug() << "Selected contact:" << selectedContact;
-
-    // Add to chat history
-    chatHistory[contactName].append(autoMsg);
-    qDebug() << "Added to chat history. New size:" << chatHistory[contactName].size();
-
-    // Check if this contact is currently selected
-    if (selectedContact == contactName) {
-        // Contact is currently selected - add message widget immediately
-        qDebug() << "Contact is selected - adding widget immediately";
-        addMessageWidget(autoMsg);
-    } else {
-        // Contact is not selected - increment unread count and show notification
-        qDebug() << "Contact not selected - updating unread count";
-        unreadCounts[contactName] = unreadCounts.value(contactName, 0) + 1;
-        updateContactUnreadCount(contactName, unreadCounts[contactName]);
-        showNotificationPopup(contactName, randomMessage);
-    }
+    return store->contactNames();
+}
 
-    // Save the chat
-    saveChats();
+bool ChatWindow::isDataReady() const
+{
+    return messageService->isHistoryLoaded();
+}
 
-    // Set next random interval
-    int nextInterval = 60000 + QRandomGenerator::global()->bounded(7000);
-    autoMessageTimer->setInterval(nextInterval);
+void ChatWindow::selectContact(const QString &contactName)
+{
+    int row = contactsModel->rowForName(contactName);
+    if (row < 0) return;
 
-    qDebug() << "Auto message processing completed";
+    contactsList->setCurrentIndex(contactsModel->index(row));
+    onContactSelected();
 }
 
 void ChatWindow::refreshCurrentChat()
 {
     if (!selectedContact.isEmpty()) {
+        // Rebuild the page from history rather than reusing the warm one
+        dropConversationView(selectedContact);
         loadChatHistory(selectedContact);
     }
 }
 
-void ChatWindow::loadContacts()
+bool ChatWindow::event(QEvent *event)
 {
-    QString filePath = getContactsFilePath();
-    QFile file(filePath);
-
-    if (!file.exists()) {
-        loadSampleContacts();
-        return;
+    // The window repaints every dirty child while handling UpdateRequest,
+    // so this covers the whole paint pass of a frame
+    if (event->type() == QEvent::UpdateRequest) {
+        bool handled;
+        {
+            PerfScope scope(QStringLiteral("ui.paint"));
+            handled = QWidget::event(event);
+        }
+        if (!firstPaintLogged) {
+            firstPaintLogged = true;
+            PerfMonitor::instance().record(QStringLiteral("startup.firstPaint"), startupTimer.nsecsElapsed());
+            qDebug() << "Time to first paint:" << startupTimer.elapsed() << "ms";
+        }
+        return handled;
     }
+    return QWidget::event(event);
+}
 
-    if (file.open(QIODevice::ReadOnly)) {
-        QByteArray data = file.readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        QJsonArray contactsArray = doc.array();
-
-        contactsList_data.clear();
-        contactsList->clear();
-        contactPhones.clear();
+void ChatWindow::dumpPerfData()
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    QString filePath = QDir(dataDir).filePath(
+        QString("perf_%1_%2.txt").arg(currentUser, QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss")));
 
-        for (const QJsonValue &value : contactsArray) {
-            Contact contact = Contact::fromJson(value.toObject());
-            contactsList_data.append(contact);
-            addContactToList(contact);
-        }
+    if (PerfMonitor::instance().dumpToFile(filePath)) {
+        qDebug() << "Timings written to" << filePath;
     } else {
-        loadSampleContacts();
+        qDebug() << "Could not write timings to" << filePath;
     }
 }
 
-void ChatWindow::saveChats()
+void ChatWindow::startDataLoad(ChatDataLoader *prefetched)
 {
-    QString filePath = getChatsFilePath();
-    QJsonObject chatsObject;
+    // Nothing can be added or searched until the contacts are in
+    addContactButton->setEnabled(false);
+    contactFilterInput->setEnabled(false);
 
-    for (auto it = chatHistory.begin(); it != chatHistory.end(); ++it) {
-        const QString &contact = it.key();
-        const QList<Message> &messages = it.value();
-
-        QJsonArray messagesArray;
-        for (const Message &msg : messages) {
-            messagesArray.append(msg.toJson());
-        }
-
-        chatsObject[contact] = messagesArray;
+    if (prefetched && prefetched->user() == currentUser) {
+        dataLoader = prefetched;
+        dataLoader->setParent(nullptr);
+    } else {
+        if (prefetched) prefetched->discard();
+        dataLoader = new ChatDataLoader(currentUser);
     }
 
-    QJsonDocument doc(chatsObject);
+    connect(dataLoader, &ChatDataLoader::contactsLoaded, this, &ChatWindow::onContactsLoaded);
+    connect(dataLoader, &ChatDataLoader::indexLoaded, this, &ChatWindow::onIndexLoaded);
+    connect(dataLoader, &ChatDataLoader::chatsLoaded, this, &ChatWindow::onChatsLoaded);
+    connect(dataLoader, &ChatDataLoader::progress, this, &ChatWindow::onLoadProgress);
+    connect(dataLoader, &ChatDataLoader::finished, this, &ChatWindow::onDataLoaded);
+    dataLoader->start();
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(doc.toJson());
-    }
+    // Whatever the prefetch already read is applied after the first paint
+    QTimer::singleShot(0, dataLoader, &ChatDataLoader::deliverBuffered);
 }
 
-void ChatWindow::loadChats()
+void ChatWindow::onContactsLoaded(const QList<Contact> &contacts, bool fromFile)
 {
-    QString filePath = getChatsFilePath();
-    QFile file(filePath);
+    messageService->setContactsLoaded();
 
-    if (!file.exists()) {
-        return; // No chat history exists yet
+    if (fromFile) {
+        store->setContacts(contacts);
+        // One model reset rather than a row insert per contact
+        contactsModel->setContacts(store->contacts());
+        contactSearchIndex->setContacts(store->contacts());
+    } else {
+        loadSampleContacts();
     }
 
-    if (file.open(QIODevice::ReadOnly)) {
-        QByteArray data = file.readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        QJsonObject chatsObject = doc.object();
+    addContactButton->setEnabled(true);
+    contactFilterInput->setEnabled(true);
+    loadingLabel->setText("⏳ Loading chats...");
 
-        chatHistory.clear();
+    // Connected once the contact list is in place, since a delivery from
+    // someone new adds them to it
+    QString server = ChatClient::serverFromEnvironment();
+    if (!server.isEmpty()) {
+        qDebug() << "Connecting to chat server" << server;
+        messageService->connectToServer(server);
+    }
 
-        for (auto it = chatsObject.begin(); it != chatsObject.end(); ++it) {
-            const QString &contact = it.key();
-            QJsonArray messagesArray = it.value().toArray();
+    PerfMonitor::instance().record(QStringLiteral("startup.contacts"), startupTimer.nsecsElapsed());
+    qDebug() << "Contacts ready after" << startupTimer.elapsed() << "ms:" << store->contacts().size() << "contacts";
+}
 
-            QList<Message> messages;
-            for (const QJsonValue &value : messagesArray) {
-                messages.append(Message::fromJson(value.toObject()));
-            }
+void ChatWindow::onIndexLoaded(MessageSearchIndex *index, const SearchIndexStore::State &state)
+{
+    // Live messages the chats file does not have yet are carried over
+    store->adoptSearchIndex(index, state);
+
+    PerfMonitor::instance().record(QStringLiteral("startup.searchIndex"), startupTimer.nsecsElapsed());
+    qDebug() << "Search index ready after" << startupTimer.elapsed() << "ms:"
+             << store->searchIndex()->documentCount() << "messages";
+}
 
-            chatHistory[contact] = messages;
+void ChatWindow::onChatsLoaded(const ConversationBatch &conversations)
+{
+    for (const auto &conversation : conversations) {
+        const QString &contact = conversation.first;
+        // Anything already here arrived while loading and is newer
+        bool hadLiveMessages = !store->mergeLoadedConversation(contact, conversation.second);
+        QList<Message> history = store->messages(contact);
+        if (history.isEmpty()) continue;
+
+        contactsModel->setLastMessage(contact, history.last().content);
+        // Batches come oldest first, so each move to the top keeps recency order
+        if (!hadLiveMessages) {
+            contactsModel->touchContact(contact, history.last().timestamp);
+        }
+
+        if (contact == selectedContact) {
+            refreshCurrentChat();
+        } else {
+            dropConversationView(contact);
         }
     }
 }
 
-QString ChatWindow::getContactsFilePath() const
+void ChatWindow::onLoadProgress(int conversationsLoaded, int conversationsTotal)
 {
-    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(dataDir);
-    // Make contacts file user-specific
-    return QDir(dataDir).filePath(QString("contacts_%1.json").arg(currentUser));
+    loadingLabel->setText(QString("⏳ Loading chats... %1 of %2")
+                              .arg(conversationsLoaded).arg(conversationsTotal));
 }
 
-QString ChatWindow::getChatsFilePath() const
+void ChatWindow::onDataLoaded(qint64 loaderMs)
 {
-    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    QDir().mkpath(dataDir);
-    // Make chat file user-specific
-    return QDir(dataDir).filePath(QString("chats_%1.json").arg(currentUser));
+    // Saves held back during the load go out now
+    messageService->setHistoryLoaded();
+    loadingLabel->hide();
+
+    messageService->startAutoMessages();
+
+    PerfMonitor::instance().record(QStringLiteral("startup.interactive"), startupTimer.nsecsElapsed());
+    qDebug() << "Time to interactive:" << startupTimer.elapsed() << "ms (loader" << loaderMs << "ms,"
+             << store->conversations().size() << "conversations)";
+    emit dataReady();
 }
 
 void ChatWindow::loadSampleContacts() {
     qDebug() << "=== loadSampleContacts() called at" << QDateTime::currentDateTime().toString() << "===";
 
     // Clear existing data
-    contactsList_data.clear();
-    contactsList->clear();
-    contactPhones.clear();
+    store->setContacts(QList<Contact>());
+    contactsModel->setContacts(store->contacts());
+    contactSearchIndex->clear();
     qDebug() << "Cleared existing contacts.";
 
     // Define sample contacts
@@ -1653,7 +2006,7 @@ void ChatWindow::loadSampleContacts() {
 
     // Add sample contacts to both data list and UI
     for (const Contact &contact : sampleContacts) {
-        contactsList_data.append(contact);
+        store->addContact(contact);
         addContactToList(contact);
         qDebug() << "Added contact:" << contact.name << contact.phone;
     }
@@ -1665,12 +2018,12 @@ void ChatWindow::loadSampleContacts() {
     qDebug() << "Forced UI update for contactsList.";
 
     // Log final state
-    qDebug() << "Final contactsList_data size:" << contactsList_data.size();
-    qDebug() << "Final contactsList widget count:" << contactsList->count();
+    qDebug() << "Final contacts size:" << store->contacts().size();
+    qDebug() << "Final contactsList row count:" << contactsModel->rowCount();
     qDebug() << "ContactsList geometry:" << contactsList->geometry();
     qDebug() << "ContactsFrame geometry:" << contactsFrame->geometry();
 
     // Save contacts to file
-    saveContacts();
+    messageService->saveContacts();
     qDebug() << "Saved contacts to file.";
 }
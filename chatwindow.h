@@ -6,7 +6,7 @@
 #include <QSplitter>
 #include <QFrame>
 #include <QLabel>
-#include <QListWidget>
+#include <QListView>
 #include <QPushButton>
 #include <QLineEdit>
 #include <QScrollArea>
@@ -23,72 +23,55 @@
 #include <QUuid>
 #include <QAction>
 #include "UserManager.h"
+#include "message.h"
+#include "contact.h"
+#include "searchhitnavigator.h"
+#include "searchindexstore.h"
 #include <QDialog>
 #include <QSystemTrayIcon>
 #include <QApplication>
+#include <QStackedWidget>
+#include <QHash>
+#include <QPair>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QVariant>
+#include <QThreadPool>
+#include <atomic>
 
-// Message struct for storing individual messages
-struct Message {
-    QString id;           // Unique identifier for each message
-    QString sender;
-    QString content;
-    QDateTime timestamp;
-    bool isCurrentUser;
-
-    Message() {
-        id = QUuid::createUuid().toString();
-    }
-
-    Message(const QString &s, const QString &c, const QDateTime &t, bool isCurrent)
-        : sender(s), content(c), timestamp(t), isCurrentUser(isCurrent) {
-        id = QUuid::createUuid().toString();
-    }
-
-    // Methods for JSON serialization
-    QJsonObject toJson() const {
-        QJsonObject obj;
-        obj["id"] = id;
-        obj["sender"] = sender;
-        obj["content"] = content;
-        obj["timestamp"] = timestamp.toString(Qt::ISODate);
-        obj["isCurrentUser"] = isCurrentUser;
-        return obj;
-    }
-
-    static Message fromJson(const QJsonObject &obj) {
-        Message msg(
-            obj["sender"].toString(),
-            obj["content"].toString(),
-            QDateTime::fromString(obj["timestamp"].toString(), Qt::ISODate),
-            obj["isCurrentUser"].toBool()
-            );
-        msg.id = obj["id"].toString();
-        // Generate ID if not present (for backward compatibility)
-        if (msg.id.isEmpty()) {
-            msg.id = QUuid::createUuid().toString();
-        }
-        return msg;
-    }
-};
+class ConversationView;
+class ContactListModel;
+class ContactSearchIndex;
+class NotificationCenter;
+class PerfOverlay;
+class ChatDataLoader;
+class ConversationStore;
+class MessageService;
+class MessageSearchIndex;
+class SearchQuery;
+class TrigramIndex;
+class QListWidget;
+class QListWidgetItem;
+
+// Word-wrapped message text whose height comes from TextLayoutCache, so
+// relayouts at a previously seen width don't re-run text layout
+class BubbleTextLabel : public QLabel {
+public:
+    BubbleTextLabel(const QString &messageId, const QString &text, QWidget *parent = nullptr);
+    void setText(const QString &text);
+    // While deferred, the label reports its nearest cached height instead of re-wrapping
+    void setDeferredWrap(bool deferred);
+    bool isWrapDeferred() const { return deferredWrap; }
+    bool hasHeightForWidth() const override { return true; }
+    int heightForWidth(int width) const override;
+
+protected:
+    void changeEvent(QEvent *event) override;
 
-// Forward declaration for Contact struct
-struct Contact {
-    QString name;
-    QString phone;
-    Contact() = default;
-    Contact(const QString &n, const QString &p) : name(n), phone(p) {}
-
-    // Methods for JSON serialization
-    QJsonObject toJson() const {
-        QJsonObject obj;
-        obj["name"] = name;
-        obj["phone"] = phone;
-        return obj;
-    }
-
-    static Contact fromJson(const QJsonObject &obj) {
-        return Contact(obj["name"].toString(), obj["phone"].toString());
-    }
+private:
+    QString messageId;
+    bool deferredWrap;
+    mutable int fontId;   // TextLayoutCache's id for font(); -1 until looked up
 };
 
 // Custom widget to hold message data
@@ -102,7 +85,9 @@ public:
     const Message& getMessage() const { return message; }
     void setHighlighted(bool highlighted);
     bool getHighlighted() const { return isHighlighted; }  // Add this getter method
-    QLabel *messageLabel;
+    void setDeferredWrap(bool deferred);
+    bool isWrapDeferred() const { return messageLabel->isWrapDeferred(); }
+    BubbleTextLabel *messageLabel;
 
 private:
     Message message;
@@ -118,10 +103,26 @@ class ChatWindow : public QWidget
 {
     Q_OBJECT
 public:
-    explicit ChatWindow(const QString &currentUser, QWidget *parent = nullptr);
+    // A loader prefetched for currentUser is taken over instead of reading again
+    explicit ChatWindow(const QString &currentUser, QWidget *parent = nullptr,
+                        ChatDataLoader *prefetched = nullptr);
 
     ~ChatWindow();
 
+    // Delivers a message from a contact as if it arrived over the network
+    void receiveMessage(const QString &contactName, const QString &content);
+    QStringList contactNames() const;
+    void selectContact(const QString &contactName);
+    // True once contacts and chat history have finished loading
+    bool isDataReady() const;
+    MessageService *service() const { return messageService; }
+
+signals:
+    void dataReady();
+
+protected:
+    bool event(QEvent *event) override;
+
 private slots:
     void onContactSelected();
     void onSendMessage();
@@ -137,6 +138,23 @@ private slots:
     void onEditMessage(const QString &messageId);
     void onDeleteMessage(const QString &messageId);
     void onSearchEnterPressed();
+    void onContactFilterChanged();
+    void dumpPerfData();
+    void onContactsLoaded(const QList<Contact> &contacts, bool fromFile);
+    void onIndexLoaded(MessageSearchIndex *index, const SearchIndexStore::State &state);
+    void onChatsLoaded(const ConversationBatch &conversations);
+    void onLoadProgress(int conversationsLoaded, int conversationsTotal);
+    void onDataLoaded(qint64 loaderMs);
+    void onGlobalResultActivated(QListWidgetItem *item);
+    void onSearchDebounced();
+    void onPreviousHit();
+    void onNextHit();
+    void onContactAdded(const Contact &contact);
+    void onMessageAdded(const QString &contact, const Message &msg);
+    void onMessagesReceived(const MessageBatch &messages);
+    void onMessageEdited(const QString &contact, const Message &msg);
+    void onMessageRemoved(const QString &contact, const QString &messageId);
+    void onConversationReset(const QString &contact);
 
 private:
     void setupUI();
@@ -144,34 +162,37 @@ private:
     void refreshContactsList();
     void setupChatArea();
     void setupSearchBar();
-    void addMessage(const QString &sender, const QString &message, bool isCurrentUser);
     void addMessageWidget(const Message &msg);
     void loadSampleContacts();
     void loadChatHistory(const QString &contact);
     void addContactToList(const Contact &contact);
-    QTimer *autoMessageTimer;
-    QStringList autoMessageContacts;
     QPushButton *profileButton;
     QMenu *contactContextMenu;
     QString rightClickedContact;
     void clearMessagesDisplay();
     void searchMessages(const QString &searchText);
-    void highlightSearchResults(const QString &searchText);
-    void setupAutoMessages();
-    void sendAutoMessage();
+    void highlightSearchResults(const QSet<QString> &messageIds);
     void clearHighlights();
-    QMap<QString, int> unreadCounts;  // Track unread messages per contact
     QSystemTrayIcon *trayIcon;        // System tray icon for notifications
+    NotificationCenter *notificationCenter;
     void showNotificationPopup(const QString &contactName, const QString &message);
     void updateContactUnreadCount(const QString &contactName, int count);
 
-    // Persistence methods
-    void saveContacts();
-    void loadContacts();
-    void saveChats();
-    void loadChats();
-    QString getContactsFilePath() const;
-    QString getChatsFilePath() const;
+    // Contacts, history, indexes and saving live in the core; the window
+    // shows them and turns user actions into MessageService calls
+    ConversationStore *store;
+    MessageService *messageService;
+
+    // Contacts and chats are read on a worker thread after the window shows.
+    // MessageService writes nothing back until the matching data has arrived.
+    ChatDataLoader *dataLoader;
+    QElapsedTimer startupTimer;
+    bool firstPaintLogged;
+    QLabel *loadingLabel;
+    void startDataLoad(ChatDataLoader *prefetched);
+
+    // Timing overlay, toggled with Ctrl+Shift+P; Ctrl+Shift+D dumps to a file
+    PerfOverlay *perfOverlay;
 
     // UI Components
     QHBoxLayout *mainLayout;
@@ -181,7 +202,11 @@ private:
     QFrame *contactsFrame;
     QVBoxLayout *contactsLayout;
     QLabel *contactsTitle;
-    QListWidget *contactsList;
+    QLineEdit *contactFilterInput;
+    QListView *contactsList;
+    ContactListModel *contactsModel;  // Rows, unread counts and previews per contact
+    ContactSearchIndex *contactSearchIndex;  // Backs the contacts quick-filter
+    void applyContactFilter();
     QPushButton *logoutButton;
     QPushButton *addContactButton;
 
@@ -196,9 +221,58 @@ private:
     QLineEdit *searchInput;
     QPushButton *clearSearchButton;
 
-    QScrollArea *messagesScrollArea;
-    QWidget *messagesWidget;
-    QVBoxLayout *messagesLayout;
+    // Searches of the open chat run on searchPool once typing pauses. Each
+    // search takes a generation number; a newer search makes older ones stop
+    // and their results are dropped.
+    QTimer *searchDebounceTimer;
+    QThreadPool searchPool;
+    std::atomic<int> searchGeneration;
+    QSet<QString> highlightedIds;   // Currently highlighted bubbles of currentView
+    void startSearch(const QString &searchText);
+
+    // Every match in the open chat, in order, with next/previous
+    SearchHitNavigator searchHits;
+    QLabel *hitCountLabel;
+    QPushButton *previousHitButton;
+    QPushButton *nextHitButton;
+    void showSearchHit(const SearchHitNavigator::Hit *hit);
+    void updateHitControls();
+
+    // Matches across every conversation, from the store's indexes. Both are
+    // searched on searchPool, in copies that share the indexes' data, with
+    // their own generation number.
+    QListWidget *globalResultsList;
+    static const int GlobalResultsShown = 50;
+    std::atomic<int> globalSearchGeneration;
+    struct GlobalResult {
+        QString contact;
+        QString messageId;
+        QString title;
+        QString snippet;
+        QVariantList highlights;
+    };
+    // Safe on any thread
+    static GlobalResult makeGlobalResult(const SearchQuery &query, const QString &contact, const QString &messageId,
+                                         const QString &text, const QString &title);
+    void addGlobalResult(const GlobalResult &result);
+    void updateGlobalResults(const QString &searchText);
+    // Word fragments and misspellings, up to GlobalResultsShown; safe on any thread
+    static void addTrigramResults(const TrigramIndex &index, const SearchQuery &query, QVector<GlobalResult> *results);
+
+    // One page per recently viewed conversation; switching chats swaps pages
+    QStackedWidget *messagesStack;
+    QWidget *emptyChatPage;
+    ConversationView *currentView;
+    QHash<QString, ConversationView*> conversationViews;
+    QStringList recentConversations; // Most recently viewed first
+    static const qint64 WarmViewBudgetBytes = 64 * 1024 * 1024;
+    ConversationView *conversationView(const QString &contact) const { return conversationViews.value(contact); }
+    void dropConversationView(const QString &contact);
+    void trimWarmViews();
+    // Hidden pages grow with incoming messages, so the budget is checked
+    // again shortly after they do
+    QTimer *warmTrimTimer;
+    void scheduleWarmTrim();
     QFrame *inputFrame;
     QHBoxLayout *inputLayout;
     QLineEdit *messageInput;
@@ -207,10 +281,6 @@ private:
     // Data
     QString currentUser;
     QString selectedContact;
-    QList<Contact> contactsList_data;
-    QMap<QString, QString> contactPhones;
-    QMap<QString, QList<Message>> chatHistory; // Store chat history for each contact
-    QMap<QString, MessageWidget*> messageWidgets; // Map message ID to widget
 };
 
 #endif // CHATWINDOW_H
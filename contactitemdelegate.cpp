@@ -0,0 +1,93 @@
+#include "contactitemdelegate.h"
+#include "contactlistmodel.h"
+#include <QPainter>
+#include <QFontMetrics>
+
+ContactItemDelegate::ContactItemDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void ContactItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const
+{
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+
+    QRect rect = option.rect;
+    bool selected = option.state & QStyle::State_Selected;
+    bool hovered = option.state & QStyle::State_MouseOver;
+    int unread = index.data(ContactListModel::UnreadCountRole).toInt();
+
+    // Background
+    if (selected) {
+        painter->fillRect(rect, QColor(102, 126, 234, 38));
+    } else if (hovered) {
+        painter->fillRect(rect, QColor(102, 126, 234, 20));
+    } else if (unread > 0) {
+        painter->fillRect(rect, QColor(255, 240, 240)); // Light red background
+    }
+
+    // Separator
+    painter->setPen(QColor("#f1f3f4"));
+    painter->drawLine(rect.bottomLeft(), rect.bottomRight());
+
+    QRect content = rect.adjusted(20, 10, -20, -10);
+
+    // Unread badge on the right
+    int badgeWidth = 0;
+    if (unread > 0) {
+        QFont badgeFont = option.font;
+        badgeFont.setPixelSize(11);
+        badgeFont.setBold(true);
+        QString badgeText = unread > 99 ? QString("99+") : QString::number(unread);
+        badgeWidth = qMax(22, QFontMetrics(badgeFont).horizontalAdvance(badgeText) + 12);
+        QRect badge(content.right() - badgeWidth + 1, content.top() + 2, badgeWidth, 22);
+
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(QColor("#dc3545"));
+        painter->drawRoundedRect(badge, 11, 11);
+        painter->setFont(badgeFont);
+        painter->setPen(Qt::white);
+        painter->drawText(badge, Qt::AlignCenter, badgeText);
+        badgeWidth += 8;
+    }
+
+    // Name
+    QFont nameFont = option.font;
+    nameFont.setPixelSize(14);
+    nameFont.setBold(selected || unread > 0);
+    painter->setFont(nameFont);
+    painter->setPen(selected ? QColor("#667eea") : QColor("#495057"));
+    QRect nameRect(content.left(), content.top(), content.width() - badgeWidth, 20);
+    QString name = index.data(ContactListModel::NameRole).toString();
+    painter->drawText(nameRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      QFontMetrics(nameFont).elidedText(name, Qt::ElideRight, nameRect.width()));
+
+    // Phone
+    QFont detailFont = option.font;
+    detailFont.setPixelSize(12);
+    painter->setFont(detailFont);
+    painter->setPen(QColor("#6c757d"));
+    QRect phoneRect(content.left(), nameRect.bottom() + 2, content.width(), 17);
+    painter->drawText(phoneRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      QString("📞 %1").arg(index.data(ContactListModel::PhoneRole).toString()));
+
+    // Last message preview
+    QString preview = index.data(ContactListModel::LastMessageRole).toString();
+    if (!preview.isEmpty()) {
+        painter->setPen(QColor("#adb5bd"));
+        QRect previewRect(content.left(), phoneRect.bottom() + 2, content.width(), 17);
+        preview.replace('\n', ' ');
+        painter->drawText(previewRect, Qt::AlignLeft | Qt::AlignVCenter,
+                          QFontMetrics(detailFont).elidedText(preview, Qt::ElideRight, previewRect.width()));
+    }
+
+    painter->restore();
+}
+
+QSize ContactItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    Q_UNUSED(index);
+    return QSize(option.rect.width(), RowHeight);
+}
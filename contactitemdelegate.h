@@ -0,0 +1,22 @@
+#ifndef CONTACTITEMDELEGATE_H
+#define CONTACTITEMDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Draws a contact row from ContactListModel roles: name, phone, last message
+// preview and an unread badge. Rows have a fixed height so the view can use
+// uniform item sizes.
+class ContactItemDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    explicit ContactItemDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    static const int RowHeight = 76;
+};
+
+#endif // CONTACTITEMDELEGATE_H
@@ -0,0 +1,429 @@
+#include "contactlistmodel.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+const int MinimumCapacity = 1024;
+
+qint64 activityKey(const QDateTime &when)
+{
+    return when.isValid() ? when.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+}
+}
+
+ContactListModel::ContactListModel(QObject *parent)
+    : QAbstractListModel(parent), filtered(false), capacity(0), nextSequence(0)
+{
+    rebuildOrder(QVector<int>());
+}
+
+int ContactListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return filtered ? filterSlots.size() : entries.size();
+}
+
+QVariant ContactListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    const Entry &entry = entries[slotForDisplayRow(index.row())];
+    switch (role) {
+    case Qt::DisplayRole:
+    case NameRole:
+        return entry.contact.name;
+    case ContactIdRole:
+        return entry.contact.id;
+    case PhoneRole:
+        return entry.contact.phone;
+    case UnreadCountRole:
+        return entry.unread;
+    case LastMessageRole:
+        return entry.lastMessage;
+    case LastActivityRole:
+        return entry.lastActivity;
+    case Qt::ToolTipRole:
+        return QString("%1\n📞 %2").arg(entry.contact.name, entry.contact.phone);
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ContactListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles[ContactIdRole] = "contactId";
+    roles[NameRole] = "name";
+    roles[PhoneRole] = "phone";
+    roles[UnreadCountRole] = "unreadCount";
+    roles[LastMessageRole] = "lastMessage";
+    roles[LastActivityRole] = "lastActivity";
+    return roles;
+}
+
+void ContactListModel::setContacts(const QList<Contact> &contacts)
+{
+    beginResetModel();
+    dropFilter();
+
+    QVector<Entry> previous;
+    previous.swap(entries);
+    QHash<QString, int> previousSlots;
+    previousSlots.swap(slotById);
+    slotByName.clear();
+
+    entries.reserve(contacts.size());
+    for (const Contact &contact : contacts) {
+        Entry entry;
+        entry.contact = contact;
+        int oldSlot = previousSlots.value(contact.id, -1);
+        if (oldSlot >= 0) {
+            entry.unread = previous[oldSlot].unread;
+            entry.lastMessage = previous[oldSlot].lastMessage;
+            entry.lastActivity = previous[oldSlot].lastActivity;
+        }
+        slotByName.insert(contact.name, entries.size());
+        slotById.insert(contact.id, entries.size());
+        entries.append(entry);
+    }
+
+    // Most recent first; contacts without activity keep their given order
+    QVector<int> order(entries.size());
+    for (int slot = 0; slot < entries.size(); ++slot) {
+        order[slot] = slot;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return activityKey(entries[a].lastActivity) > activityKey(entries[b].lastActivity);
+    });
+    rebuildOrder(order);
+
+    endResetModel();
+}
+
+void ContactListModel::setActivity(const QHash<QString, QDateTime> &lastActivityByName)
+{
+    beginResetModel();
+    dropFilter();
+
+    for (auto it = lastActivityByName.constBegin(); it != lastActivityByName.constEnd(); ++it) {
+        int slot = slotByName.value(it.key(), -1);
+        if (slot >= 0) {
+            entries[slot].lastActivity = it.value();
+        }
+    }
+
+    QVector<int> order;
+    order.reserve(entries.size());
+    for (int row = 0; row < entries.size(); ++row) {
+        order.append(slotForRow(row));
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return activityKey(entries[a].lastActivity) > activityKey(entries[b].lastActivity);
+    });
+    rebuildOrder(order);
+
+    endResetModel();
+}
+
+void ContactListModel::addContact(const Contact &contact)
+{
+    clearFilter();
+    beginInsertRows(QModelIndex(), 0, 0);
+    int slot = entries.size();
+    Entry entry;
+    entry.contact = contact;
+    entries.append(entry);
+    slotByName.insert(contact.name, slot);
+    slotById.insert(contact.id, slot);
+    assignSequence(slot);
+    endInsertRows();
+}
+
+void ContactListModel::updateContact(const QString &oldName, const Contact &contact)
+{
+    int slot = slotByName.value(oldName, -1);
+    if (slot < 0) return;
+
+    Entry &entry = entries[slot];
+    slotByName.remove(oldName);
+    slotById.remove(entry.contact.id);
+    entry.contact = contact;
+    slotByName.insert(contact.name, slot);
+    slotById.insert(contact.id, slot);
+
+    emitRowChanged(slot, {Qt::DisplayRole, NameRole, PhoneRole, ContactIdRole, Qt::ToolTipRole});
+}
+
+void ContactListModel::removeContact(const QString &name)
+{
+    int slot = slotByName.value(name, -1);
+    if (slot < 0) return;
+
+    clearFilter();
+    int row = rowForSlot(slot);
+    beginRemoveRows(QModelIndex(), row, row);
+
+    releaseSequence(slot);
+    slotByName.remove(name);
+    slotById.remove(entries[slot].contact.id);
+
+    // Fill the hole with the last slot so no other slot numbers change
+    int lastSlot = entries.size() - 1;
+    if (slot != lastSlot) {
+        entries[slot] = entries[lastSlot];
+        const Entry &moved = entries[slot];
+        slotByName[moved.contact.name] = slot;
+        slotById[moved.contact.id] = slot;
+        slotAtPosition[capacity - 1 - moved.sequence] = slot;
+    }
+    entries.removeLast();
+
+    endRemoveRows();
+}
+
+void ContactListModel::touchContact(const QString &name, const QDateTime &when)
+{
+    int slot = slotByName.value(name, -1);
+    if (slot < 0) return;
+
+    entries[slot].lastActivity = when;
+
+    int row = displayRowForSlot(slot);
+    if (row == 0) {
+        emitRowChanged(slot, {LastActivityRole});
+    }
+
+    // Rows above shift down by one implicitly; nothing else is renumbered
+    if (row > 0) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), 0);
+    }
+    if (rowForSlot(slot) != 0) {
+        releaseSequence(slot);
+        assignSequence(slot);
+    }
+    if (row > 0) {
+        endMoveRows();
+    }
+}
+
+void ContactListModel::setUnreadCount(const QString &name, int count)
+{
+    int slot = slotByName.value(name, -1);
+    if (slot < 0 || entries[slot].unread == count) return;
+
+    entries[slot].unread = count;
+    emitRowChanged(slot, {UnreadCountRole});
+}
+
+int ContactListModel::unreadCount(const QString &name) const
+{
+    int slot = slotByName.value(name, -1);
+    return slot < 0 ? 0 : entries[slot].unread;
+}
+
+void ContactListModel::setLastMessage(const QString &name, const QString &preview)
+{
+    int slot = slotByName.value(name, -1);
+    if (slot < 0) return;
+
+    entries[slot].lastMessage = preview;
+    emitRowChanged(slot, {LastMessageRole});
+}
+
+int ContactListModel::rowForName(const QString &name) const
+{
+    int slot = slotByName.value(name, -1);
+    return slot < 0 ? -1 : displayRowForSlot(slot);
+}
+
+int ContactListModel::rowForId(const QString &contactId) const
+{
+    int slot = slotById.value(contactId, -1);
+    return slot < 0 ? -1 : displayRowForSlot(slot);
+}
+
+QString ContactListModel::nameAt(int row) const
+{
+    return (row >= 0 && row < rowCount()) ? entries[slotForDisplayRow(row)].contact.name : QString();
+}
+
+void ContactListModel::setFilter(const QVector<QString> &contactIds)
+{
+    // Each match is counted in at its activity position: O(k log n) for k
+    // matches, and the order comes with it
+    beginResetModel();
+    dropFilter();
+    filtered = true;
+    filterMember.fill(false, entries.size());
+    filterSlots.reserve(contactIds.size());
+    for (const QString &contactId : contactIds) {
+        int slot = slotById.value(contactId, -1);
+        if (slot < 0 || filterMember[slot]) continue;
+        filterMember[slot] = true;
+        filterSlots.append(slot);
+        fenwickAdd(filterFenwick, capacity - 1 - entries[slot].sequence, 1);
+    }
+    endResetModel();
+}
+
+void ContactListModel::clearFilter()
+{
+    if (!filtered) return;
+
+    beginResetModel();
+    dropFilter();
+    endResetModel();
+}
+
+void ContactListModel::dropFilter()
+{
+    // Only the matches' counts are taken out, so this is O(k log n) too
+    for (int slot : std::as_const(filterSlots)) {
+        fenwickAdd(filterFenwick, capacity - 1 - entries[slot].sequence, -1);
+    }
+    filtered = false;
+    filterMember.clear();
+    filterSlots.clear();
+}
+
+int ContactListModel::slotForDisplayRow(int row) const
+{
+    return filtered ? slotAtPosition[fenwickSelect(filterFenwick, row + 1)] : slotForRow(row);
+}
+
+int ContactListModel::displayRowForSlot(int slot) const
+{
+    if (!filtered) return rowForSlot(slot);
+    if (!filterMember[slot]) return -1;
+    return fenwickPrefix(filterFenwick, capacity - 1 - entries[slot].sequence) - 1;
+}
+
+int ContactListModel::slotForRow(int row) const
+{
+    return slotAtPosition[fenwickSelect(fenwick, row + 1)];
+}
+
+int ContactListModel::rowForSlot(int slot) const
+{
+    return fenwickPrefix(fenwick, capacity - 1 - entries[slot].sequence) - 1;
+}
+
+void ContactListModel::assignSequence(int slot)
+{
+    if (nextSequence >= capacity) {
+        compactSequences();
+    }
+
+    int sequence = nextSequence++;
+    int position = capacity - 1 - sequence;
+    entries[slot].sequence = sequence;
+    slotAtPosition[position] = slot;
+    fenwickAdd(fenwick, position, 1);
+    if (filtered && filterMember[slot]) {
+        fenwickAdd(filterFenwick, position, 1);
+    }
+}
+
+void ContactListModel::releaseSequence(int slot)
+{
+    int position = capacity - 1 - entries[slot].sequence;
+    fenwickAdd(fenwick, position, -1);
+    if (filtered && filterMember[slot]) {
+        fenwickAdd(filterFenwick, position, -1);
+    }
+    slotAtPosition[position] = -1;
+    entries[slot].sequence = -1;
+}
+
+void ContactListModel::compactSequences()
+{
+    QVector<int> order;
+    order.reserve(entries.size());
+    for (int position = 0; position < capacity; ++position) {
+        if (slotAtPosition[position] >= 0) {
+            order.append(slotAtPosition[position]);
+        }
+    }
+    rebuildOrder(order);
+}
+
+void ContactListModel::rebuildOrder(const QVector<int> &slotsByRow)
+{
+    // Renumbering keeps the row order; only the sequence space is reset
+    int count = slotsByRow.size();
+    capacity = qMax(MinimumCapacity, 2 * (entries.size() + 1));
+    fenwick.fill(0, capacity + 1);
+    filterFenwick.fill(0, capacity + 1);
+    slotAtPosition.fill(-1, capacity);
+
+    for (int row = 0; row < count; ++row) {
+        int slot = slotsByRow[row];
+        int sequence = count - 1 - row;
+        int position = capacity - 1 - sequence;
+        entries[slot].sequence = sequence;
+        slotAtPosition[position] = slot;
+        fenwick[position + 1] = 1;
+    }
+    nextSequence = count;
+
+    // Linear-time Fenwick construction
+    for (int i = 1; i <= capacity; ++i) {
+        int parent = i + (i & -i);
+        if (parent <= capacity) {
+            fenwick[parent] += fenwick[i];
+        }
+    }
+
+    // Compaction while filtered moves the matches along with everyone else
+    for (int slot : std::as_const(filterSlots)) {
+        fenwickAdd(filterFenwick, capacity - 1 - entries[slot].sequence, 1);
+    }
+}
+
+void ContactListModel::emitRowChanged(int slot, const QVector<int> &roles)
+{
+    int row = displayRowForSlot(slot);
+    if (row < 0) return;
+
+    QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, roles);
+}
+
+void ContactListModel::fenwickAdd(QVector<int> &tree, int position, int delta)
+{
+    for (int i = position + 1; i <= capacity; i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+int ContactListModel::fenwickPrefix(const QVector<int> &tree, int position) const
+{
+    // Number of occupied positions in [0, position]
+    int sum = 0;
+    for (int i = position + 1; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+int ContactListModel::fenwickSelect(const QVector<int> &tree, int rank) const
+{
+    // Lowest position whose prefix count reaches rank (1-based)
+    int step = 1;
+    while (step * 2 <= capacity) {
+        step *= 2;
+    }
+
+    int position = 0;
+    for (; step > 0; step /= 2) {
+        int next = position + step;
+        if (next <= capacity && tree[next] < rank) {
+            position = next;
+            rank -= tree[next];
+        }
+    }
+    return position;
+}
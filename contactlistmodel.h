@@ -0,0 +1,107 @@
+#ifndef CONTACTLISTMODEL_H
+#define CONTACTLISTMODEL_H
+
+#include "chatwindow.h"
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QHash>
+#include <QVector>
+
+// Contacts pane model. Rows are keyed by contact ID with a name hash, so
+// unread and preview updates touch a single row instead of scanning the list.
+//
+// Rows are ordered by recent activity. Each contact holds an activity
+// sequence number and a Fenwick tree over the sequence space maps between
+// rows and contacts, so moving a conversation to the top, finding a
+// contact's row and fetching a row are all O(log n). A second tree over the
+// same positions counts only the contacts a filter shows, so the same holds
+// while filtered, however many contacts match.
+class ContactListModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        ContactIdRole = Qt::UserRole + 1,
+        NameRole,
+        PhoneRole,
+        UnreadCountRole,
+        LastMessageRole,
+        LastActivityRole
+    };
+
+    explicit ContactListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Replaces all rows; unread counts, previews and activity carry over by contact ID
+    void setContacts(const QList<Contact> &contacts);
+    // Re-sorts every row by the given activity times in one reset (used after loading)
+    void setActivity(const QHash<QString, QDateTime> &lastActivityByName);
+    // New contacts go to the top, as the most recently touched
+    void addContact(const Contact &contact);
+    void updateContact(const QString &oldName, const Contact &contact);
+    void removeContact(const QString &name);
+
+    // Moves the conversation's row to the top; only that row moves
+    void touchContact(const QString &name, const QDateTime &when);
+
+    void setUnreadCount(const QString &name, int count);
+    int unreadCount(const QString &name) const;
+    void setLastMessage(const QString &name, const QString &preview);
+
+    int rowForName(const QString &name) const;
+    int rowForId(const QString &contactId) const;
+    QString nameAt(int row) const;
+
+    // Shows only the given contacts, still in activity order. Adding or
+    // removing contacts clears the filter; the caller re-applies it.
+    void setFilter(const QVector<QString> &contactIds);
+    void clearFilter();
+    bool isFiltered() const { return filtered; }
+
+private:
+    struct Entry {
+        Contact contact;
+        int unread = 0;
+        QString lastMessage;
+        QDateTime lastActivity;
+        int sequence = -1;
+    };
+
+    int slotForRow(int row) const;
+    int rowForSlot(int slot) const;
+    // Rows as the view sees them, which differ from activity rank while filtered
+    int slotForDisplayRow(int row) const;
+    int displayRowForSlot(int slot) const;
+    // Forgets the filtered contacts; callers reset the model around it
+    void dropFilter();
+    void assignSequence(int slot);
+    void releaseSequence(int slot);
+    void rebuildOrder(const QVector<int> &slotsByRow);
+    void compactSequences();
+    void emitRowChanged(int slot, const QVector<int> &roles);
+
+    // Fenwick tree over positions; position = capacity - 1 - sequence so that
+    // the most recent contact has the lowest position (row 0)
+    void fenwickAdd(QVector<int> &tree, int position, int delta);
+    int fenwickPrefix(const QVector<int> &tree, int position) const;
+    int fenwickSelect(const QVector<int> &tree, int rank) const;
+
+    QVector<Entry> entries;           // Stable slots, not in display order
+    QHash<QString, int> slotByName;
+    QHash<QString, int> slotById;
+
+    bool filtered;
+    QVector<bool> filterMember;       // By slot, while filtered
+    QVector<int> filterSlots;         // The same contacts, in no order
+    QVector<int> filterFenwick;       // As fenwick, counting only filtered contacts
+
+    QVector<int> fenwick;
+    QVector<int> slotAtPosition;
+    int capacity;
+    int nextSequence;
+};
+
+#endif // CONTACTLISTMODEL_H
@@ -0,0 +1,322 @@
+#include "conversationview.h"
+#include "textlayoutcache.h"
+#include "perfmonitor.h"
+#include <QScrollBar>
+#include <QResizeEvent>
+
+namespace
+{
+// Approximate footprint of one bubble: the frame, its labels, layout and
+// resolved style sheet. Text is counted separately.
+const qint64 BubbleOverheadBytes = 8 * 1024;
+
+// How far above the end still counts as reading the latest messages
+const int BottomSlackPixels = 40;
+
+// Message column that times its own layout passes. QApplication activates
+// a widget's layout before the widget sees LayoutRequest, so the time is
+// taken where the bubbles are actually measured and placed.
+class TimedVBoxLayout : public QVBoxLayout
+{
+public:
+    using QVBoxLayout::QVBoxLayout;
+
+    void setGeometry(const QRect &rect) override
+    {
+        PerfScope scope(QStringLiteral("ui.layout"));
+        QVBoxLayout::setGeometry(rect);
+    }
+};
+}
+
+ConversationView::ConversationView(const QString &contactName, QWidget *parent)
+    : QScrollArea(parent), contact(contactName), scrollPending(false),
+    deferredBubbleCount(0), memoryEstimate(0)
+{
+    setWidgetResizable(true);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setStyleSheet(
+        "QScrollArea {"
+        "    border: none;"
+        "    background: #f8f9fa;"
+        "}"
+        "QScrollBar:vertical {"
+        "    background: #f1f3f4;"
+        "    width: 8px;"
+        "    border-radius: 4px;"
+        "}"
+        "QScrollBar::handle:vertical {"
+        "    background: #ced4da;"
+        "    border-radius: 4px;"
+        "    min-height: 20px;"
+        "}"
+        "QScrollBar::handle:vertical:hover {"
+        "    background: #adb5bd;"
+        "}"
+        );
+
+    messagesWidget = new QWidget();
+    messagesWidget->setStyleSheet("background: transparent;");
+    messagesLayout = new TimedVBoxLayout(messagesWidget);
+    messagesLayout->setContentsMargins(20, 20, 20, 20);
+    messagesLayout->setSpacing(15);
+    messagesLayout->addStretch();
+
+    setWidget(messagesWidget);
+
+    // Incoming widgets are collected for one frame and inserted together
+    insertFlushTimer = new QTimer(this);
+    insertFlushTimer->setSingleShot(true);
+    insertFlushTimer->setInterval(16);
+    connect(insertFlushTimer, &QTimer::timeout, this, &ConversationView::flushPendingMessages);
+
+    // Resize steps only restart this timer; bubbles re-wrap when it fires
+    resizeSettleTimer = new QTimer(this);
+    resizeSettleTimer->setSingleShot(true);
+    resizeSettleTimer->setInterval(150);
+    connect(resizeSettleTimer, &QTimer::timeout, this, &ConversationView::onResizeSettled);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &ConversationView::onScrolled);
+
+    // Floats over the bottom of the page while there is something unread below
+    newMessagesButton = new QPushButton("New messages ↓", viewport());
+    newMessagesButton->setCursor(Qt::PointingHandCursor);
+    newMessagesButton->setStyleSheet(
+        "QPushButton {"
+        "    background: #007bff;"
+        "    color: white;"
+        "    border: none;"
+        "    border-radius: 14px;"
+        "    padding: 6px 14px;"
+        "    font-size: 12px;"
+        "}"
+        "QPushButton:hover {"
+        "    background: #0056b3;"
+        "}"
+        );
+    newMessagesButton->hide();
+    connect(newMessagesButton, &QPushButton::clicked, this, [this]() { scrollToBottom(0); });
+}
+
+qint64 ConversationView::messageCost(const Message &msg)
+{
+    // The content is held by both the widget's Message copy and its label
+    return BubbleOverheadBytes + 2 * msg.content.size() * qint64(sizeof(QChar));
+}
+
+void ConversationView::setMessages(const QList<Message> &messages)
+{
+    PerfScope scope(QStringLiteral("chat.build"));
+
+    // Add every message widget under a single layout pass
+    messagesWidget->setUpdatesEnabled(false);
+    for (const Message &msg : messages) {
+        createMessageWidget(msg);
+    }
+    messagesWidget->setUpdatesEnabled(true);
+
+    messagesWidget->updateGeometry();
+
+    // Scroll to bottom with delay to ensure widgets are rendered
+    scrollToBottom(100);
+}
+
+void ConversationView::appendMessage(const Message &msg)
+{
+    pendingMessages.append(msg);
+    if (!insertFlushTimer->isActive()) {
+        insertFlushTimer->start();
+    }
+}
+
+void ConversationView::removeMessage(const QString &messageId)
+{
+    MessageWidget *widget = widgets.take(messageId);
+    if (!widget) return;
+
+    messagesLayout->removeWidget(widget);
+    if (widget->isWrapDeferred()) {
+        --deferredBubbleCount;
+    }
+    memoryEstimate -= messageCost(widget->getMessage());
+    widget->deleteLater();
+    TextLayoutCache::instance().invalidate(messageId);
+}
+
+MessageWidget *ConversationView::createMessageWidget(const Message &msg)
+{
+    MessageWidget *messageWidget = new MessageWidget(msg, messagesWidget);
+
+    // Store reference for later updates
+    widgets[msg.id] = messageWidget;
+    memoryEstimate += messageCost(msg);
+
+    // Forward edit/delete requests to the window
+    connect(messageWidget, &MessageWidget::editRequested, this, &ConversationView::editRequested);
+    connect(messageWidget, &MessageWidget::deleteRequested, this, &ConversationView::deleteRequested);
+
+    // Insert before the stretch (should be last item)
+    int insertIndex = messagesLayout->count() - 1;
+    if (insertIndex < 0) insertIndex = 0;
+
+    messagesLayout->insertWidget(insertIndex, messageWidget);
+    return messageWidget;
+}
+
+void ConversationView::flushPendingMessages()
+{
+    if (pendingMessages.isEmpty()) return;
+    PerfScope scope(QStringLiteral("message.insertBatch"));
+
+    // Follow the conversation only while the user is watching its end or
+    // has just sent something; a hidden page or one scrolled up keeps its offset
+    bool follow = isAtBottom() || (scrollPending && revealTarget.isEmpty());
+    for (const Message &msg : std::as_const(pendingMessages)) {
+        follow = follow || msg.isCurrentUser;
+    }
+    follow = follow && isVisible();
+
+    // Suspend painting so the whole batch costs a single relayout
+    messagesWidget->setUpdatesEnabled(false);
+    for (const Message &msg : std::as_const(pendingMessages)) {
+        createMessageWidget(msg);
+    }
+    messagesWidget->setUpdatesEnabled(true);
+    pendingMessages.clear();
+
+    // Force layout update
+    messagesWidget->updateGeometry();
+    updateGeometry();
+
+    if (follow) {
+        scrollToBottom(50);
+    } else {
+        placeNewMessagesButton();
+        newMessagesButton->show();
+        newMessagesButton->raise();
+    }
+}
+
+bool ConversationView::isAtBottom() const
+{
+    const QScrollBar *scrollBar = verticalScrollBar();
+    return scrollBar->value() >= scrollBar->maximum() - BottomSlackPixels;
+}
+
+void ConversationView::placeNewMessagesButton()
+{
+    newMessagesButton->adjustSize();
+    newMessagesButton->move((viewport()->width() - newMessagesButton->width()) / 2,
+                            viewport()->height() - newMessagesButton->height() - 12);
+}
+
+void ConversationView::scrollToBottom(int delay)
+{
+    // One scroll per batch, however many widgets went in
+    if (scrollPending) return;
+    scrollPending = true;
+
+    QTimer::singleShot(delay, this, &ConversationView::applyPendingScroll);
+}
+
+void ConversationView::revealMessage(const QString &messageId)
+{
+    revealTarget = messageId;
+    if (scrollPending) return;
+    scrollPending = true;
+
+    // After the current layout pass, so the bubble has its final position
+    QTimer::singleShot(0, this, &ConversationView::applyPendingScroll);
+}
+
+void ConversationView::applyPendingScroll()
+{
+    scrollPending = false;
+
+    if (!revealTarget.isEmpty()) {
+        MessageWidget *widget = widgets.value(revealTarget);
+        revealTarget.clear();
+        if (widget) {
+            ensureWidgetVisible(widget);
+            return;
+        }
+    }
+
+    QScrollBar *scrollBar = verticalScrollBar();
+    scrollBar->setValue(scrollBar->maximum());
+    newMessagesButton->hide();
+}
+
+void ConversationView::resizeEvent(QResizeEvent *event)
+{
+    // Only live resizes of a laid-out page are coalesced, not the first show
+    if (!widgets.isEmpty() && isVisible() && event->oldSize().width() > 0) {
+        if (!resizeSettleTimer->isActive()) {
+            // First step of a drag: pin the message column so the bubbles
+            // keep their current wrapping until the size settles
+            messagesWidget->setFixedWidth(messagesWidget->width());
+        }
+        resizeSettleTimer->start();
+    }
+
+    QScrollArea::resizeEvent(event);
+    placeNewMessagesButton();
+}
+
+void ConversationView::onResizeSettled()
+{
+    // Offscreen bubbles answer with their nearest cached height; only the
+    // visible ones are measured at the new width
+    deferredBubbleCount = 0;
+    for (auto it = widgets.begin(); it != widgets.end(); ++it) {
+        it.value()->setDeferredWrap(true);
+        ++deferredBubbleCount;
+    }
+
+    messagesWidget->setMinimumWidth(0);
+    messagesWidget->setMaximumWidth(QWIDGETSIZE_MAX);
+
+    updateVisibleBubbles();
+}
+
+void ConversationView::onScrolled()
+{
+    if (!newMessagesButton->isHidden() && isAtBottom()) {
+        newMessagesButton->hide();
+    }
+    if (deferredBubbleCount > 0) {
+        updateVisibleBubbles();
+    }
+}
+
+void ConversationView::updateVisibleBubbles()
+{
+    QRect visibleRect(0, verticalScrollBar()->value(),
+                      viewport()->width(), viewport()->height());
+    // Include a screen of margin so short scrolls don't land on stale heights
+    visibleRect.adjust(0, -visibleRect.height(), 0, visibleRect.height());
+
+    // Bubbles sit in the layout top to bottom, ahead of the stretch, so the
+    // first one reaching the band is found by binary search
+    const int bubbleCount = messagesLayout->count() - 1;
+    int first = 0;
+    int last = bubbleCount;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (messagesLayout->itemAt(middle)->geometry().bottom() < visibleRect.top()) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    for (int i = first; i < bubbleCount; ++i) {
+        QLayoutItem *item = messagesLayout->itemAt(i);
+        if (item->geometry().top() > visibleRect.bottom()) break;
+        MessageWidget *widget = qobject_cast<MessageWidget*>(item->widget());
+        if (widget && widget->isWrapDeferred()) {
+            widget->setDeferredWrap(false);
+            --deferredBubbleCount;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef CONVERSATIONVIEW_H
+#define CONVERSATIONVIEW_H
+
+#include "chatwindow.h"
+#include <QScrollArea>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QTimer>
+#include <QMap>
+#include <QList>
+
+// Scrollable page of message bubbles for one conversation. ChatWindow keeps
+// recently viewed pages alive so switching back to a chat is a page swap
+// that also preserves its scroll position.
+class ConversationView : public QScrollArea
+{
+    Q_OBJECT
+signals:
+    void editRequested(const QString &messageId);
+    void deleteRequested(const QString &messageId);
+
+public:
+    explicit ConversationView(const QString &contactName, QWidget *parent = nullptr);
+
+    QString contactName() const { return contact; }
+    void setContactName(const QString &name) { contact = name; }
+
+    // Builds the page from history in a single layout pass
+    void setMessages(const QList<Message> &messages);
+    // Queues a bubble; bubbles queued within a frame are inserted together
+    void appendMessage(const Message &msg);
+    void removeMessage(const QString &messageId);
+
+    MessageWidget *messageWidget(const QString &messageId) const { return widgets.value(messageId); }
+    const QMap<QString, MessageWidget*> &messageWidgets() const { return widgets; }
+    int messageCount() const { return widgets.size() + pendingMessages.size(); }
+
+    void scrollToBottom(int delay);
+    bool isAtBottom() const;
+    // Messages went in below while the page was hidden or scrolled up
+    bool hasNewMessagesBelow() const { return !newMessagesButton->isHidden(); }
+    // Scrolls the message into view, taking over any pending scroll to the bottom
+    void revealMessage(const QString &messageId);
+
+    // Rough heap cost of the page, used to budget how many stay warm
+    qint64 estimatedMemory() const { return memoryEstimate; }
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void flushPendingMessages();
+    void onResizeSettled();
+    void onScrolled();
+    void applyPendingScroll();
+
+private:
+    MessageWidget *createMessageWidget(const Message &msg);
+    void placeNewMessagesButton();
+    void updateVisibleBubbles();
+    static qint64 messageCost(const Message &msg);
+
+    QString contact;
+    QWidget *messagesWidget;
+    QVBoxLayout *messagesLayout;
+    QMap<QString, MessageWidget*> widgets; // Map message ID to widget
+
+    // Burst coalescing: widgets queued within a frame go in together
+    QTimer *insertFlushTimer;
+    QList<Message> pendingMessages;
+    bool scrollPending;
+    QString revealTarget;
+    QPushButton *newMessagesButton;
+
+    // Coalesces resizes so bubbles re-wrap once the drag settles
+    QTimer *resizeSettleTimer;
+    int deferredBubbleCount;
+
+    qint64 memoryEstimate;
+};
+
+#endif // CONVERSATIONVIEW_H
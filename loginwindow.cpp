@@ -2,6 +2,7 @@
 #include "RegisterWindow.h"
 #include "ChatWindow.h"
 #include "usermanager.h"
+#include "chatdataloader.h"
 #include <QApplication>
 #include <QScreen>
 #include <QVBoxLayout>
@@ -13,10 +14,17 @@
 #include <QDebug>
 #include <QFrame>
 #include <QGraphicsDropShadowEffect>
+#include <QTimer>
 
 LoginWindow::LoginWindow(QWidget *parent)
-    : QWidget(parent), registerWindow(nullptr), chatWindow(nullptr)
+    : QWidget(parent), registerWindow(nullptr), chatWindow(nullptr), prefetchLoader(nullptr)
 {
+    // Wait for typing to pause so partial names don't start a read
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(300);
+    connect(prefetchTimer, &QTimer::timeout, this, &LoginWindow::startPrefetch);
+
     setupUI();
     setWindowTitle("Login - Welcome Back");
     setFixedSize(440, 700);
@@ -35,6 +43,7 @@ LoginWindow::LoginWindow(QWidget *parent)
 
 LoginWindow::~LoginWindow()
 {
+    delete prefetchLoader;
     if (registerWindow) {
         delete registerWindow;
     }
@@ -310,6 +319,35 @@ void LoginWindow::setupUI()
     connect(loginButton, &QPushButton::clicked, this, &LoginWindow::onLoginClicked);
     connect(registerButton, &QPushButton::clicked, this, &LoginWindow::onRegisterClicked);
     connect(passwordEdit, &QLineEdit::returnPressed, this, &LoginWindow::onLoginClicked);
+    connect(usernameEdit, &QLineEdit::textEdited, this, &LoginWindow::onUsernameEdited);
+}
+
+void LoginWindow::onUsernameEdited()
+{
+    // A prefetch for a different name is of no use any more
+    if (prefetchLoader && prefetchLoader->user() != usernameEdit->text().trimmed()) {
+        discardPrefetch();
+    }
+    prefetchTimer->start();
+}
+
+void LoginWindow::startPrefetch()
+{
+    QString username = usernameEdit->text().trimmed();
+    if (username.isEmpty() || prefetchLoader) return;
+    if (!UserManager::instance().userExists(username)) return;
+
+    qDebug() << "Prefetching chat data for" << username;
+    prefetchLoader = new ChatDataLoader(username);
+    prefetchLoader->setBuffered(true);
+    prefetchLoader->start();
+}
+
+void LoginWindow::discardPrefetch()
+{
+    if (!prefetchLoader) return;
+    prefetchLoader->discard();
+    prefetchLoader = nullptr;
 }
 
 void LoginWindow::onLoginClicked()
@@ -335,8 +373,11 @@ void LoginWindow::onLoginClicked()
             chatWindow = nullptr;
         }
 
-        // Create and show chat window
-        chatWindow = new ChatWindow(username, this);
+        // Create and show chat window, handing over any data already read
+        prefetchTimer->stop();
+        ChatDataLoader *prefetched = prefetchLoader;
+        prefetchLoader = nullptr;
+        chatWindow = new ChatWindow(username, this, prefetched);
 
         // Set window flags to ensure it appears properly
         chatWindow->setWindowFlags(Qt::Window);
@@ -376,6 +417,9 @@ void LoginWindow::onLoginClicked()
 
     } else {
         qDebug() << "Authentication failed";
+        // Nothing read for an unauthenticated login is kept around
+        prefetchTimer->stop();
+        discardPrefetch();
         QMessageBox::warning(this, "Login Failed",
                              "Invalid username or password. Please try again.");
         passwordEdit->clear();
@@ -7,6 +7,8 @@ class QLineEdit;
 class QPushButton;
 class RegisterWindow;
 class ChatWindow;  // Add forward declaration
+class ChatDataLoader;
+class QTimer;
 
 class LoginWindow : public QWidget
 {
@@ -21,6 +23,8 @@ private slots:
     void onRegisterClicked();
     void onBackToLogin();
     void onRegisterWindowClosed();
+    void onUsernameEdited();
+    void startPrefetch();
 
 private:
     void setupUI();
@@ -32,6 +36,11 @@ private:
     QPushButton *registerButton;
     RegisterWindow *registerWindow;
     ChatWindow *chatWindow;  // Add ChatWindow pointer
+
+    // Starts reading a known user's data while the password is typed
+    QTimer *prefetchTimer;
+    ChatDataLoader *prefetchLoader;
+    void discardPrefetch();
 };
 
 #endif // LOGINWINDOW_H
@@ -1,10 +1,18 @@
 #include <QApplication>
 #include "LoginWindow.h"
+#include "benchmarks.h"
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
 
+    // "--benchmark <name> [options]" runs a synthetic benchmark instead of the UI
+    QStringList args = app.arguments();
+    int benchmarkIndex = args.indexOf("--benchmark");
+    if (benchmarkIndex >= 0) {
+        return Benchmarks::run(args.value(benchmarkIndex + 1), args.mid(benchmarkIndex + 2));
+    }
+
     LoginWindow loginWindow;
     loginWindow.show();
 
@@ -0,0 +1,183 @@
+#include "notificationcenter.h"
+#include <QApplication>
+#include <QScreen>
+#include <QFrame>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <QTimer>
+#include <QSystemTrayIcon>
+
+NotificationCenter::NotificationCenter(QSystemTrayIcon *trayIcon, QObject *parent)
+    : QObject(parent), trayIcon(trayIcon), popup(nullptr), popupTitle(nullptr),
+    popupBody(nullptr), trayBacklog(0)
+{
+    aggregationTimer = new QTimer(this);
+    aggregationTimer->setSingleShot(true);
+    aggregationTimer->setInterval(AggregationMs);
+    connect(aggregationTimer, &QTimer::timeout, this, &NotificationCenter::flush);
+
+    popupHideTimer = new QTimer(this);
+    popupHideTimer->setSingleShot(true);
+    popupHideTimer->setInterval(PopupVisibleMs);
+
+    trayBacklogTimer = new QTimer(this);
+    trayBacklogTimer->setSingleShot(true);
+    connect(trayBacklogTimer, &QTimer::timeout, this, &NotificationCenter::flushTrayBacklog);
+}
+
+NotificationCenter::~NotificationCenter()
+{
+    // The popup is a top-level window with no parent
+    delete popup;
+}
+
+void NotificationCenter::notify(const QString &contactName, const QString &message)
+{
+    ++counters.notifications;
+
+    Pending &entry = pending[contactName];
+    if (entry.count == 0) {
+        pendingOrder.append(contactName);
+    }
+    ++entry.count;
+    entry.lastMessage = message;
+
+    // The first message of a burst starts the window; later ones join it
+    if (!aggregationTimer->isActive()) {
+        aggregationTimer->start();
+    }
+}
+
+void NotificationCenter::clearContact(const QString &contactName)
+{
+    if (pending.remove(contactName) > 0) {
+        pendingOrder.removeAll(contactName);
+    }
+}
+
+void NotificationCenter::flush()
+{
+    if (pendingOrder.isEmpty()) return;
+
+    int total = 0;
+    for (const QString &contact : std::as_const(pendingOrder)) {
+        total += pending[contact].count;
+    }
+
+    QString title;
+    QString body;
+    if (pendingOrder.size() == 1) {
+        const QString &contact = pendingOrder.first();
+        const Pending &entry = pending[contact];
+        title = entry.count == 1 ? QString("%1 sent a message").arg(contact)
+                                 : QString("%1 new messages from %2").arg(entry.count).arg(contact);
+        body = elide(entry.lastMessage);
+    } else {
+        title = QString("%1 new messages from %2 chats").arg(total).arg(pendingOrder.size());
+        QStringList lines;
+        for (int i = 0; i < pendingOrder.size() && i < 3; ++i) {
+            const QString &contact = pendingOrder[i];
+            lines.append(QString("%1 (%2)").arg(contact).arg(pending[contact].count));
+        }
+        if (pendingOrder.size() > 3) {
+            lines.append(QString("and %1 more").arg(pendingOrder.size() - 3));
+        }
+        body = lines.join(", ");
+    }
+
+    pending.clear();
+    pendingOrder.clear();
+
+    showPopup(title, body);
+
+    trayBacklog += total;
+    showTrayMessage(title, body);
+}
+
+void NotificationCenter::ensurePopup()
+{
+    if (popup) return;
+
+    // Created once and reused for every notification
+    popup = new QFrame(nullptr, Qt::Tool | Qt::WindowStaysOnTopHint | Qt::FramelessWindowHint);
+    popup->setWindowTitle("New Message");
+    popup->setAttribute(Qt::WA_ShowWithoutActivating);
+    popup->setFixedSize(300, 100);
+    popup->setObjectName("notificationPopup");
+    popup->setStyleSheet(
+        "#notificationPopup {"
+        "    background: white;"
+        "    border: 2px solid #667eea;"
+        "    border-radius: 10px;"
+        "}"
+        );
+
+    QVBoxLayout *layout = new QVBoxLayout(popup);
+    layout->setContentsMargins(15, 10, 15, 10);
+
+    popupTitle = new QLabel();
+    popupTitle->setStyleSheet("font-weight: bold; color: #667eea; font-size: 14px;");
+
+    popupBody = new QLabel();
+    popupBody->setWordWrap(true);
+    popupBody->setStyleSheet("color: #495057; font-size: 12px;");
+
+    layout->addWidget(popupTitle);
+    layout->addWidget(popupBody);
+
+    connect(popupHideTimer, &QTimer::timeout, popup, &QWidget::hide);
+    ++counters.windowsCreated;
+}
+
+void NotificationCenter::showPopup(const QString &title, const QString &body)
+{
+    ensurePopup();
+
+    popupTitle->setText(title);
+    popupBody->setText(body);
+
+    // Position at bottom-right corner
+    QScreen *screen = QApplication::primaryScreen();
+    QRect screenGeometry = screen->availableGeometry();
+    popup->move(screenGeometry.width() - 320, screenGeometry.height() - 120);
+
+    popup->show();
+    popupHideTimer->start();
+    ++counters.popupsShown;
+}
+
+void NotificationCenter::showTrayMessage(const QString &title, const QString &body)
+{
+    if (!trayIcon || !trayIcon->isVisible()) {
+        trayBacklog = 0;
+        return;
+    }
+
+    if (sinceTrayMessage.isValid() && sinceTrayMessage.elapsed() < TrayIntervalMs) {
+        // Announced with the next balloon instead
+        ++counters.trayMessagesSuppressed;
+        // One timer however many balloons are held back
+        if (!trayBacklogTimer->isActive()) {
+            trayBacklogTimer->start(TrayIntervalMs - int(sinceTrayMessage.elapsed()));
+        }
+        return;
+    }
+
+    trayIcon->showMessage(title, body, QSystemTrayIcon::Information, PopupVisibleMs);
+    sinceTrayMessage.start();
+    trayBacklog = 0;
+    ++counters.trayMessages;
+}
+
+void NotificationCenter::flushTrayBacklog()
+{
+    if (trayBacklog > 0) {
+        showTrayMessage(QString("%1 new messages").arg(trayBacklog),
+                        QString("Open the chat window to read them"));
+    }
+}
+
+QString NotificationCenter::elide(const QString &message)
+{
+    return message.length() > 50 ? message.left(47) + "..." : message;
+}
@@ -0,0 +1,76 @@
+#ifndef NOTIFICATIONCENTER_H
+#define NOTIFICATIONCENTER_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+
+class QFrame;
+class QLabel;
+class QTimer;
+class QSystemTrayIcon;
+
+// Collects incoming-message notifications and shows them through a single
+// reused popup. Messages arriving close together are aggregated per contact
+// ("5 new messages from X"), and tray balloons are rate limited.
+class NotificationCenter : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        int notifications = 0;    // notify() calls
+        int popupsShown = 0;      // Popup refreshes after aggregation
+        int windowsCreated = 0;   // Top-level windows ever created
+        int trayMessages = 0;     // Tray balloons shown
+        int trayMessagesSuppressed = 0;
+    };
+
+    explicit NotificationCenter(QSystemTrayIcon *trayIcon, QObject *parent = nullptr);
+    ~NotificationCenter();
+
+    void notify(const QString &contactName, const QString &message);
+    // Drops anything pending for a chat the user just opened
+    void clearContact(const QString &contactName);
+
+    const Stats &stats() const { return counters; }
+
+    // Messages within this window are shown together
+    static const int AggregationMs = 400;
+    static const int PopupVisibleMs = 3000;
+    // At most one tray balloon per interval; the rest fold into the next one
+    static const int TrayIntervalMs = 5000;
+
+private slots:
+    void flush();
+    void flushTrayBacklog();
+
+private:
+    struct Pending {
+        int count = 0;
+        QString lastMessage;
+    };
+
+    void ensurePopup();
+    void showPopup(const QString &title, const QString &body);
+    void showTrayMessage(const QString &title, const QString &body);
+    static QString elide(const QString &message);
+
+    QSystemTrayIcon *trayIcon;
+    QHash<QString, Pending> pending;
+    QStringList pendingOrder;      // Contacts in arrival order
+    QTimer *aggregationTimer;
+
+    QFrame *popup;
+    QLabel *popupTitle;
+    QLabel *popupBody;
+    QTimer *popupHideTimer;
+
+    QElapsedTimer sinceTrayMessage;
+    int trayBacklog;               // Messages not yet announced in the tray
+    QTimer *trayBacklogTimer;      // Announces the backlog once the interval is over
+
+    Stats counters;
+};
+
+#endif // NOTIFICATIONCENTER_H
@@ -0,0 +1,60 @@
+#include "perfoverlay.h"
+#include "perfmonitor.h"
+#include <QTimer>
+
+PerfOverlay::PerfOverlay(QWidget *parent)
+    : QLabel(parent)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setTextFormat(Qt::PlainText);
+    setAlignment(Qt::AlignTop | Qt::AlignLeft);
+    setStyleSheet(
+        "QLabel {"
+        "    background: rgba(33, 37, 41, 200);"
+        "    color: #f8f9fa;"
+        "    font-family: Consolas, 'Courier New', monospace;"
+        "    font-size: 11px;"
+        "    border-radius: 6px;"
+        "    padding: 8px;"
+        "}"
+        );
+    hide();
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(500);
+    connect(refreshTimer, &QTimer::timeout, this, &PerfOverlay::refresh);
+}
+
+void PerfOverlay::toggle()
+{
+    setVisible(!isVisible());
+}
+
+void PerfOverlay::showEvent(QShowEvent *event)
+{
+    QLabel::showEvent(event);
+    refresh();
+    refreshTimer->start();
+}
+
+void PerfOverlay::hideEvent(QHideEvent *event)
+{
+    QLabel::hideEvent(event);
+    refreshTimer->stop();
+}
+
+void PerfOverlay::refresh()
+{
+    QStringList lines = PerfMonitor::instance().summary();
+    setText(lines.isEmpty() ? QString("No timings recorded yet") : lines.join("\n"));
+    placeInParent();
+    raise();
+}
+
+void PerfOverlay::placeInParent()
+{
+    adjustSize();
+    if (parentWidget()) {
+        move(parentWidget()->width() - width() - 12, 12);
+    }
+}
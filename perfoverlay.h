@@ -0,0 +1,30 @@
+#ifndef PERFOVERLAY_H
+#define PERFOVERLAY_H
+
+#include <QLabel>
+
+class QTimer;
+
+// Translucent panel listing the PerfMonitor histograms, refreshed while visible
+class PerfOverlay : public QLabel
+{
+    Q_OBJECT
+public:
+    explicit PerfOverlay(QWidget *parent);
+
+    void toggle();
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+
+private:
+    void placeInParent();
+
+    QTimer *refreshTimer;
+};
+
+#endif // PERFOVERLAY_H
@@ -0,0 +1,38 @@
+#include "searchhitnavigator.h"
+
+SearchHitNavigator::SearchHitNavigator()
+    : cursor(-1)
+{
+}
+
+void SearchHitNavigator::setHits(const QVector<Hit> &newHits, int current)
+{
+    hits = newHits;
+    cursor = hits.isEmpty() ? -1 : qBound(0, current, int(hits.size()) - 1);
+}
+
+void SearchHitNavigator::clear()
+{
+    hits.clear();
+    cursor = -1;
+}
+
+const SearchHitNavigator::Hit *SearchHitNavigator::next()
+{
+    if (hits.isEmpty()) return nullptr;
+    cursor = (cursor + 1) % hits.size();
+    return &hits[cursor];
+}
+
+const SearchHitNavigator::Hit *SearchHitNavigator::previous()
+{
+    if (hits.isEmpty()) return nullptr;
+    cursor = (cursor - 1 + hits.size()) % hits.size();
+    return &hits[cursor];
+}
+
+QString SearchHitNavigator::positionText() const
+{
+    if (hits.isEmpty()) return QString("No matches");
+    return QString("%1 of %2").arg(cursor + 1).arg(hits.size());
+}
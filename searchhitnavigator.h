@@ -0,0 +1,45 @@
+#ifndef SEARCHHITNAVIGATOR_H
+#define SEARCHHITNAVIGATOR_H
+
+#include <QString>
+#include <QVector>
+
+// Ordered matches of one search in one conversation, with a cursor for
+// next/previous. Hits refer to the message's position in the history and
+// its ID, not to a widget, so they stay valid for pages that only create
+// bubbles near the viewport.
+class SearchHitNavigator
+{
+public:
+    struct Hit {
+        int messageIndex;    // Position in the conversation's history
+        QString messageId;
+        int start;           // Character offset of the match in the text
+        int length;
+    };
+
+    SearchHitNavigator();
+
+    // Hits must be in conversation order; the cursor starts on `current`
+    void setHits(const QVector<Hit> &hits, int current);
+    void clear();
+
+    bool isEmpty() const { return hits.isEmpty(); }
+    int count() const { return hits.size(); }
+    int currentIndex() const { return cursor; }
+    const Hit *current() const { return cursor >= 0 ? &hits[cursor] : nullptr; }
+    const QVector<Hit> &allHits() const { return hits; }
+
+    // Step the cursor, wrapping around at either end
+    const Hit *next();
+    const Hit *previous();
+
+    // "3 of 120", or "No matches"
+    QString positionText() const;
+
+private:
+    QVector<Hit> hits;
+    int cursor;
+};
+
+#endif // SEARCHHITNAVIGATOR_H
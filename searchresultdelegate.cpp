@@ -0,0 +1,84 @@
+#include "searchresultdelegate.h"
+#include <QPainter>
+#include <QFontMetrics>
+#include <QTextLayout>
+#include <QPoint>
+
+SearchResultDelegate::SearchResultDelegate(QObject *parent)
+    : QStyledItemDelegate(parent)
+{
+}
+
+void SearchResultDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                 const QModelIndex &index) const
+{
+    painter->save();
+
+    QRect rect = option.rect;
+    if (option.state & QStyle::State_Selected) {
+        painter->fillRect(rect, QColor("#e9ecef"));
+    } else if (option.state & QStyle::State_MouseOver) {
+        painter->fillRect(rect, QColor("#f8f9fa"));
+    }
+
+    // Separator
+    painter->setPen(QColor("#f1f3f4"));
+    painter->drawLine(rect.bottomLeft(), rect.bottomRight());
+
+    QRect content = rect.adjusted(20, 6, -20, -6);
+
+    // Contact and time
+    QFont titleFont = option.font;
+    titleFont.setPixelSize(11);
+    painter->setFont(titleFont);
+    painter->setPen(QColor("#6c757d"));
+    QRect titleRect(content.left(), content.top(), content.width(), 16);
+    painter->drawText(titleRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      QFontMetrics(titleFont).elidedText(index.data(TitleRole).toString(),
+                                                         Qt::ElideRight, titleRect.width()));
+
+    // Snippet, one line, matches in bold
+    QFont snippetFont = option.font;
+    snippetFont.setPixelSize(13);
+
+    QTextCharFormat matchFormat;
+    matchFormat.setFontWeight(QFont::Bold);
+    matchFormat.setForeground(QColor("#667eea"));
+    matchFormat.setBackground(QColor("#fff3cd"));
+
+    QVector<QTextLayout::FormatRange> formats;
+    const QVariantList highlights = index.data(HighlightsRole).toList();
+    for (const QVariant &value : highlights) {
+        QPoint range = value.toPoint();
+        QTextLayout::FormatRange format;
+        format.start = range.x();
+        format.length = range.y();
+        format.format = matchFormat;
+        formats.append(format);
+    }
+
+    QTextLayout layout(index.data(SnippetRole).toString(), snippetFont);
+    QTextOption textOption;
+    textOption.setWrapMode(QTextOption::NoWrap);
+    layout.setTextOption(textOption);
+    layout.setFormats(formats);
+    layout.beginLayout();
+    QTextLine line = layout.createLine();
+    if (line.isValid()) {
+        line.setLineWidth(content.width());
+    }
+    layout.endLayout();
+
+    QRect snippetRect(content.left(), titleRect.bottom() + 4, content.width(), content.bottom() - titleRect.bottom() - 4);
+    painter->setClipRect(snippetRect);
+    painter->setPen(QColor("#495057"));
+    layout.draw(painter, snippetRect.topLeft());
+
+    painter->restore();
+}
+
+QSize SearchResultDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    Q_UNUSED(index);
+    return QSize(option.rect.width(), RowHeight);
+}
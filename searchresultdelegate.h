@@ -0,0 +1,30 @@
+#ifndef SEARCHRESULTDELEGATE_H
+#define SEARCHRESULTDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+// Draws a global search result: contact and time on top, then a one-line
+// snippet of the message with the matched words highlighted. Items carry
+// their data in the roles below; the snippet is built once per shown result.
+class SearchResultDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        ContactRole = Qt::UserRole,
+        MessageIdRole,
+        TitleRole,
+        SnippetRole,
+        HighlightsRole      // QVariantList of QPoint(start, length) into the snippet
+    };
+
+    explicit SearchResultDelegate(QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option,
+               const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    static const int RowHeight = 52;
+};
+
+#endif // SEARCHRESULTDELEGATE_H
@@ -0,0 +1,639 @@
+#include "chatserver.h"
+#include "conversationstore.h"
+#include "chatdataloader.h"
+#include "perfmonitor.h"
+#include "groupfanout.h"
+#include "workstealingpool.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QThread>
+#include <QSet>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QStandardPaths>
+#include <QDebug>
+#include <algorithm>
+
+ChatServer::ChatServer(QObject *parent)
+    : QObject(parent), localServer(nullptr), tcpServer(nullptr), routed(0)
+{
+    // Like MessageService, a burst of messages is written once
+    saveTimer = new QTimer(this);
+    saveTimer->setSingleShot(true);
+    saveTimer->setInterval(500);
+    connect(saveTimer, &QTimer::timeout, this, &ChatServer::saveDirty);
+
+    // The server thread takes part in every fan-out, so one fewer worker
+    pool = new WorkStealingPool(QThread::idealThreadCount() - 1);
+    fanout = new GroupFanout(pool);
+    loadGroups();
+}
+
+ChatServer::~ChatServer()
+{
+    for (Connection *connection : connections) {
+        connection->socket->disconnect(this);
+        delete connection;
+    }
+    connections.clear();
+
+    for (Account *account : accounts) {
+        if (account->loader) {
+            // Saving a half-loaded history would drop the rest of it
+            delete account->loader;
+        } else if (account->dirty && !account->store->saveChats()) {
+            qDebug() << "Could not write" << account->store->chatsFilePath();
+        }
+        delete account->store;
+        delete account;
+    }
+    accounts.clear();
+
+    delete fanout;
+    delete pool;
+}
+
+bool ChatServer::listenLocal(const QString &name)
+{
+    if (!localServer) {
+        localServer = new QLocalServer(this);
+        connect(localServer, &QLocalServer::newConnection, this, [this]() {
+            while (QLocalSocket *socket = localServer->nextPendingConnection()) {
+                addConnection(socket);
+                connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+                    for (Connection *connection : connections) {
+                        if (connection->socket == socket) {
+                            onDisconnected(connection);
+                            break;
+                        }
+                    }
+                });
+            }
+        });
+    }
+
+    // A socket left behind by a server that did not shut down cleanly
+    QLocalServer::removeServer(name);
+    if (!localServer->listen(name)) {
+        qDebug() << "Could not listen on" << name << ":" << localServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ChatServer::listenTcp(quint16 port)
+{
+    if (!tcpServer) {
+        tcpServer = new QTcpServer(this);
+        connect(tcpServer, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = tcpServer->nextPendingConnection()) {
+                // Frames are small and latency is what clients measure
+                socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+                addConnection(socket);
+                connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                    for (Connection *connection : connections) {
+                        if (connection->socket == socket) {
+                            onDisconnected(connection);
+                            break;
+                        }
+                    }
+                });
+            }
+        });
+    }
+
+    // Loopback only: this is a load-testing server, not a public one
+    if (!tcpServer->listen(QHostAddress::LocalHost, port)) {
+        qDebug() << "Could not listen on port" << port << ":" << tcpServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+void ChatServer::addConnection(QIODevice *socket)
+{
+    Connection *connection = new Connection;
+    connection->socket = socket;
+    connections.append(connection);
+    connect(socket, &QIODevice::readyRead, this, [this, connection]() { onReadyRead(connection); });
+}
+
+void ChatServer::onDisconnected(Connection *connection)
+{
+    connections.removeOne(connection);
+    if (Account *account = accounts.value(connection->user)) {
+        account->connections.removeOne(connection);
+        account->pendingFrames.erase(std::remove_if(account->pendingFrames.begin(), account->pendingFrames.end(),
+                                                    [connection](const QPair<Connection*, ChatProtocol::Frame> &pending) {
+                                                        return pending.first == connection;
+                                                    }),
+                                     account->pendingFrames.end());
+    }
+
+    QIODevice *socket = connection->socket;
+    socket->disconnect(this);
+    socket->close();
+    socket->deleteLater();
+    delete connection;
+}
+
+void ChatServer::onReadyRead(Connection *connection)
+{
+    connection->reader.readFrom(connection->socket);
+    ChatProtocol::FrameView view;
+    while (connection->reader.next(&view)) {
+        handle(connection, view);
+    }
+
+    if (connection->reader.hasError()) {
+        qDebug() << "Unreadable frame from" << (connection->user.isEmpty() ? QString("a new client") : connection->user)
+                 << "; disconnecting";
+        onDisconnected(connection);
+    }
+}
+
+void ChatServer::handle(Connection *connection, const ChatProtocol::FrameView &view)
+{
+    PerfScope scope(QStringLiteral("server.frame"));
+
+    if (view.op == ChatProtocol::Op::Hello) {
+        // One user per connection, named once; '#' names are groups
+        if (!connection->user.isEmpty() || view.user.isEmpty()) return;
+        if (ChatProtocol::isGroup(view.user.toString())) return;
+        connection->user = view.user.toString();
+        account(connection->user)->connections.append(connection);
+        return;
+    }
+
+    // Nothing counts before the client said who it is
+    if (connection->user.isEmpty()) return;
+
+    // The fields are stored, so this is where they are copied out of the buffer
+    ChatProtocol::Frame frame;
+    frame.op = view.op;
+    frame.contact = view.contact.toString();
+    frame.messageId = view.messageIdString();
+    frame.content = view.content.toString();
+    frame.time = view.time;
+    process(connection, frame);
+}
+
+void ChatServer::process(Connection *connection, const ChatProtocol::Frame &frame)
+{
+    // Until the history is in, a retried Send can't be told from a new one
+    // and a Sync can't be answered
+    Account *account = this->account(connection->user);
+    if (account->loader) {
+        account->pendingFrames.append(qMakePair(connection, frame));
+        return;
+    }
+
+    if (frame.op == ChatProtocol::Op::Sync) {
+        sync(connection, frame);
+        return;
+    }
+    route(connection, frame);
+}
+
+bool ChatServer::isRetry(Connection *connection, Account *sender, const ChatProtocol::Frame &frame)
+{
+    if (!sender->sentIds.contains(frame.messageId)) {
+        sender->sentIds.insert(frame.messageId);
+        return false;
+    }
+
+    // Acknowledged without a number; the client's Sync on the same
+    // connection has brought it up to date already
+    ChatProtocol::Frame ack;
+    ack.op = ChatProtocol::Op::Ack;
+    ack.messageId = frame.messageId;
+    send(connection, ack);
+    return true;
+}
+
+void ChatServer::route(Connection *connection, const ChatProtocol::Frame &frame)
+{
+    const QString &from = connection->user;
+    const QString &to = frame.contact;
+    if (to.isEmpty() || frame.messageId.isEmpty()) return;
+    if (ChatProtocol::isGroup(to)) {
+        routeGroup(connection, frame);
+        return;
+    }
+
+    Account *sender = account(from);
+    Account *recipient = to != from ? account(to) : nullptr;
+
+    switch (frame.op) {
+    case ChatProtocol::Op::Send: {
+        if (isRetry(connection, sender, frame)) return;
+
+        Message msg(from, frame.content, QDateTime::fromMSecsSinceEpoch(frame.time), true);
+        msg.id = frame.messageId;
+        sender->store->appendMessage(to, msg);
+        markDirty(sender);
+
+        ChatProtocol::Frame ack;
+        ack.op = ChatProtocol::Op::Ack;
+        ack.messageId = frame.messageId;
+        ack.sequence = sender->store->sequence(to);
+        send(connection, ack);
+
+        if (recipient) {
+            msg.isCurrentUser = false;
+            recipient->store->appendMessage(from, msg);
+            markDirty(recipient);
+
+            ChatProtocol::Frame delivery = frame;
+            delivery.op = ChatProtocol::Op::Deliver;
+            delivery.contact = from;
+            delivery.sequence = recipient->store->sequence(from);
+            deliver(to, delivery);
+        }
+        break;
+    }
+    case ChatProtocol::Op::Edit: {
+        // Only the author can edit
+        const Message *own = sender->store->findMessage(to, frame.messageId);
+        if (!own || !own->isCurrentUser) return;
+
+        sender->store->editMessage(to, frame.messageId, frame.content);
+        markDirty(sender);
+        if (recipient && recipient->store->editMessage(from, frame.messageId, frame.content)) {
+            markDirty(recipient);
+            ChatProtocol::Frame edit = frame;
+            edit.contact = from;
+            edit.sequence = recipient->store->sequence(from);
+            deliver(to, edit);
+        }
+        break;
+    }
+    case ChatProtocol::Op::Delete: {
+        const Message *own = sender->store->findMessage(to, frame.messageId);
+        if (!own) return;
+
+        // Deleting your own message deletes it for both; a received one only for you
+        bool forEveryone = own->isCurrentUser;
+        sender->store->removeMessage(to, frame.messageId);
+        markDirty(sender);
+        if (forEveryone && recipient && recipient->store->removeMessage(from, frame.messageId)) {
+            markDirty(recipient);
+            ChatProtocol::Frame removal = frame;
+            removal.contact = from;
+            removal.sequence = recipient->store->sequence(from);
+            deliver(to, removal);
+        }
+        break;
+    }
+    default:
+        // Deliver and Ack only go from the server to clients, and Group names a group
+        return;
+    }
+    ++routed;
+}
+
+void ChatServer::routeGroup(Connection *connection, const ChatProtocol::Frame &frame)
+{
+    const QString &from = connection->user;
+    const QString &group = frame.contact;
+    auto existing = groups.constFind(group);
+
+    if (frame.op == ChatProtocol::Op::Group) {
+        // An existing group is changed only by one of its members
+        if (existing != groups.constEnd() && !existing.value().contains(from)) return;
+
+        QStringList members;
+        QSet<QString> seen;
+        for (const QString &line : frame.content.split('\n')) {
+            QString name = line.trimmed();
+            if (name.isEmpty() || ChatProtocol::isGroup(name) || seen.contains(name)) continue;
+            seen.insert(name);
+            members.append(name);
+        }
+        if (!seen.contains(from)) {
+            members.append(from);
+        }
+        groups.insert(group, members);
+        saveGroups();
+
+        ChatProtocol::Frame ack;
+        ack.op = ChatProtocol::Op::Ack;
+        ack.messageId = frame.messageId;
+        send(connection, ack);
+        ++routed;
+        return;
+    }
+
+    // Only members write to a group, and it must exist
+    if (existing == groups.constEnd() || !existing.value().contains(from)) return;
+    const QStringList members = existing.value();
+
+    switch (frame.op) {
+    case ChatProtocol::Op::Send: {
+        // Every member's copy went in with the author's, so the author's IDs decide
+        if (isRetry(connection, account(from), frame)) return;
+
+        Message msg(from, frame.content, QDateTime::fromMSecsSinceEpoch(frame.time), false);
+        msg.id = frame.messageId;
+
+        QVector<GroupFanout::Member> targets;
+        targets.reserve(members.size());
+        for (const QString &member : members) {
+            targets.append(GroupFanout::Member{account(member)->store, member == from});
+        }
+        {
+            PerfScope scope(QStringLiteral("server.fanout"));
+            fanout->deliver(group, msg, targets);
+        }
+        for (const QString &member : members) {
+            markDirty(accounts.value(member));
+        }
+
+        ChatProtocol::Frame ack;
+        ack.op = ChatProtocol::Op::Ack;
+        ack.messageId = frame.messageId;
+        ack.sequence = accounts.value(from)->store->sequence(group);
+        send(connection, ack);
+
+        ChatProtocol::Frame delivery = frame;
+        delivery.op = ChatProtocol::Op::Deliver;
+        delivery.user = from;
+        deliverToMembers(members, from, delivery);
+        break;
+    }
+    case ChatProtocol::Op::Edit: {
+        const Message *own = account(from)->store->findMessage(group, frame.messageId);
+        if (!own || !own->isCurrentUser) return;
+
+        for (const QString &member : members) {
+            Account *memberAccount = account(member);
+            if (memberAccount->store->editMessage(group, frame.messageId, frame.content)) {
+                markDirty(memberAccount);
+            }
+        }
+        deliverToMembers(members, from, frame);
+        break;
+    }
+    case ChatProtocol::Op::Delete: {
+        Account *author = account(from);
+        const Message *own = author->store->findMessage(group, frame.messageId);
+        if (!own) return;
+
+        // As for two people: your own message goes for everyone, a received one only for you
+        if (!own->isCurrentUser) {
+            author->store->removeMessage(group, frame.messageId);
+            markDirty(author);
+            break;
+        }
+        for (const QString &member : members) {
+            Account *memberAccount = account(member);
+            if (memberAccount->store->removeMessage(group, frame.messageId)) {
+                markDirty(memberAccount);
+            }
+        }
+        deliverToMembers(members, from, frame);
+        break;
+    }
+    default:
+        return;
+    }
+    ++routed;
+}
+
+void ChatServer::sync(Connection *connection, const ChatProtocol::Frame &request)
+{
+    Account *account = this->account(connection->user);
+    PerfScope scope(QStringLiteral("server.sync"));
+    ConversationStore *store = account->store;
+
+    // The client's latest sequence number per conversation
+    QHash<QString, qint64> seen;
+    for (const QString &line : request.content.split('\n', Qt::SkipEmptyParts)) {
+        int tab = line.lastIndexOf('\t');
+        if (tab > 0) {
+            seen.insert(line.left(tab), line.mid(tab + 1).toLongLong());
+        }
+    }
+    // Another store's ID, or none from a client with nothing saved: its
+    // numbers mean nothing here, so everything is sent whole for it to merge
+    const bool sameLog = request.messageId == store->changeLogId();
+
+    ChatProtocol::Frame start;
+    start.op = ChatProtocol::Op::Sync;
+    start.messageId = store->changeLogId();
+    writer.append(start);
+
+    QList<ConversationStore::Operation> missed;
+    const QMap<QString, QList<Message>> &conversations = store->conversations();
+    for (auto it = conversations.constBegin(); it != conversations.constEnd(); ++it) {
+        const QString &contact = it.key();
+        qint64 current = store->sequence(contact);
+
+        if (sameLog && store->operationsSince(contact, seen.value(contact, 0), &missed)) {
+            for (const ConversationStore::Operation &operation : std::as_const(missed)) {
+                ChatProtocol::Frame change;
+                change.contact = contact;
+                change.messageId = operation.message.id;
+                change.sequence = operation.sequence;
+                switch (operation.kind) {
+                case ConversationStore::Operation::Added:
+                    change.op = ChatProtocol::Op::Deliver;
+                    change.content = operation.message.content;
+                    change.time = operation.message.timestamp.toMSecsSinceEpoch();
+                    // The author, when it is not simply the contact
+                    if (operation.message.sender != contact) change.user = operation.message.sender;
+                    break;
+                case ConversationStore::Operation::Edited:
+                    change.op = ChatProtocol::Op::Edit;
+                    change.content = operation.message.content;
+                    break;
+                case ConversationStore::Operation::Removed:
+                    change.op = ChatProtocol::Op::Delete;
+                    break;
+                }
+                writer.append(change);
+            }
+            continue;
+        }
+
+        // Sent whole: every message, then the Sync that closes it
+        for (const Message &msg : it.value()) {
+            ChatProtocol::Frame whole;
+            whole.op = ChatProtocol::Op::Deliver;
+            whole.contact = contact;
+            whole.messageId = msg.id;
+            whole.content = msg.content;
+            whole.time = msg.timestamp.toMSecsSinceEpoch();
+            if (msg.sender != contact) whole.user = msg.sender;
+            whole.reset = true;
+            writer.append(whole);
+        }
+        ChatProtocol::Frame end;
+        end.op = ChatProtocol::Op::Sync;
+        end.contact = contact;
+        end.sequence = current;
+        end.reset = true;
+        writer.append(end);
+    }
+    writer.flushTo(connection->socket);
+}
+
+void ChatServer::send(Connection *connection, const ChatProtocol::Frame &frame)
+{
+    writer.append(frame);
+    writer.flushTo(connection->socket);
+}
+
+void ChatServer::deliver(const QString &user, const ChatProtocol::Frame &frame)
+{
+    Account *account = accounts.value(user);
+    if (!account || account->connections.isEmpty()) return;
+
+    // Encoded once for all of the user's connections
+    writer.append(frame);
+    for (Connection *connection : account->connections) {
+        connection->socket->write(writer.data());
+    }
+    writer.clear();
+}
+
+void ChatServer::deliverToMembers(const QStringList &members, const QString &except, const ChatProtocol::Frame &frame)
+{
+    // Encoded with a sequence that is rewritten for each member
+    ChatProtocol::Frame numbered = frame;
+    numbered.sequence = 1;
+    writer.append(numbered);
+    for (const QString &member : members) {
+        if (member == except) continue;
+        Account *account = accounts.value(member);
+        if (!account || account->connections.isEmpty()) continue;
+        writer.setLastSequence(account->store->sequence(frame.contact));
+        for (Connection *connection : account->connections) {
+            connection->socket->write(writer.data());
+        }
+    }
+    writer.clear();
+}
+
+QString ChatServer::groupsFilePath()
+{
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    return QDir(dataDir).filePath("groups.json");
+}
+
+void ChatServer::loadGroups()
+{
+    QFile file(groupsFilePath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+
+    QJsonObject groupsObject = QJsonDocument::fromJson(file.readAll()).object();
+    for (auto it = groupsObject.constBegin(); it != groupsObject.constEnd(); ++it) {
+        QStringList members;
+        for (const QJsonValue &member : it.value().toArray()) {
+            members.append(member.toString());
+        }
+        groups.insert(it.key(), members);
+    }
+}
+
+void ChatServer::saveGroups() const
+{
+    QJsonObject groupsObject;
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it) {
+        groupsObject[it.key()] = QJsonArray::fromStringList(it.value());
+    }
+
+    QFile file(groupsFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Could not write" << groupsFilePath();
+        return;
+    }
+    file.write(QJsonDocument(groupsObject).toJson());
+}
+
+ChatServer::Account *ChatServer::account(const QString &user)
+{
+    Account *&entry = accounts[user];
+    if (entry) return entry;
+
+    entry = new Account;
+    entry->store = new ConversationStore(user);
+    entry->store->setChangeLogLimit(ChangeLogLimit);
+
+    // Loaded as the app loads it; messages routed meanwhile come after the loaded history
+    ChatDataLoader *loader = new ChatDataLoader(user, this);
+    entry->loader = loader;
+    ConversationStore *store = entry->store;
+    QSet<QString> *sentIds = &entry->sentIds;
+    connect(loader, &ChatDataLoader::indexLoaded, this, [store](MessageSearchIndex *index, const SearchIndexStore::State &state) {
+        store->adoptSearchIndex(index, state);
+    });
+    connect(loader, &ChatDataLoader::chatsLoaded, this, [store, sentIds](const ConversationBatch &conversations) {
+        for (const auto &conversation : conversations) {
+            store->mergeLoadedConversation(conversation.first, conversation.second);
+            for (const Message &msg : conversation.second) {
+                if (msg.isCurrentUser) sentIds->insert(msg.id);
+            }
+        }
+    });
+    connect(loader, &ChatDataLoader::finished, this, [this, user]() { onHistoryLoaded(user); });
+    loader->start();
+    return entry;
+}
+
+void ChatServer::onHistoryLoaded(const QString &user)
+{
+    Account *account = accounts.value(user);
+    if (!account || !account->loader) return;
+
+    // The numbers clients hold go on from where the last run left them;
+    // without a saved log they get a new ID and catch up whole
+    QByteArray chatsDigest = account->loader->chatsDigest();
+    if (!chatsDigest.isEmpty() && !account->store->restoreChangeLog(chatsDigest)) {
+        qDebug() << "No change log saved for" << user << "; clients catch up whole";
+    }
+    account->loader->deleteLater();
+    account->loader = nullptr;
+
+    const QList<QPair<Connection*, ChatProtocol::Frame>> pendingFrames = account->pendingFrames;
+    account->pendingFrames.clear();
+    for (const auto &pending : pendingFrames) {
+        process(pending.first, pending.second);
+    }
+
+    if (account->dirty) {
+        saveTimer->start();
+    } else if (!account->store->isSearchIndexFromDisk()) {
+        // As in MessageService: the chats file is unchanged, so stamp the rebuilt index with it
+        account->store->commitSearchIndex();
+    }
+}
+
+void ChatServer::markDirty(Account *account)
+{
+    account->dirty = true;
+    if (!saveTimer->isActive()) {
+        saveTimer->start();
+    }
+}
+
+void ChatServer::saveDirty()
+{
+    PerfScope scope(QStringLiteral("server.save"));
+
+    for (Account *account : std::as_const(accounts)) {
+        // Written once its history has loaded; writing earlier would replace the file
+        if (!account->dirty || account->loader) continue;
+        account->dirty = false;
+        if (!account->store->saveChats()) {
+            qDebug() << "Could not write" << account->store->chatsFilePath();
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef CHATSERVER_H
+#define CHATSERVER_H
+
+#include "chatprotocol.h"
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+
+class ConversationStore;
+class ChatDataLoader;
+class GroupFanout;
+class WorkStealingPool;
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QTimer;
+
+// Routes messages between connected users and keeps every user's history,
+// in the same files and format the app uses (under the server's own data
+// directory). A send from A to B is stored in both histories, acknowledged
+// to A and delivered to each of B's connections; B need not be connected.
+// A Send with an ID A has sent before is a retry after a lost Ack: it is
+// acknowledged again and dropped. Nothing a user sends is handled until
+// their history has loaded.
+//
+// Groups ('#' names, see ChatProtocol) are kept in groups.json next to the
+// histories. A message to a group is added to every member's history by a
+// GroupFanout on a work-stealing pool, then delivered to the members.
+//
+// Each history keeps its last ChangeLogLimit changes per conversation, saved
+// with it so they outlast a restart. A reconnecting client's Sync is
+// answered with the changes it missed; a conversation it is too far behind
+// on, or every conversation when its numbers are from a log that was lost or
+// it has none, is sent whole instead.
+//
+// Otherwise single-threaded and event-driven: every socket is read when it
+// signals readyRead and written without waiting, so one thread serves every
+// client.
+class ChatServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChatServer(QObject *parent = nullptr);
+    // Saves every changed history
+    ~ChatServer();
+
+    bool listenLocal(const QString &name);
+    bool listenTcp(quint16 port);
+
+    int connectionCount() const { return connections.size(); }
+    qint64 framesRouted() const { return routed; }
+
+    // Changes kept per conversation for clients catching up
+    static const int ChangeLogLimit = 1000;
+
+private:
+    struct Connection {
+        QIODevice *socket = nullptr;
+        QString user;            // Empty until Hello
+        ChatProtocol::Reader reader;
+    };
+
+    struct Account {
+        ConversationStore *store = nullptr;
+        ChatDataLoader *loader = nullptr;   // Until the history has loaded
+        bool dirty = false;
+        QList<Connection*> connections;
+        // What the user sent while the history was loading, handled in
+        // order once it has
+        QList<QPair<Connection*, ChatProtocol::Frame>> pendingFrames;
+        // Every message ID the user has sent, so a Send retried after a
+        // lost Ack is acknowledged again but not stored twice
+        QSet<QString> sentIds;
+    };
+
+    void addConnection(QIODevice *socket);
+    void onReadyRead(Connection *connection);
+    void onDisconnected(Connection *connection);
+    void handle(Connection *connection, const ChatProtocol::FrameView &view);
+    void process(Connection *connection, const ChatProtocol::Frame &frame);
+    // True, with the Send acknowledged again, if it was stored already;
+    // otherwise records its ID
+    bool isRetry(Connection *connection, Account *sender, const ChatProtocol::Frame &frame);
+    void route(Connection *connection, const ChatProtocol::Frame &frame);
+    void routeGroup(Connection *connection, const ChatProtocol::Frame &frame);
+    void sync(Connection *connection, const ChatProtocol::Frame &request);
+    void send(Connection *connection, const ChatProtocol::Frame &frame);
+    // To every connection of `user`
+    void deliver(const QString &user, const ChatProtocol::Frame &frame);
+    // To every connection of every member but `except`, encoded once and
+    // numbered in each member's sequence
+    void deliverToMembers(const QStringList &members, const QString &except, const ChatProtocol::Frame &frame);
+
+    static QString groupsFilePath();
+    void loadGroups();
+    void saveGroups() const;
+
+    // Created and loading on first use
+    Account *account(const QString &user);
+    void onHistoryLoaded(const QString &user);
+    void markDirty(Account *account);
+    void saveDirty();
+
+    QLocalServer *localServer;
+    QTcpServer *tcpServer;
+    QList<Connection*> connections;
+    QHash<QString, Account*> accounts;
+    QHash<QString, QStringList> groups;     // Group name to member names
+    WorkStealingPool *pool;
+    GroupFanout *fanout;
+    QTimer *saveTimer;
+    qint64 routed;
+    // Shared by every connection; emptied after each write
+    ChatProtocol::Writer writer;
+};
+
+#endif // CHATSERVER_H
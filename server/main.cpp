@@ -0,0 +1,50 @@
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+#include "chatserver.h"
+#include "perfmonitor.h"
+
+// chatsimserver [--listen <name>] [--port <n>] [--stats <seconds>]
+// Serves clients on a local socket (default "chatsim") and, with --port, on
+// loopback TCP too. Point the app at it with CHATSIM_SERVER=<name> or
+// CHATSIM_SERVER=tcp:<port>.
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Histories go under the server's own data directory, apart from the app's
+    app.setApplicationName("chatsimserver");
+
+    QStringList args = app.arguments();
+    auto option = [&args](const QString &name, const QString &defaultValue) {
+        int index = args.indexOf(name);
+        return index >= 0 && index + 1 < args.size() ? args[index + 1] : defaultValue;
+    };
+
+    ChatServer server;
+    QString name = option("--listen", ChatProtocol::DefaultServer);
+    if (!server.listenLocal(name)) {
+        return 1;
+    }
+    int port = option("--port", "0").toInt();
+    if (port > 0 && !server.listenTcp(quint16(port))) {
+        return 1;
+    }
+    qDebug().noquote() << QString("Listening on %1%2").arg(name).arg(port > 0 ? QString(" and tcp:%1").arg(port) : QString());
+
+    // Periodic counters and per-operation timings
+    QTimer stats;
+    int statsSeconds = option("--stats", "0").toInt();
+    if (statsSeconds > 0) {
+        QObject::connect(&stats, &QTimer::timeout, [&server]() {
+            qDebug().noquote() << QString("%1 connections, %2 frames routed")
+                                      .arg(server.connectionCount())
+                                      .arg(server.framesRouted());
+            for (const QString &line : PerfMonitor::instance().summary()) {
+                qDebug().noquote() << line;
+            }
+        });
+        stats.start(statsSeconds * 1000);
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,17 @@
+# chatsimserver: routes and stores messages for app instances connected over
+# a local socket or loopback TCP
+QT = core network
+
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+TARGET = chatsimserver
+
+include(../chatcore/chatcore.pri)
+
+SOURCES += \
+    chatserver.cpp \
+    main.cpp
+
+HEADERS += \
+    chatserver.h
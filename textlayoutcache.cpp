@@ -0,0 +1,92 @@
+#include "textlayoutcache.h"
+#include <QFontMetrics>
+#include <QRect>
+#include <QtGlobal>
+
+TextLayoutCache& TextLayoutCache::instance()
+{
+    static TextLayoutCache cache;
+    return cache;
+}
+
+TextLayoutCache::TextLayoutCache()
+    : entryCount(0)
+{
+}
+
+int TextLayoutCache::fontId(const QFont &font)
+{
+    QString key = font.key();
+    auto it = fontIds.constFind(key);
+    if (it != fontIds.constEnd()) {
+        return it.value();
+    }
+    int id = fontIds.size();
+    fontIds.insert(key, id);
+    return id;
+}
+
+int TextLayoutCache::height(const QString &messageId, const QString &text, const QFont &font, int fontId, int width)
+{
+    width = qMax(1, width);
+
+    auto it = entries.find(messageId);
+    if (it != entries.end() && it.value().fontId != fontId) {
+        entryCount -= it.value().layouts.size();
+        entries.erase(it);
+        it = entries.end();
+    }
+    if (it != entries.end()) {
+        // The narrowest layout measured at this width or wider still fits if its lines do
+        auto entry = it.value().layouts.lowerBound(width);
+        if (entry != it.value().layouts.end() && entry.value().usedWidth <= width) {
+            return entry.value().height;
+        }
+    }
+
+    QFontMetrics metrics(font);
+    QRect bounds = metrics.boundingRect(QRect(0, 0, width, 1 << 20),
+                                        Qt::TextWordWrap, text);
+
+    // Drop everything rather than track LRU order; a full re-measure is rare
+    if (entryCount >= MaxEntries) {
+        clear();
+    }
+
+    Entry &entry = entries[messageId];
+    entry.fontId = fontId;
+    entry.layouts.insert(width, Layout{bounds.width(), bounds.height()});
+    ++entryCount;
+    return bounds.height();
+}
+
+int TextLayoutCache::nearestHeight(const QString &messageId, int fontId, int width) const
+{
+    auto it = entries.constFind(messageId);
+    if (it == entries.constEnd() || it.value().fontId != fontId || it.value().layouts.isEmpty()) {
+        return -1;
+    }
+
+    // Prefer the next narrower layout, whose height is an upper bound
+    const QMap<int, Layout> &layouts = it.value().layouts;
+    auto entry = layouts.upperBound(width);
+    if (entry != layouts.constBegin()) {
+        --entry;
+    }
+    return entry.value().height;
+}
+
+void TextLayoutCache::invalidate(const QString &messageId)
+{
+    auto it = entries.find(messageId);
+    if (it != entries.end()) {
+        entryCount -= it.value().layouts.size();
+        entries.erase(it);
+    }
+}
+
+void TextLayoutCache::clear()
+{
+    entries.clear();
+    entryCount = 0;
+}
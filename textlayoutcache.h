@@ -0,0 +1,51 @@
+#ifndef TEXTLAYOUTCACHE_H
+#define TEXTLAYOUTCACHE_H
+
+#include <QString>
+#include <QHash>
+#include <QMap>
+#include <QFont>
+
+// Caches the wrapped height of message text per message and font. Text is
+// measured at the exact width asked for; the result is reused for any
+// narrower width that still fits its widest line, since greedy wrapping
+// breaks those lines in the same places. Small resize steps therefore
+// reuse an entry without the blank lines a rounded width would leave.
+class TextLayoutCache
+{
+public:
+    static TextLayoutCache& instance();
+
+    // Small number standing for the font; entries measured in another font are dropped
+    int fontId(const QFont &font);
+
+    // Wrapped text height at `width`, computed on a cache miss
+    int height(const QString &messageId, const QString &text, const QFont &font, int fontId, int width);
+
+    // Height cached for the closest measured width, or -1 if the message was
+    // never measured in this font
+    int nearestHeight(const QString &messageId, int fontId, int width) const;
+
+    void invalidate(const QString &messageId);
+    void clear();
+
+private:
+    TextLayoutCache();
+
+    static const int MaxEntries = 200000;
+
+    struct Layout {
+        int usedWidth;       // Widest wrapped line
+        int height;
+    };
+    struct Entry {
+        int fontId;
+        QMap<int, Layout> layouts; // measured width -> layout
+    };
+
+    QHash<QString, Entry> entries; // message id -> layouts
+    QHash<QString, int> fontIds;   // QFont::key() -> id
+    int entryCount;
+};
+
+#endif // TEXTLAYOUTCACHE_H